@@ -128,6 +128,8 @@ struct NaiveGraphlabEngine {
   /// - gather_edges:IN_EDGES, scatter_edges:(OUT_EDGES || NONE)
   template< typename V, typename E >
   static void run_sync(GlobalAddress<Graph<V,E>> _g) {
+    // gathers read the source vertex, which isn't available at the mirrors of split vertices
+    CHECK_EQ(_g->nsplit, 0) << "vertex-cut graphs (--graph_split_degree) aren't supported";
     
     call_on_all_cores([=]{ g = _g; });
     
@@ -83,7 +83,7 @@ void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
     VertexID root;
     if (FLAGS_max_degree_source) {
       forall(g, [](VertexID i, G::Vertex& v){
-        max_degree << MaxDegree(i, v.nadj);
+        max_degree << MaxDegree(i, g->degree(v));
       });
       root = static_cast<MaxDegree>(max_degree).idx();
     } else {
@@ -143,7 +143,7 @@ void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
                 vj->parent = i;
                 vj->level = current_depth;
                 next->add(j);
-                edge_count += vj.nadj;
+                edge_count += g->degree(vj);
               }
             });
           });
@@ -153,10 +153,12 @@ void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
         forall<&phaser>(g, [](G::Vertex& v){
           if (v->level != -1) return;
           auto va = make_linear(&v);
-          forall<async,&phaser>(adj(g,v), [=,&v](G::Edge& e){
-            if (v->level != -1) return;
+          // (edges of a split vertex may be visited at its mirrors, so don't hold onto `v`)
+          forall<async,&phaser>(adj(g,v), [=](G::Edge& e){
+            if (va.core() == mycore() && (*va.pointer())->level != -1) return;
             
             phaser.enroll();
+            auto here = mycore();
             auto eva = e.ga;
             send_heap_message(eva.core(), [=]{
               auto& ev = *eva.pointer();
@@ -168,12 +170,12 @@ void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
                     next->add(g->id(v));
                     v->level = current_depth;
                     v->parent = eid;
-                    edge_count += v.nadj;
+                    edge_count += g->degree(v);
                   }
-                  phaser.complete();
+                  phaser.send_completion(here);
                 });
               } else {
-                phaser.send_completion(va.core());
+                phaser.send_completion(here);
               }
             });
           });
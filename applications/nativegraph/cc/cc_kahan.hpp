@@ -149,8 +149,8 @@ void explore(int64_t root_index, color_t mycolor, GlobalAddress<CompletionEvent>
     }
   }
   
-  // now visit adjacencies
-  enroll(ce, rv.nadj);
+  // now visit adjacencies (including any held by mirrors)
+  enroll(ce, g->degree(rv));
   
   forall<async,nullptr>(adj(g,rv), [=](G::Edge& e){
     delegate::call<async,nullptr>(e.ga, [mycolor,ce](G::Vertex& v){
@@ -181,10 +181,11 @@ void propagate(int64_t v, color_t mycolor) {
   CHECK_EQ((g->vs+v).core(), mycore());
   auto& rv = *(g->vs+v).pointer();
   
-  phaser.enroll(rv.nadj);
+  // enrolled here, so completions come back here even for edges visited at a mirror
+  Core origin = mycore();
+  phaser.enroll(g->degree(rv));
   forall<async,nullptr>(adj(g,v), [=](G::Edge& e){
     CHECK(e.id < g->nv && e.id >= 0) << "-- j: " << e.id << ", vj: " << e.ga << "\nvs: " << g->vs;
-    Core origin = mycore();
     call<async,nullptr>(e.ga, [=](G::Vertex& v){
       auto j = make_linear(&v) - g->vs;
       if (!v->visited) {
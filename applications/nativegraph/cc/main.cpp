@@ -27,6 +27,7 @@
 
 #include <Grappa.hpp>
 #include "cc_kahan.hpp"
+#include <GlobalUnionFind.hpp>
 
 DEFINE_bool( metrics, false, "Dump metrics");
 
@@ -48,6 +49,8 @@ GlobalCompletionEvent phaser;
 DEFINE_int64(hash_size, 1<<14, "size of GlobalHashSet");
 DEFINE_int64(concurrent_roots, 1, "number of concurrent `explores`");
 
+DEFINE_bool(union_find, false, "Find components with GlobalUnionFind (async hook-and-compress) instead of Kahan's algorithm");
+
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, ncomponents, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, pram_passes, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, set_size, 0);
@@ -59,6 +62,34 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_create_time, 0);
 
 size_t connected_components(GlobalAddress<G> g);
 
+/// Hook every edge asynchronously, then compress; labels each vertex with the
+/// smallest vertex id in its component.
+size_t union_find_components(GlobalAddress<G> g) {
+  auto uf = GlobalUnionFind::create(g->nv);
+  
+  GRAPPA_TIME_REGION(components_time) {
+    // (the edge iterator also covers mirrors' edges, see --graph_split_degree, and
+    // compressed adjacencies, see --graph_compress_adj)
+    forall(g, [g,uf](G::Vertex& v, G::Edge& e){
+      auto i = g->id(v);
+      auto j = e.id;
+      if (j > i) uf->unite<async>(i, j); // undirected: each edge is seen from both ends
+    });
+    uf->compress();
+  }
+  
+  // count roots among valid vertices only (not padding or absent ids), like Kahan's
+  auto parent = uf->parents();
+  call_on_all_cores([]{ nc = 0; });
+  forall(g, [parent](int64_t i, G::Vertex& v){
+    v->color = delegate::read(parent+i);
+    if (v->color == i) nc++;
+  });
+  uf->destroy();
+  
+  return reduce<int64_t,collective_add>(&nc);
+}
+
 int main(int argc, char* argv[]) {
   init(&argc, &argv);
   run([]{
@@ -86,7 +117,8 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << construction_time;
     
     GRAPPA_TIME_REGION(total_time) {
-      ncomponents = connected_components(g);
+      if (FLAGS_union_find) ncomponents = union_find_components(g);
+      else ncomponents = connected_components(g);
     }
     LOG(INFO) << total_time;
     
@@ -1,5 +1,6 @@
 #include <Grappa.hpp>
 #include <GlobalVector.hpp>
+#include <GlobalPriorityQueue.hpp>
 #include <graph/Graph.hpp>
 
 #include "sssp.hpp"
@@ -8,7 +9,10 @@
 DEFINE_bool(metrics, false, "Dump metrics");
 DEFINE_int32(scale, 10, "Log2 number of vertices.");
 DEFINE_int32(edgefactor, 16, "Average number of edges per vertex.");
+DEFINE_string(path, "", "Path to graph source file (weights taken from its edge data, if any).");
+DEFINE_string(format, "bintsv4", "Format of graph source file.");
 DEFINE_int64(root, 16, "Average number of edges per vertex.");
+DEFINE_double(delta, 0, "Bucket width for delta-stepping (GlobalPriorityQueue); 0 uses Bellman-Ford iterations");
 
 using namespace Grappa;
 
@@ -86,6 +90,40 @@ void do_sssp(GlobalAddress<G> &g, int64_t root) {
     }//while
 }
 
+/// Delta-stepping: relax vertices in (approximate) distance order, so each vertex is
+/// settled after few relaxations instead of once per Bellman-Ford iteration.
+void do_sssp_delta(GlobalAddress<G> &g, int64_t root) {
+    forall(g, [](G::Vertex& v){ v->init(v.nadj); });
+
+    delegate::call(g->vs+root,[=](G::Vertex& v) { 
+      v->dist = 0.0;
+      v->parent = root;
+    });
+
+    auto q = GlobalPriorityQueue<VertexID>::create(FLAGS_delta);
+    q->push((g->vs+root).core(), 0.0, root);
+
+    q->process([g,q](VertexID& vid, double dist){
+      auto& v = *(g->vs+vid).pointer();
+      // skip entries superseded by a shorter path found since they were pushed
+      if (dist > v->dist) return;
+
+      forall<async,&impl::priority_queue_gce>(adj(g,v), [=](G::Edge& e){
+        double sum = dist + e->weight;
+        auto j = e.id;
+        delegate::call<async,&impl::priority_queue_gce>(e.ga, [=](G::Vertex& ve){
+          if (sum < ve->dist) {
+            ve->dist = sum;
+            ve->parent = vid;
+            q->push_here(sum, j);
+          }
+        });
+      });
+    });
+
+    q->destroy();
+}
+
 int main(int argc, char* argv[]) {
   Grappa::init(&argc, &argv);
   Grappa::run([]{
@@ -95,20 +133,36 @@ int main(int argc, char* argv[]) {
     
     t = walltime();
 
-    // generate "NE" edge tuples, sampling vertices using the
-    // Graph500 Kronecker generator to get a power-law graph
-    auto tg = TupleGraph::Kronecker(FLAGS_scale, NE, 111, 222);
+    TupleGraph tg;
+    if (FLAGS_path.empty()) {
+      // generate "NE" edge tuples, sampling vertices using the
+      // Graph500 Kronecker generator to get a power-law graph
+      tg = TupleGraph::Kronecker(FLAGS_scale, NE, 111, 222);
+    } else {
+      LOG(INFO) << "loading " << FLAGS_path;
+      tg = TupleGraph::Load(FLAGS_path, FLAGS_format);
+    }
 
-    // create graph with incorporated Vertex
-    auto g = G::Undirected( tg );
+    // create graph with incorporated Vertex; use the file's weights if it
+    // has them (keeping the lightest of duplicate edges), otherwise random ones
+    GlobalAddress<G> g;
+    if (tg.has_payload() && tg.payload_size == sizeof(double)) {
+      g = G::create<double>( tg, EdgeCombine::Min() );
+    } else {
+      g = G::Undirected( tg );
+    }
     graph_create_time = (walltime()-t);
     
     LOG(INFO) << "graph generated (#nodes = " << g->nv << "), " << graph_create_time;
       
     t = walltime();
 
-    auto root = FLAGS_root;
-    do_sssp(g, root);
+    auto root = g->vertex_id(FLAGS_root);
+    if (FLAGS_delta > 0) {
+      do_sssp_delta(g, root);
+    } else {
+      do_sssp(g, root);
+    }
 
     double this_sssp_time = walltime() - t;
     LOG(INFO) << "(root=" << root << ", time=" << this_sssp_time << ")";
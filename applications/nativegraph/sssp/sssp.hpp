@@ -22,6 +22,7 @@ struct SSSPData {
 struct SSSPEdgeData {
   double weight;
   SSSPEdgeData(): weight(drand48()) {}
+  SSSPEdgeData(double weight): weight(weight) {}
 };
 
 using G = Graph<SSSPData,SSSPEdgeData>;
@@ -52,11 +53,12 @@ public:
 
     // SSSP distances verification
     forall(tg.edges, tg.nedge, [=](TupleGraph::Edge& e){
-      auto i = e.v0, j = e.v1;
-
       /* Eliminate self loops from verification */
-      if ( i == j)
+      if (e.v0 == e.v1)
         return;
+      
+      // translate the input's ids to the graph's (see VerificatorBase::verify)
+      auto i = g->vertex_id(e.v0), j = g->vertex_id(e.v1);
 
       /* SSSP specific checks */
       auto ti = VerificatorBase<G>::get_parent(g,i), tj = VerificatorBase<G>::get_parent(g,j);
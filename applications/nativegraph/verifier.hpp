@@ -69,7 +69,7 @@ public:
 
     // verify levels & parents match
     forall(tg.edges, tg.nedge, [=](TupleGraph::Edge& e){
-      auto max_bfsvtx = g->nv - 1;
+      auto max_bfsvtx = g->orig_nv - 1;
       auto i = e.v0, j = e.v1;
 
       int64_t lvldiff;
@@ -79,6 +79,11 @@ public:
       CHECK(!(j > max_bfsvtx && i <= max_bfsvtx)) << "Error!";
       if (i > max_bfsvtx) // both i & j are on the same side of max_bfsvtx
       return;
+      
+      // the TupleGraph has the input's ids; find the vertices they were renumbered to
+      // (if --graph_partition or --graph_order relabeled them)
+      i = g->vertex_id(i);
+      j = g->vertex_id(j);
 
       // All neighbors must be in the tree.
       auto ti = get_parent(g,i), tj = get_parent(g,j);
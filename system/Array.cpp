@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include "Array.hpp"
+#include <cstring>
+#include <vector>
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, memcpy_bulk_msgs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, memcpy_bulk_bytes, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, memcpy_shared_bytes, 0);
+
+namespace Grappa {
+namespace impl {
+
+namespace {
+  
+  /// Limit on payload bytes in flight from one core before waiting for acks.
+  const int64_t max_outstanding_bytes = 1L << 22;
+  
+  /// Header of a run of bytes in a remote payload; followed by `nbytes` bytes.
+  struct ByteRun {
+    GlobalAddress<char> dst;
+    int64_t nbytes;
+  };
+  
+  /// Run of bytes to be copied straight out of locale shared memory.
+  struct SharedRun {
+    GlobalAddress<char> dst;
+    const char * src;
+    int64_t nbytes;
+  };
+  
+  /// Position of a byte in the memory of the core that owns it, so we can tell if two
+  /// pieces are contiguous at the destination.
+  inline intptr_t local_offset(GlobalAddress<char> a) {
+    if (a.is_2D()) return reinterpret_cast<intptr_t>(a.pointer());
+    intptr_t raw = a.raw_bits();
+    return (raw / block_size) / cores() * block_size + raw % block_size;
+  }
+  
+  /// Accumulates pieces bound for each core into as few, as large, messages as possible.
+  class BulkSender {
+    struct Dest {
+      char * buf;     // payload being built (nullptr if none)
+      size_t size;    // bytes used in buf
+      void * last;    // last run header in buf (to extend it)
+      intptr_t next;  // destination-local offset that would extend the last run
+      const char * next_src; // source pointer that would extend the last (shared) run
+      bool shared;    // buf holds SharedRun descriptors rather than ByteRuns
+    };
+    
+    std::vector<Dest> dests;
+    Core origin;
+    CompletionEvent ce;
+    int64_t outstanding;
+    
+    void send(Core c) {
+      auto& d = dests[c];
+      if (d.buf == nullptr) return;
+      
+      char * buf = d.buf;
+      size_t sz = d.size;
+      bool shared = d.shared;
+      d.buf = nullptr;
+      d.size = 0;
+      d.last = nullptr;
+      
+      memcpy_bulk_msgs++;
+      ce.enroll();
+      outstanding += sz;
+      auto pce = &ce;
+      Core origin = this->origin;
+      
+      if (shared) {
+        send_heap_message(c, [origin,pce,buf](void * payload, size_t psz) {
+          auto runs = static_cast<SharedRun*>(payload);
+          for (size_t i = 0; i < psz / sizeof(SharedRun); i++) {
+            std::memcpy(runs[i].dst.pointer(), runs[i].src, runs[i].nbytes);
+          }
+          send_heap_message(origin, [pce,buf]{ locale_free(buf); pce->complete(); });
+        }, buf, sz);
+      } else {
+        send_heap_message(c, [origin,pce,buf](void * payload, size_t psz) {
+          char * p = static_cast<char*>(payload);
+          char * end = p + psz;
+          while (p < end) {
+            ByteRun r;
+            std::memcpy(&r, p, sizeof(ByteRun));
+            p += sizeof(ByteRun);
+            std::memcpy(r.dst.pointer(), p, r.nbytes);
+            p += r.nbytes;
+          }
+          send_heap_message(origin, [pce,buf]{ locale_free(buf); pce->complete(); });
+        }, buf, sz);
+      }
+      
+      if (outstanding > max_outstanding_bytes) {
+        ce.wait();
+        outstanding = 0;
+      }
+    }
+    
+  public:
+    BulkSender(): dests(cores()), origin(mycore()), ce(0), outstanding(0) {
+      for (auto& d : dests) { d.buf = nullptr; d.size = 0; d.last = nullptr; d.shared = false; }
+    }
+    
+    /// Copy `n` bytes at local `src` to `dst`, which must lie within one block.
+    void add(GlobalAddress<char> dst, const char * src, size_t n) {
+      Core c = dst.core();
+      memcpy_bulk_bytes += n;
+      
+      if (c == origin) {
+        std::memcpy(dst.pointer(), src, n);
+        return;
+      }
+      
+      auto& d = dests[c];
+      intptr_t off = local_offset(dst);
+      
+      // the destination can only read the source directly if it's in the locale's shared
+      // memory (not, e.g., a private heap buffer of a 2D source)
+      bool shared = locale_of(c) == mylocale() && locale_shared_memory.contains(src, n);
+      if (d.buf && d.shared != shared) send(c);
+      
+      if (shared) {
+        // just send descriptors
+        memcpy_shared_bytes += n;
+        if (d.last && d.next == off && d.next_src == src) {
+          static_cast<SharedRun*>(d.last)->nbytes += n;
+        } else {
+          if (d.buf && d.size + sizeof(SharedRun) > MAX_MESSAGE_SIZE) send(c);
+          if (d.buf == nullptr) { d.buf = locale_alloc<char>(MAX_MESSAGE_SIZE); d.shared = true; }
+          auto r = reinterpret_cast<SharedRun*>(d.buf + d.size);
+          r->dst = dst;
+          r->src = src;
+          r->nbytes = n;
+          d.last = r;
+          d.size += sizeof(SharedRun);
+        }
+        d.next = off + n;
+        d.next_src = src + n;
+        return;
+      }
+      
+      while (n > 0) {
+        if (d.buf && d.size == MAX_MESSAGE_SIZE) send(c);
+        if (d.buf == nullptr) { d.buf = locale_alloc<char>(MAX_MESSAGE_SIZE); d.shared = false; }
+        
+        if (!(d.last && d.next == off)) {
+          if (d.size + sizeof(ByteRun) >= MAX_MESSAGE_SIZE) { send(c); continue; }
+          auto r = reinterpret_cast<ByteRun*>(d.buf + d.size);
+          r->dst = dst;
+          r->nbytes = 0;
+          d.last = r;
+          d.size += sizeof(ByteRun);
+        }
+        size_t k = std::min(n, MAX_MESSAGE_SIZE - d.size);
+        std::memcpy(d.buf + d.size, src, k);
+        d.size += k;
+        reinterpret_cast<ByteRun*>(d.last)->nbytes += k;
+        
+        dst += k; src += k; n -= k; off += k;
+        d.next = off;
+      }
+    }
+    
+    /// Send everything and wait until it has all been written.
+    void finish() {
+      for (Core c = 0; c < cores(); c++) send(c);
+      ce.wait();
+    }
+  };
+  
+} // namespace
+  
+void memcpy_bytes_from_here(GlobalAddress<char> dst, GlobalAddress<char> src, size_t nbytes) {
+  if (nbytes == 0) return;
+  BulkSender sender;
+  
+  // split a contiguous local piece of the source along destination block boundaries
+  auto emit = [&](int64_t off, const char * p, size_t len) {
+    while (len > 0) {
+      auto d = dst + off;
+      size_t n = d.is_2D() ? len : std::min<size_t>(len, block_size - d.raw_bits() % block_size);
+      sender.add(d, p, n);
+      off += n; p += n; len -= n;
+    }
+  };
+  
+  if (src.is_2D()) {
+    if (src.core() == mycore()) emit(0, src.pointer(), nbytes);
+  } else {
+    intptr_t s = src.raw_bits(), e = s + nbytes;
+    intptr_t b = s / block_size;
+    b += (mycore() - b % cores() + cores()) % cores(); // first of our blocks
+    for (; b * block_size < e; b += cores()) {
+      intptr_t lo = std::max<intptr_t>(s, b * block_size);
+      intptr_t hi = std::min<intptr_t>(e, (b+1) * block_size);
+      emit(lo - s, (src + (lo - s)).pointer(), hi - lo);
+    }
+  }
+  
+  sender.finish();
+}
+
+} // namespace impl
+} // namespace Grappa
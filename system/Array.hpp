@@ -31,6 +31,11 @@
 #include "GlobalAllocator.hpp"
 #include <type_traits>
 #include "Delegate.hpp"
+#include <algorithm>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, memcpy_bulk_msgs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, memcpy_bulk_bytes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, memcpy_shared_bytes);
 
 namespace Grappa {
 /// @addtogroup Containers
@@ -38,22 +43,28 @@ namespace Grappa {
   
 /// Initialize an array of elements of generic type with a given value.
 /// 
-/// This version sends a large number of active messages, the same way as the Incoherent
-/// releaser, to set each part of a global array. In theory, this version should be able
-/// to be called from multiple locations at the same time (to initialize different regions of global memory).
+/// Sends one message to each core, which sets its own part of the array in place (or just
+/// one message to the owning core if `base` is a 2D address). In theory, this version should
+/// be able to be called from multiple locations at the same time (to initialize different
+/// regions of global memory).
 /// 
 /// @param base Base address of the array to be set.
 /// @param value Value to set every element of array to (will be copied to all the nodes)
 /// @param count Number of elements to set, starting at the base address.
 template< typename T, typename S >
 void memset(GlobalAddress<T> base, S value, size_t count) {
-  call_on_all_cores([base,count,value]{
-    T * local_base = base.localize();
-    T * local_end = (base+count).localize();
-    for (size_t i=0; i<local_end-local_base; i++) {
-      local_base[i] = value;
-    }
-  });
+  if (base.is_2D()) {
+    delegate::call(base.core(), [base,count,value]{
+      T * p = base.pointer();
+      std::fill(p, p+count, value);
+    });
+  } else {
+    call_on_all_cores([base,count,value]{
+      T * local_base = base.localize();
+      T * local_end = (base+count).localize();
+      std::fill(local_base, local_end, value);
+    });
+  }
 }
 
 /// Type-based memset for local arrays to match what is provided for distributed arrays.
@@ -65,68 +76,28 @@ void memset(T* base, S value, size_t count) {
 }
 
 namespace impl {
-  /// Copy elements of array (src..src+nelem) that are local to corresponding locations in dst
-  template< typename T >
-  void do_memcpy_locally(GlobalAddress<T> dst, GlobalAddress<T> src, size_t nelem) {
-    typedef typename Incoherent<T>::WO Writeback;
-    auto src_end = src+nelem;
-    // T * local_base = src.localize(), * local_end = (src+nelem).localize();
-    int64_t nfirstcore = src.block_max() - src;
-    int64_t nlastcore = src_end - src_end.block_min();
-    int64_t nmiddle = nelem - nfirstcore - nlastcore;
-    
-    const size_t nblock = block_size / sizeof(T);
-    
-    CHECK_EQ(nmiddle % nblock, 0);
-
-    auto src_start = src;
-    if (src.core() == mycore()) {
-      int64_t nfirstcore = src.block_max() - src;
-      if (nfirstcore > 0 && nlastcore != nblock) {
-        DVLOG(3) << "nfirstcore = " << nfirstcore;
-        Writeback w(dst, nfirstcore, src.pointer());
-        src_start += nfirstcore;
-      }
-    }
-    if ((src_end-1).core() == mycore()) {
-      int64_t nlastcore = src_end - src_end.block_min();
-      int64_t index = nelem - nlastcore;
-      if (nlastcore > 0 && nlastcore != nblock) {
-        DVLOG(3) << "nlastcore = " << nlastcore << ", index = " << index;
-        CHECK((src+index).core() == mycore());
-        Writeback w(dst+index, nlastcore, (src+index).pointer());
-        src_end -= nlastcore;
-      }
-    }
-    
-    auto * local_base = src_start.localize();
-    size_t nlocal_trimmed = src_end.localize() - local_base;
-    CHECK_EQ((nlocal_trimmed) % nblock, 0);
-    size_t nlocalblocks = nlocal_trimmed/nblock;
-    Writeback * ws = locale_alloc<Writeback>(nlocalblocks);
-    for (size_t i=0; i<nlocalblocks; i++) {
-      size_t j = make_linear(local_base+(i*nblock))-src;
-      new (ws+i) Writeback(dst+j, nblock, local_base+(i*nblock));
-      ws[i].start_release();
-    }
-    for (size_t i=0; i<nlocalblocks; i++) { ws[i].block_until_released(); }
-    locale_free(ws);
-  }
+  /// Copy the bytes of (src..src+nbytes) that live on this core to the corresponding
+  /// bytes of (dst..dst+nbytes), blocking until they have all been written.
+  ///
+  /// Pieces are computed from the overlap of source and destination blocks, so the two
+  /// may have any distribution and relative offset. Pieces bound for the same core are
+  /// coalesced into runs and shipped in `MAX_MESSAGE_SIZE` payloads; when the source is in
+  /// locale shared memory, cores in the same locale are just sent descriptors and copy the
+  /// bytes directly out of it.
+  void memcpy_bytes_from_here(GlobalAddress<char> dst, GlobalAddress<char> src, size_t nbytes);
 }
 
-/// Memcpy over Grappa global arrays. Arguments `dst` and `src` must point into global arrays 
-/// (so must be linear addresses) and be non-overlapping, and both must have at least `nelem`
-/// elements.
+/// Memcpy over Grappa global arrays. Arguments `dst` and `src` may be linear or 2D addresses
+/// with any relative alignment, but must be non-overlapping, and both must have at least
+/// `nelem` elements.
 template< typename T >
 void memcpy(GlobalAddress<T> dst, GlobalAddress<T> src, size_t nelem) {
-  if (src.is_2D() && dst.is_2D()) {
-    typename Incoherent<T>::RO c(src, nelem, dst.pointer());
-    c.block_until_acquired();
-  } else {
-    on_all_cores([dst,src,nelem]{
-      impl::do_memcpy_locally(dst,src,nelem);
-    });
-  }
+  auto d = static_cast<GlobalAddress<char>>(dst);
+  auto s = static_cast<GlobalAddress<char>>(src);
+  size_t nbytes = nelem * sizeof(T);
+  on_all_cores([d,s,nbytes]{
+    impl::memcpy_bytes_from_here(d, s, nbytes);
+  });
 }
 
 /// Helper so we don't have to change the code if we change a Global pointer to a normal pointer (in theory).
@@ -147,9 +118,23 @@ inline void memcpy<void>(void* dst, void* src, size_t nelem) {
 /// Note: same restrictions on `dst` and `src` as Grappa::memcpy).
 template< GlobalCompletionEvent * GCE = &impl::local_gce, typename T = void >
 void memcpy_async(GlobalAddress<T> dst, GlobalAddress<T> src, size_t nelem) {
-  on_cores_localized_async<GCE>(src, nelem, [dst,src,nelem](T* base, size_t nlocal){
-    impl::do_memcpy_locally(dst,src,nelem);
-  });
+  auto d = static_cast<GlobalAddress<char>>(dst);
+  auto s = static_cast<GlobalAddress<char>>(src);
+  size_t nbytes = nelem * sizeof(T);
+  if (src.is_2D()) {
+    if (GCE) GCE->enroll();
+    Core origin = mycore();
+    send_heap_message(src.core(), [d,s,nbytes,origin]{
+      spawn([d,s,nbytes,origin]{
+        impl::memcpy_bytes_from_here(d, s, nbytes);
+        if (GCE) complete(make_global(GCE,origin));
+      });
+    });
+  } else {
+    on_cores_localized_async<GCE>(src, nelem, [d,s,nbytes](T* base, size_t nlocal){
+      impl::memcpy_bytes_from_here(d, s, nbytes);
+    });
+  }
 }
 
 /// not implemented yet
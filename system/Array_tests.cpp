@@ -99,6 +99,45 @@ void test_complex() {
   Grappa::global_free(ys);
 }
 
+void test_memcpy_unaligned() {
+  BOOST_MESSAGE("memcpy_unaligned");
+  auto xs = Grappa::global_alloc<int64_t>(NN);
+  auto ys = Grappa::global_alloc<int64_t>(NN);
+  
+  Grappa::forall(xs, NN, [](int64_t i, int64_t& v) { v = i; });
+  
+  // shift destination so source and destination blocks don't line up
+  for (int64_t off : {1, 3, 8}) {
+    Grappa::memset(ys, -1, NN);
+    Grappa::memcpy(ys+off, xs, NN-off);
+    Grappa::forall(ys+off, NN-off, [](int64_t i, int64_t& v) {
+      BOOST_CHECK_EQUAL(v, i);
+    });
+  }
+  
+  // between 2D (local) and linear addresses
+  int64_t local[N];
+  for (int64_t i=0; i<N; i++) local[i] = -i;
+  Grappa::memcpy(ys+5, make_global(local), N);
+  Grappa::forall(ys+5, N, [](int64_t i, int64_t& v) {
+    BOOST_CHECK_EQUAL(v, -i);
+  });
+  
+  Grappa::memcpy(make_global(local), xs+7, N);
+  for (int64_t i=0; i<N; i++) BOOST_CHECK_EQUAL(local[i], i+7);
+  
+  // 2D source in private (non-shared) heap memory, spread over many cores
+  std::vector<int64_t> heap(NN);
+  for (int64_t i=0; i<NN; i++) heap[i] = 2*i;
+  Grappa::memcpy(ys+3, make_global(&heap[0]), NN-3);
+  Grappa::forall(ys+3, NN-3, [](int64_t i, int64_t& v) {
+    BOOST_CHECK_EQUAL(v, 2*i);
+  });
+  
+  Grappa::global_free(xs);
+  Grappa::global_free(ys);
+}
+
 void test_prefix_sum() {
   BOOST_MESSAGE("prefix_sum");
   auto xs = Grappa::global_alloc<int64_t>(N);
@@ -152,6 +191,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     test_memset_memcpy<int64_t,7>(true); // test async
     // test_memset_memcpy<double,7.0>();
     test_complex();
+    test_memcpy_unaligned();
     // test_prefix_sum(); // (not implemented yet)
     test_push_buffer();
     
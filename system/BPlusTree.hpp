@@ -0,0 +1,302 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace Grappa {
+
+/// @addtogroup Containers
+/// @{
+
+/// Core-local B+-tree used as the partition store of GlobalOrderedMap.
+///
+/// Keys and values of a node are kept in separate arrays sized to a few cache lines so
+/// searches scan contiguous keys; leaves are chained for range iteration. `K` and `V`
+/// must be default-constructible; `K` must be ordered by `<`.
+template< typename K, typename V >
+class BPlusTree {
+public:
+  static const int node_bytes = 512;
+  static const int leaf_capacity =
+      (node_bytes / (sizeof(K)+sizeof(V)) < 4) ? 4 : node_bytes / (sizeof(K)+sizeof(V));
+  static const int inner_capacity =
+      (node_bytes / (sizeof(K)+sizeof(void*)) < 4) ? 4 : node_bytes / (sizeof(K)+sizeof(void*));
+  
+  struct Node {
+    bool leaf;
+    int n;
+    Node(bool leaf): leaf(leaf), n(0) {}
+  };
+  
+  struct Leaf : public Node {
+    K keys[leaf_capacity];
+    V vals[leaf_capacity];
+    Leaf * next;
+    Leaf(): Node(true), next(nullptr) {}
+  };
+  
+  /// `keys[i]` is the smallest key reachable through `child[i+1]`.
+  struct Inner : public Node {
+    K keys[inner_capacity];
+    Node * child[inner_capacity+1];
+    Inner(): Node(false) {}
+  };
+  
+protected:
+  Node * root;
+  size_t count;
+  
+  static void free_node(Node * n) {
+    if (n->leaf) {
+      delete static_cast<Leaf*>(n);
+    } else {
+      auto in = static_cast<Inner*>(n);
+      for (int i = 0; i <= in->n; i++) free_node(in->child[i]);
+      delete in;
+    }
+  }
+  
+  Leaf * find_leaf(const K& key) const {
+    Node * n = root;
+    while (!n->leaf) {
+      auto in = static_cast<Inner*>(n);
+      int i = std::upper_bound(in->keys, in->keys + in->n, key) - in->keys;
+      n = in->child[i];
+    }
+    return static_cast<Leaf*>(n);
+  }
+  
+  /// Insert into the subtree at `n`; if it splits, returns the new right sibling and sets
+  /// `split_key` to its smallest key.
+  Node * insert_rec(Node * n, const K& key, const V& val, K * split_key, bool * added) {
+    if (n->leaf) {
+      auto l = static_cast<Leaf*>(n);
+      int i = std::lower_bound(l->keys, l->keys + l->n, key) - l->keys;
+      if (i < l->n && !(key < l->keys[i])) {
+        l->vals[i] = val;
+        *added = false;
+        return nullptr;
+      }
+      *added = true;
+      if (l->n < leaf_capacity) {
+        std::move_backward(l->keys+i, l->keys+l->n, l->keys+l->n+1);
+        std::move_backward(l->vals+i, l->vals+l->n, l->vals+l->n+1);
+        l->keys[i] = key; l->vals[i] = val;
+        l->n++;
+        return nullptr;
+      }
+      // split full leaf in half, then insert into the proper side
+      auto r = new Leaf();
+      int half = leaf_capacity / 2;
+      r->n = l->n - half;
+      std::move(l->keys+half, l->keys+l->n, r->keys);
+      std::move(l->vals+half, l->vals+l->n, r->vals);
+      l->n = half;
+      r->next = l->next;
+      l->next = r;
+      
+      bool a;
+      if (i <= half) insert_rec(l, key, val, split_key, &a);
+      else           insert_rec(r, key, val, split_key, &a);
+      *split_key = r->keys[0];
+      return r;
+    } else {
+      auto in = static_cast<Inner*>(n);
+      int i = std::upper_bound(in->keys, in->keys + in->n, key) - in->keys;
+      K ck;
+      Node * c = insert_rec(in->child[i], key, val, &ck, added);
+      if (c == nullptr) return nullptr;
+      
+      if (in->n < inner_capacity) {
+        std::move_backward(in->keys+i, in->keys+in->n, in->keys+in->n+1);
+        std::move_backward(in->child+i+1, in->child+in->n+1, in->child+in->n+2);
+        in->keys[i] = ck;
+        in->child[i+1] = c;
+        in->n++;
+        return nullptr;
+      }
+      
+      // split full inner node: gather n+1 keys / n+2 children, push the middle key up
+      K keys[inner_capacity+1];
+      Node * child[inner_capacity+2];
+      std::copy(in->keys, in->keys+i, keys);
+      keys[i] = ck;
+      std::copy(in->keys+i, in->keys+in->n, keys+i+1);
+      std::copy(in->child, in->child+i+1, child);
+      child[i+1] = c;
+      std::copy(in->child+i+1, in->child+in->n+1, child+i+2);
+      
+      int total = in->n + 1;
+      int mid = total / 2;
+      auto r = new Inner();
+      in->n = mid;
+      std::copy(keys, keys+mid, in->keys);
+      std::copy(child, child+mid+1, in->child);
+      r->n = total - mid - 1;
+      std::copy(keys+mid+1, keys+total, r->keys);
+      std::copy(child+mid+1, child+total+1, r->child);
+      *split_key = keys[mid];
+      return r;
+    }
+  }
+  
+public:
+  BPlusTree(): root(new Leaf()), count(0) {}
+  ~BPlusTree() { free_node(root); }
+  
+  BPlusTree(const BPlusTree&) = delete;
+  BPlusTree& operator=(const BPlusTree&) = delete;
+  
+  size_t size() const { return count; }
+  
+  void clear() {
+    free_node(root);
+    root = new Leaf();
+    count = 0;
+  }
+  
+  /// Returns a pointer to the value for `key`, or nullptr.
+  V * find(const K& key) const {
+    Leaf * l = find_leaf(key);
+    int i = std::lower_bound(l->keys, l->keys + l->n, key) - l->keys;
+    if (i < l->n && !(key < l->keys[i])) return &l->vals[i];
+    return nullptr;
+  }
+  
+  /// Insert or overwrite; returns true if the key was new.
+  bool insert(const K& key, const V& val) {
+    K split_key;
+    bool added = false;
+    Node * r = insert_rec(root, key, val, &split_key, &added);
+    if (r) {
+      auto nr = new Inner();
+      nr->n = 1;
+      nr->keys[0] = split_key;
+      nr->child[0] = root;
+      nr->child[1] = r;
+      root = nr;
+    }
+    if (added) count++;
+    return added;
+  }
+  
+  /// Replace the contents with `n` entries, which must be sorted by key with no
+  /// duplicates. Leaves are packed full, so this is much faster (and tighter) than
+  /// inserting one at a time.
+  template< typename Iter >
+  void bulk_load(Iter begin, size_t n) {
+    free_node(root);
+    count = n;
+    if (n == 0) { root = new Leaf(); return; }
+    
+    std::vector<Node*> level;
+    std::vector<K> mins;
+    Leaf * prev = nullptr;
+    auto it = begin;
+    for (size_t i = 0; i < n; ) {
+      auto l = new Leaf();
+      for (; l->n < leaf_capacity && i < n; i++, ++it) {
+        l->keys[l->n] = it->first;
+        l->vals[l->n] = it->second;
+        l->n++;
+      }
+      if (prev) prev->next = l;
+      prev = l;
+      level.push_back(l);
+      mins.push_back(l->keys[0]);
+    }
+    
+    while (level.size() > 1) {
+      std::vector<Node*> up;
+      std::vector<K> up_mins;
+      for (size_t i = 0; i < level.size(); ) {
+        auto in = new Inner();
+        up_mins.push_back(mins[i]);
+        in->child[0] = level[i++];
+        for (; in->n < inner_capacity && i < level.size(); i++) {
+          in->keys[in->n] = mins[i];
+          in->child[in->n+1] = level[i];
+          in->n++;
+        }
+        up.push_back(in);
+      }
+      level.swap(up);
+      mins.swap(up_mins);
+    }
+    root = level[0];
+  }
+  
+  /// Call `f(Leaf* l, int begin, int end)` for each run of entries in `[lo,hi)`, in order.
+  template< typename F >
+  void for_each_run(const K& lo, const K& hi, F f) const {
+    if (!(lo < hi)) return;
+    Leaf * l = find_leaf(lo);
+    int b = std::lower_bound(l->keys, l->keys + l->n, lo) - l->keys;
+    for (; l != nullptr; l = l->next, b = 0) {
+      int e = std::lower_bound(l->keys + b, l->keys + l->n, hi) - l->keys;
+      if (b < e) f(l, b, e);
+      if (e < l->n) return;
+    }
+  }
+  
+  /// Call `f(const K&, V&)` for each entry in `[lo,hi)` in key order.
+  template< typename F >
+  void for_each(const K& lo, const K& hi, F f) const {
+    for_each_run(lo, hi, [&f](Leaf * l, int b, int e){
+      for (int i = b; i < e; i++) f(l->keys[i], l->vals[i]);
+    });
+  }
+  
+  /// Call `f(const K&, V&)` for every entry in key order.
+  template< typename F >
+  void for_each(F f) const {
+    Node * n = root;
+    while (!n->leaf) n = static_cast<Inner*>(n)->child[0];
+    for (auto l = static_cast<Leaf*>(n); l != nullptr; l = l->next) {
+      for (int i = 0; i < l->n; i++) f(l->keys[i], l->vals[i]);
+    }
+  }
+  
+  /// Number of entries in `[lo,hi)`, stopping early at `limit`.
+  size_t count_range(const K& lo, const K& hi, size_t limit = SIZE_MAX) const {
+    if (!(lo < hi)) return 0;
+    size_t c = 0;
+    Leaf * l = find_leaf(lo);
+    int b = std::lower_bound(l->keys, l->keys + l->n, lo) - l->keys;
+    for (; l != nullptr && c < limit; l = l->next, b = 0) {
+      int e = std::lower_bound(l->keys + b, l->keys + l->n, hi) - l->keys;
+      c += e - b;
+      if (e < l->n) break;
+    }
+    return std::min(c, limit);
+  }
+};
+
+/// @}
+
+} // namespace Grappa
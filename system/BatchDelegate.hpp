@@ -0,0 +1,268 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Message.hpp"
+#include "CompletionEvent.hpp"
+#include "LocaleSharedMemory.hpp"
+#include "Collective.hpp"
+#include "Tasking.hpp"
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batch_calls);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batch_elements);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batch_msgs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batch_targets);
+
+namespace Grappa {
+  /// @addtogroup Delegates
+  /// @{
+  
+  namespace delegate {
+    
+    /// Element-wise operations for batched delegates. Each `apply` returns the new value
+    /// to be stored given the current value and the operand.
+    namespace batch_op {
+      struct Add { template< typename T, typename U > static T apply(T x, U y) { return x + y; } };
+      struct Min { template< typename T, typename U > static T apply(T x, U y) { return y < x ? y : x; } };
+      struct Max { template< typename T, typename U > static T apply(T x, U y) { return x < y ? y : x; } };
+      struct Or  { template< typename T, typename U > static T apply(T x, U y) { return x | y; } };
+      struct And { template< typename T, typename U > static T apply(T x, U y) { return x & y; } };
+      struct Xor { template< typename T, typename U > static T apply(T x, U y) { return x ^ y; } };
+      
+      /// Operand for CompareAndSwap.
+      template< typename T >
+      struct Swap { T cmp; T val; };
+      
+      struct CompareAndSwap {
+        template< typename T >
+        static T apply(T x, Swap<T> y) { return (x == y.cmp) ? y.val : x; }
+      };
+    }
+    
+    namespace impl {
+      
+      /// Apply a batch of operations to local elements (addresses must all be on this core).
+      /// Addresses and operands are passed as separate arrays so the loop stays tight.
+      template< typename Op, typename T, typename U >
+      inline void apply_batch(const GlobalAddress<T> * addrs, const U * operands, size_t n,
+                              T * prev) {
+        delegate_batch_targets += n;
+        if (prev) {
+          for (size_t i = 0; i < n; i++) {
+            T * p = addrs[i].pointer();
+            T x = *p;
+            prev[i] = x;
+            *p = Op::apply(x, operands[i]);
+          }
+        } else {
+          for (size_t i = 0; i < n; i++) {
+            T * p = addrs[i].pointer();
+            *p = Op::apply(*p, operands[i]);
+          }
+        }
+      }
+      
+    } // namespace impl
+    
+    /// Apply `Op` to many elements of a global array in one blocking call: for each `i`,
+    /// atomically sets `base[index[i]] = Op::apply(base[index[i]], operand[i])`, and if
+    /// `prev` is non-null, stores the value found before the update in `prev[i]`.
+    ///
+    /// Operations are grouped by destination core and shipped as one message per
+    /// `MAX_MESSAGE_SIZE` chunk instead of one delegate per element. Each element's update
+    /// is atomic, and updates to the same element are applied in index order, but there is
+    /// no atomicity across elements. When `prev` is not needed, no values are sent back.
+    ///
+    /// @warning Elements must not span blocks in global address space.
+    ///
+    /// @b Example:
+    /// @code
+    ///   // min-label propagation: one message per destination, not per edge
+    ///   delegate::batch<delegate::batch_op::Min>(labels, targets, new_labels, n);
+    /// @endcode
+    template< typename Op, typename T, typename U >
+    void batch(GlobalAddress<T> base, const int64_t * index, const U * operand, size_t n,
+               T * prev = nullptr) {
+      delegate_batch_calls++;
+      delegate_batch_elements += n;
+      if (n == 0) return;
+      
+      const size_t max_per_msg = std::max<size_t>(1, std::min(
+          MAX_MESSAGE_SIZE / (sizeof(GlobalAddress<T>) + sizeof(U)),
+          MAX_MESSAGE_SIZE / sizeof(T)));
+      
+      Core origin = mycore();
+      
+      // counting sort of element indices by destination core
+      std::vector<size_t> offsets(cores()+1, 0);
+      for (size_t i = 0; i < n; i++) offsets[(base+index[i]).core()+1]++;
+      for (Core c = 0; c < cores(); c++) offsets[c+1] += offsets[c];
+      
+      std::vector<size_t> order(n);
+      {
+        std::vector<size_t> pos(offsets.begin(), offsets.end()-1);
+        for (size_t i = 0; i < n; i++) order[pos[(base+index[i]).core()]++] = i;
+      }
+      
+      // staging buffers must be in locale shared memory so they can be used as payloads
+      auto addrs = locale_alloc<GlobalAddress<T>>(n);
+      auto operands = locale_alloc<U>(n);
+      T * sorted_prev = prev ? locale_alloc<T>(n) : nullptr;
+      
+      for (size_t j = 0; j < n; j++) {
+        addrs[j] = base + index[order[j]];
+        operands[j] = operand[order[j]];
+      }
+      
+      size_t nmsg = 0;
+      for (Core c = 0; c < cores(); c++) if (c != origin) {
+        size_t m = offsets[c+1] - offsets[c];
+        nmsg += m / max_per_msg + (m % max_per_msg ? 1 : 0);
+      }
+      
+      CompletionEvent ce(nmsg);
+      auto pce = &ce;
+      
+      for (Core c = 0; c < cores(); c++) if (c != origin) {
+        for (size_t s = offsets[c]; s < offsets[c+1]; s += max_per_msg) {
+          size_t m = std::min(max_per_msg, offsets[c+1] - s);
+          T * out = sorted_prev ? sorted_prev + s : nullptr;
+          
+          // payload: `m` addresses followed by `m` operands
+          char * buf = locale_alloc<char>(m * (sizeof(GlobalAddress<T>) + sizeof(U)));
+          std::memcpy(buf, addrs+s, m * sizeof(GlobalAddress<T>));
+          std::memcpy(buf + m * sizeof(GlobalAddress<T>), operands+s, m * sizeof(U));
+          
+          delegate_batch_msgs++;
+          send_heap_message(c, [origin, pce, out, buf, m](void * payload, size_t psz) {
+            auto a = static_cast<GlobalAddress<T>*>(payload);
+            auto v = reinterpret_cast<U*>(a + m);
+            
+            if (out == nullptr) {
+              impl::apply_batch<Op>(a, v, m, (T*)nullptr);
+              send_heap_message(origin, [pce, buf]{ locale_free(buf); pce->complete(); });
+            } else if (locale_of(origin) == mylocale()) {
+              // results buffer is in our locale's shared memory: write it directly
+              impl::apply_batch<Op>(a, v, m, out);
+              send_heap_message(origin, [pce, buf]{ locale_free(buf); pce->complete(); });
+            } else {
+              auto result = locale_alloc<T>(m);
+              impl::apply_batch<Op>(a, v, m, result);
+              spawn([origin, pce, out, buf, m, result]{
+                {
+                  auto reply = send_message(origin, [pce, out, buf](void * p, size_t sz){
+                    std::memcpy(out, p, sz);
+                    locale_free(buf);
+                    pce->complete();
+                  }, result, m * sizeof(T));
+                } // blocks until sent
+                locale_free(result);
+              });
+            }
+          }, buf, m * (sizeof(GlobalAddress<T>) + sizeof(U)));
+        }
+      }
+      
+      // do local elements while remote ones are in flight
+      impl::apply_batch<Op>(addrs + offsets[origin], operands + offsets[origin],
+                            offsets[origin+1] - offsets[origin],
+                            sorted_prev ? sorted_prev + offsets[origin] : nullptr);
+      
+      ce.wait();
+      
+      if (prev) {
+        for (size_t j = 0; j < n; j++) prev[order[j]] = sorted_prev[j];
+        locale_free(sorted_prev);
+      }
+      locale_free(addrs);
+      locale_free(operands);
+    }
+    
+    /// Batched fetch_and_add: `base[index[i]] += operand[i]`.
+    template< typename T, typename U >
+    void batch_fetch_and_add(GlobalAddress<T> base, const int64_t * index, const U * operand,
+                             size_t n, T * prev = nullptr) {
+      batch<batch_op::Add>(base, index, operand, n, prev);
+    }
+    
+    /// Batched min: `base[index[i]] = min(base[index[i]], operand[i])`.
+    template< typename T, typename U >
+    void batch_min(GlobalAddress<T> base, const int64_t * index, const U * operand,
+                   size_t n, T * prev = nullptr) {
+      batch<batch_op::Min>(base, index, operand, n, prev);
+    }
+    
+    /// Batched max: `base[index[i]] = max(base[index[i]], operand[i])`.
+    template< typename T, typename U >
+    void batch_max(GlobalAddress<T> base, const int64_t * index, const U * operand,
+                   size_t n, T * prev = nullptr) {
+      batch<batch_op::Max>(base, index, operand, n, prev);
+    }
+    
+    /// Batched bitwise or: `base[index[i]] |= operand[i]`.
+    template< typename T, typename U >
+    void batch_or(GlobalAddress<T> base, const int64_t * index, const U * operand,
+                  size_t n, T * prev = nullptr) {
+      batch<batch_op::Or>(base, index, operand, n, prev);
+    }
+    
+    /// Batched bitwise and: `base[index[i]] &= operand[i]`.
+    template< typename T, typename U >
+    void batch_and(GlobalAddress<T> base, const int64_t * index, const U * operand,
+                   size_t n, T * prev = nullptr) {
+      batch<batch_op::And>(base, index, operand, n, prev);
+    }
+    
+    /// Batched bitwise xor: `base[index[i]] ^= operand[i]`.
+    template< typename T, typename U >
+    void batch_xor(GlobalAddress<T> base, const int64_t * index, const U * operand,
+                   size_t n, T * prev = nullptr) {
+      batch<batch_op::Xor>(base, index, operand, n, prev);
+    }
+    
+    /// Batched compare_and_swap: if `base[index[i]] == cmp[i]`, set it to `val[i]`.
+    /// If `success` is non-null, `success[i]` records whether the swap happened.
+    template< typename T >
+    void batch_compare_and_swap(GlobalAddress<T> base, const int64_t * index,
+                                const T * cmp, const T * val, size_t n,
+                                bool * success = nullptr) {
+      std::vector<batch_op::Swap<T>> ops(n);
+      for (size_t i = 0; i < n; i++) ops[i] = batch_op::Swap<T>{ cmp[i], val[i] };
+      if (success) {
+        std::vector<T> prev(n);
+        batch<batch_op::CompareAndSwap>(base, index, ops.data(), n, prev.data());
+        for (size_t i = 0; i < n; i++) success[i] = (prev[i] == cmp[i]);
+      } else {
+        batch<batch_op::CompareAndSwap>(base, index, ops.data(), n);
+      }
+    }
+    
+  } // namespace delegate
+  
+  /// @}
+} // namespace Grappa
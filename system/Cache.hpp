@@ -54,14 +54,15 @@ public:
   bool heap_;
   CacheAllocator( T * buffer, size_t size ) 
     : storage_( buffer != NULL ? buffer : reinterpret_cast< T* >
-                ( Grappa::impl::locale_shared_memory.allocate( size * sizeof(T) ) ) )
+                ( Grappa::impl::locale_shared_memory.allocate( size * sizeof(T),
+                                                                Grappa::impl::LocaleAllocTag::Cache ) ) )
     , heap_( buffer != NULL ? false : true ) 
   {
     VLOG(6) << "buffer = " << buffer << ", storage_ = " << storage_;
   }
   ~CacheAllocator() {
     if( heap_ && storage_ != NULL ) {
-      Grappa::impl::locale_shared_memory.deallocate( storage_ );
+      Grappa::impl::locale_shared_memory.deallocate( storage_, Grappa::impl::LocaleAllocTag::Cache );
     }
   }
   operator T*() { 
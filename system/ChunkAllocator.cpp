@@ -45,12 +45,13 @@ namespace impl {
 
 
 struct aligned_allocator *aligned_allocator_create(void) {
-  return Grappa::locale_alloc_aligned<struct aligned_allocator>(CACHE_LINE_SIZE);
+  return static_cast<struct aligned_allocator*>(
+    locale_shared_memory.allocate_aligned(sizeof(struct aligned_allocator), CACHE_LINE_SIZE, LocaleAllocTag::Messages));
 }
 
 void aligned_allocator_destroy(struct aligned_allocator *aa) {
     aligned_allocator_clean(aa);
-    Grappa::locale_free(aa);
+    locale_shared_memory.deallocate(aa, LocaleAllocTag::Messages);
 }
 
 void aligned_allocator_init(struct aligned_allocator *aa,
@@ -80,7 +81,8 @@ static void _aligned_allocator_append_chunk(struct aligned_allocator *aa,
 
     chunkallocator_append++;
     
-    new_chunk = Grappa::locale_alloc_aligned<struct memory_chunk>(CACHE_LINE_SIZE);
+    new_chunk = static_cast<struct memory_chunk*>(
+      locale_shared_memory.allocate_aligned(sizeof(struct memory_chunk), CACHE_LINE_SIZE, LocaleAllocTag::Messages));
     CHECK_NOTNULL(new_chunk);
 
     auto chunk_struct_size = sizeof( struct memory_chunk );
@@ -89,7 +91,8 @@ static void _aligned_allocator_append_chunk(struct aligned_allocator *aa,
     
     new_chunk->next = NULL;
     new_chunk->chunk_size = MAX(min_size, aa->chunk_size) + aa->align_on;
-    new_chunk->chunk = Grappa::locale_alloc_aligned<char>(CACHE_LINE_SIZE, new_chunk->chunk_size);
+    new_chunk->chunk = static_cast<char*>(
+      locale_shared_memory.allocate_aligned(new_chunk->chunk_size, CACHE_LINE_SIZE, LocaleAllocTag::Messages));
     CHECK_NOTNULL(new_chunk->chunk);
 
     auto chunk_size = sizeof(new_chunk->chunk_size);
@@ -128,7 +131,8 @@ void aligned_allocator_free(struct aligned_allocator *aa, void *obj) {
 struct aligned_pool_allocator   *aligned_pool_allocator_create(void) {
   auto allocator_size = sizeof(struct aligned_pool_allocator);
   shared_pool_total_allocated += std::max( allocator_size, (decltype(allocator_size)) CACHE_LINE_SIZE );
-  return locale_alloc_aligned<struct aligned_pool_allocator>(CACHE_LINE_SIZE);
+  return static_cast<struct aligned_pool_allocator*>(
+    locale_shared_memory.allocate_aligned(allocator_size, CACHE_LINE_SIZE, LocaleAllocTag::Messages));
 }
 
 void aligned_pool_allocator_destroy(struct aligned_pool_allocator *apa) {
@@ -222,7 +222,8 @@ void Communicator::activate() {
 
   for( int i = 0; i < (1 << FLAGS_log2_concurrent_sends); ++i ) {
     char * buf;
-    buf = (char*) Grappa::impl::locale_shared_memory.allocate_aligned( (1 << FLAGS_log2_buffer_size), 8 );
+    buf = (char*) Grappa::impl::locale_shared_memory.allocate_aligned( (1 << FLAGS_log2_buffer_size), 8,
+                                                                    Grappa::impl::LocaleAllocTag::Communicator );
     //MPI_Alloc_mem( (1 << FLAGS_log2_buffer_size) , MPI_INFO_NULL, &buf );
     sends[i].buf = buf;
     sends[i].size = 1 << FLAGS_log2_buffer_size;
@@ -230,7 +231,8 @@ void Communicator::activate() {
 
   for( int i = 0; i < (1 << FLAGS_log2_concurrent_receives); ++i ) {
     char * buf;
-    buf = (char*) Grappa::impl::locale_shared_memory.allocate_aligned( (1 << FLAGS_log2_buffer_size), 8 );
+    buf = (char*) Grappa::impl::locale_shared_memory.allocate_aligned( (1 << FLAGS_log2_buffer_size), 8,
+                                                                    Grappa::impl::LocaleAllocTag::Communicator );
     //MPI_Alloc_mem( (1 << FLAGS_log2_buffer_size), MPI_INFO_NULL, &buf );
     receives[i].buf = buf;
     receives[i].size = 1 << FLAGS_log2_buffer_size;
@@ -51,3 +51,8 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cmpswaps, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_cmpswap_targets, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_fetchadds, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_fetchadd_targets, 0);
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batch_calls, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batch_elements, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batch_msgs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batch_targets, 0);
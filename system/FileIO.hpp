@@ -154,6 +154,11 @@ struct IODescriptor {
     if (!complete) wait(&cv);
   }
 
+  void block_on_write() {
+    aio_write(desc_ptr());
+    if (!complete) wait(&cv);
+  }
+
   void handle_completion() {
     complete = true;
     signal(&cv);
@@ -191,6 +196,13 @@ namespace impl {
         exit(1);
       }
       return (FileDesc)fdesc;
+    } else if (strncmp(mode, "w", FNAME_LENGTH) == 0) {
+      int fdesc = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if (fdesc == -1) {
+        LOG(FATAL) << "Error opening file for writing: " << fname;
+        exit(1);
+      }
+      return (FileDesc)fdesc;
     } else {
       fprintf(stderr, "File operation not implemented yet.\n");
       return static_cast<FileDesc>(0);
@@ -202,10 +214,22 @@ namespace impl {
   }
 
 
-  inline void fread_blocking(void * buffer, size_t bufsize, size_t offset, FileDesc file_desc) {
+  /// Read up to `bufsize` bytes at `offset`, blocking only the calling task.
+  /// Returns the number of bytes read (less than `bufsize` at the end of the file).
+  inline ssize_t fread_blocking(void * buffer, size_t bufsize, size_t offset, FileDesc file_desc) {
     IODescriptor d(file_desc, offset, buffer, bufsize);
     d.block_on_read();
     CHECK(d.complete);
+    return aio_return(d.desc_ptr());
+  }
+
+  /// Write up to `bufsize` bytes at `offset` (of a file opened with mode "w"), blocking
+  /// only the calling task. Returns the number of bytes written.
+  inline ssize_t fwrite_blocking(const void * buffer, size_t bufsize, size_t offset, FileDesc file_desc) {
+    IODescriptor d(file_desc, offset, const_cast<void*>(buffer), bufsize);
+    d.block_on_write();
+    CHECK(d.complete);
+    return aio_return(d.desc_ptr());
   }
 
   template < typename T >
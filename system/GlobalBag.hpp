@@ -1,73 +1,238 @@
+#pragma once
 #include <Grappa.hpp>
+#include <type_traits>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, bag_chunks_allocated);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, bag_chunks_spilled);
 
 namespace Grappa {
   
+  namespace impl {
+    /// Size of each GlobalBag chunk; small enough to ship as one message payload.
+    const size_t bag_chunk_bytes = 2048;
+  }
+  
   /// Global unordered queue with local insert and iteration.
   /// 
   /// Useful for situations where intermediate values may be produced 
   /// from anywhere and iterated over later. We use this mostly for 
   /// places like BFS's "frontier", where things to process next phase
   /// are stored in a bag so they can be processed without communicating.
+  ///
+  /// Each core's part of the bag is a list of fixed-size chunks, so it grows as
+  /// needed (`add()` is just a bump of a cursor until a chunk fills). `clear()` puts
+  /// the chunks back on a per-core pool for reuse rather than freeing them.
+  ///
+  /// If created with `spill = true`, a core that fills chunks beyond its share of
+  /// `total_capacity` ships each further full chunk to its neighbor core instead of
+  /// keeping it (requires trivially-copyable T). Spilled chunks are guaranteed to
+  /// have arrived by the next `size()`, `forall()` or `clear()`, so those must not
+  /// run concurrently with `add()`.
   template< typename T >
   class GlobalBag {
+    
+    struct Chunk {
+      static const size_t capacity = (impl::bag_chunk_bytes - 2*sizeof(void*)) / sizeof(T) > 0
+                                   ? (impl::bag_chunk_bytes - 2*sizeof(void*)) / sizeof(T) : 1;
+      Chunk * next;
+      size_t n;
+      typename std::aligned_storage<sizeof(T),alignof(T)>::type storage[capacity];
+      
+      T * data() { return reinterpret_cast<T*>(storage); }
+    };
+    
     GlobalAddress<GlobalBag> self;
-    T* l_storage;
-    size_t l_size;
-    size_t l_capacity;
+    
+    T * cursor;         ///< next free slot in `cur`
+    T * limit;          ///< end of `cur`
+    Chunk * cur;        ///< chunk being filled
+    Chunk * full;       ///< list of filled chunks
+    size_t l_full;      ///< number of elements in `full` chunks
+    Chunk * pool;       ///< recycled chunks
+    
+    size_t l_capacity;  ///< this core's share (only enforced with `spill`)
+    bool spill;
+    int64_t spills_out; ///< chunks sent to the neighbor
+    int64_t spills_in;  ///< chunks received by the neighbor (counted there)
+    std::vector<T*> spill_bufs;
+    
+    Chunk * get_chunk() {
+      Chunk * c = pool;
+      if (c) {
+        pool = c->next;
+      } else {
+        c = new Chunk;
+        bag_chunks_allocated++;
+      }
+      c->next = nullptr;
+      c->n = 0;
+      return c;
+    }
+    
+    /// Called when `cur` is full (or there's no `cur` yet).
+    void next_chunk() {
+      if (cur) {
+        cur->n = Chunk::capacity;
+        if (spill && cores() > 1 && l_full + cur->n > l_capacity) {
+          ship(cur);
+          cur->next = pool;
+          pool = cur;
+        } else {
+          cur->next = full;
+          full = cur;
+          l_full += cur->n;
+        }
+      }
+      cur = get_chunk();
+      cursor = cur->data();
+      limit = cursor + Chunk::capacity;
+    }
+    
+    /// Send a full chunk's contents to the neighbor core (safe in message handlers).
+    void ship(Chunk * c) {
+      auto n = c->n;
+      auto buf = locale_alloc<T>(n);
+      std::memcpy(buf, c->data(), n * sizeof(T));
+      spill_bufs.push_back(buf);
+      spills_out++;
+      bag_chunks_spilled++;
+      
+      auto self = this->self;
+      send_heap_message((mycore()+1) % cores(), [self](void * payload, size_t sz){
+        auto b = self.localize();
+        auto c = b->get_chunk();
+        c->n = sz / sizeof(T);
+        std::memcpy(c->data(), payload, sz);
+        c->next = b->full;
+        b->full = c;
+        b->l_full += c->n;
+        b->spills_in++;
+      }, buf, n * sizeof(T));
+    }
+    
+    /// Wait for all spilled chunks to arrive, then release their send buffers.
+    void settle() {
+      auto b = self;
+      if (!spill) return;
+      while (sum_all_cores([b]{ return b->spills_out - b->spills_in; }) != 0);
+      call_on_all_cores([b]{
+        for (auto buf : b->spill_bufs) locale_free(buf);
+        b->spill_bufs.clear();
+      });
+    }
+    
+    void sync_cur() { if (cur) cur->n = cursor - cur->data(); }
+    
+    void recycle(Chunk * list) {
+      while (list) {
+        auto c = list;
+        list = c->next;
+        if (!std::is_trivially_destructible<T>::value) {
+          for (T& e : util::iterate(c->data(), c->n)) e.~T();
+        }
+        c->next = pool;
+        pool = c;
+      }
+    }
+    
+    void free_chunks(Chunk * list) {
+      while (list) {
+        auto c = list;
+        list = c->next;
+        delete c;
+      }
+    }
+    
   public:
-    GlobalBag(): l_storage(nullptr), l_size(0) {}
-    GlobalBag(GlobalAddress<GlobalBag> self, size_t n):
-      self(self), l_storage(new T[n]), l_size(0), l_capacity(n) {}
-      ~GlobalBag() { if (l_storage) delete[] l_storage; }
+    GlobalBag(): cursor(nullptr), limit(nullptr), cur(nullptr), full(nullptr), l_full(0), pool(nullptr) {}
+    GlobalBag(GlobalAddress<GlobalBag> self, size_t n, bool spill):
+      self(self), cursor(nullptr), limit(nullptr), cur(nullptr), full(nullptr), l_full(0),
+      pool(nullptr), l_capacity(n), spill(spill), spills_out(0), spills_in(0) {}
+    ~GlobalBag() {
+      sync_cur();
+      recycle(full);
+      recycle(cur);
+      free_chunks(pool);
+      for (auto buf : spill_bufs) locale_free(buf);
+    }
     
-    static GlobalAddress<GlobalBag> create(size_t total_capacity) {
+    /// @param total_capacity  expected number of elements (split evenly across cores);
+    ///                        cores may exceed their share unless `spill` is set
+    /// @param spill           overflow chunks beyond a core's share to its neighbor
+    static GlobalAddress<GlobalBag> create(size_t total_capacity, bool spill = false) {
+      CHECK(!spill || std::is_trivially_copyable<T>::value)
+        << "GlobalBag can only spill trivially-copyable elements";
       auto self = symmetric_global_alloc<GlobalBag>();
       auto n = total_capacity / cores()
                + total_capacity % cores();
       call_on_all_cores([=]{
-        new (self.localize()) GlobalBag(self, n);
+        new (self.localize()) GlobalBag(self, n, spill);
       });
       return self;
     }
     
     void destroy() {
       auto self = this->self;
+      settle();
       call_on_all_cores([self]{ self->~GlobalBag(); });
       global_free(self);
     }
     
     void add(const T& o) {
-      CHECK_LT(l_size, l_capacity);
-      l_storage[l_size] = o;
-      l_size++;
+      if (cursor == limit) next_chunk();
+      new (cursor) T(o);
+      cursor++;
     }
     
     void clear() {
       auto b = self;
+      settle();
       call_on_all_cores([=]{
-        for (T& e : util::iterate(b->l_storage, b->l_size)) e.~T();
-        b->l_size = 0;
+        b->sync_cur();
+        b->recycle(b->full);
+        b->recycle(b->cur);
+        b->full = b->cur = nullptr;
+        b->cursor = b->limit = nullptr;
+        b->l_full = 0;
       });
     }
     
-    size_t local_size() { return l_size; }
+    size_t local_size() { return l_full + (cur ? cursor - cur->data() : 0); }
     
     size_t size() {
       auto b = self;
-      return sum_all_cores([=]{ return b->l_size; });
+      settle();
+      return sum_all_cores([=]{ return b->local_size(); });
     }
     
     bool empty() { return size() == 0; }
     
+    /// Iterate over just this core's elements (no communication).
+    template< typename F >
+    void forall_local(F f) {
+      sync_cur();
+      if (cur) for (T& e : util::iterate(cur->data(), cur->n)) f(e);
+      for (auto c = full; c; c = c->next) {
+        for (T& e : util::iterate(c->data(), c->n)) f(e);
+      }
+    }
+    
     template< SyncMode S = SyncMode::Blocking,
               GlobalCompletionEvent * C = &impl::local_gce,
               int64_t Th = impl::USE_LOOP_THRESHOLD_FLAG,
               typename F = nullptr_t >
     static void impl_iterator(GlobalAddress<GlobalBag> b, F body) {
+      b->settle();
       on_all_cores([=]{
-        Grappa::forall_here<TaskMode::Bound,SyncMode::Async,C,Th>(0, b->l_size, [=](int64_t i){
-          body(b->l_storage[i]);
-        });
+        b->sync_cur();
+        auto iterate_chunk = [=](Chunk * c){
+          auto data = c->data();
+          Grappa::forall_here<TaskMode::Bound,SyncMode::Async,C,Th>(0, c->n, [=](int64_t i){
+            body(data[i]);
+          });
+        };
+        if (b->cur) iterate_chunk(b->cur);
+        for (auto c = b->full; c; c = c->next) iterate_chunk(c);
       });
       if (S == SyncMode::Blocking && C) C->wait();
     }
@@ -81,4 +246,4 @@ namespace Grappa {
   void forall(GlobalAddress<GlobalBag<T>> b, F body) {
     GlobalBag<T>::template impl_iterator<S,C,Th>(b, body);
   }
-}
\ No newline at end of file
+}
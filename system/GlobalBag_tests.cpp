@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalBag.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalBag_tests );
+
+DEFINE_int64(nelems, 10007, "number of elements");
+
+/// All elements are added on one core, far beyond its share.
+void test_grow() {
+  int64_t N = FLAGS_nelems;
+  auto bag = GlobalBag<int64_t>::create(cores());
+  
+  for (int64_t i = 0; i < N; i++) bag->add(i);
+  BOOST_CHECK_EQUAL(bag->local_size(), N);
+  BOOST_CHECK_EQUAL(bag->size(), N);
+  
+  static int64_t total;
+  call_on_all_cores([]{ total = 0; });
+  forall(bag, [](int64_t& e){ total += e; });
+  int64_t sum = reduce<int64_t,collective_add>(&total);
+  BOOST_CHECK_EQUAL(sum, N*(N-1)/2);
+  
+  // cleared chunks are reused
+  bag->clear();
+  BOOST_CHECK(bag->empty());
+  auto allocated = bag_chunks_allocated.value();
+  for (int64_t i = 0; i < N; i++) bag->add(i);
+  BOOST_CHECK_EQUAL(bag_chunks_allocated.value(), allocated);
+  
+  int64_t local_sum = 0;
+  bag->forall_local([&local_sum](int64_t& e){ local_sum += e; });
+  BOOST_CHECK_EQUAL(local_sum, N*(N-1)/2);
+  
+  bag->destroy();
+}
+
+/// Adds beyond a core's share go to its neighbor.
+void test_spill() {
+  int64_t N = FLAGS_nelems;
+  auto bag = GlobalBag<int64_t>::create(cores(), true);
+  
+  on_all_cores([bag,N]{
+    if (mycore() == 0) for (int64_t i = 0; i < N; i++) bag->add(i);
+  });
+  BOOST_CHECK_EQUAL(bag->size(), N);
+  if (cores() > 1) {
+    auto neighbor = delegate::call(1, [bag]{ return bag->local_size(); });
+    BOOST_CHECK_GT(neighbor, 0);
+  }
+  
+  static int64_t total;
+  call_on_all_cores([]{ total = 0; });
+  forall(bag, [](int64_t& e){ total += e; });
+  int64_t sum = reduce<int64_t,collective_add>(&total);
+  BOOST_CHECK_EQUAL(sum, N*(N-1)/2);
+  
+  bag->destroy();
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_grow();
+    test_spill();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,361 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GlobalAllocator.hpp"
+#include "ParallelLoop.hpp"
+#include "Delegate.hpp"
+#include "Collective.hpp"
+#include "LocaleSharedMemory.hpp"
+#include "Metrics.hpp"
+#include <vector>
+#include <cstring>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, bitmap_batch_calls);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, bitmap_batch_msgs);
+
+namespace Grappa {
+
+/// @addtogroup Containers
+/// @{
+
+/// Distributed bitmap whose bits live on the same cores as the elements of a global
+/// array (e.g. a graph's vertex array), so bit `i` can be tested or updated right next to
+/// element `i` without communication.
+///
+/// Each core packs the bits it owns densely into local words, so whole-bitmap operations
+/// (count, union, intersect, andnot, scanning set bits) are tight word loops over local
+/// memory. Single-bit atomics are delegates to the owning core; batches of bits are
+/// grouped by destination and sent as one message per core (per `MAX_MESSAGE_SIZE`).
+///
+/// @b Example:
+/// @code
+///   auto visited = GlobalBitmap::create(g->nv, g->vs);  // same layout as vertices
+///   forall(g, [=](VertexID i, G::Vertex& v){
+///     if (visited->local_test(i)) ...                    // no communication
+///   });
+///   if (!visited->test_and_set(j)) { ... first to visit j ... }
+/// @endcode
+class GlobalBitmap {
+public:
+  // private members (per core)
+  GlobalAddress<GlobalBitmap> self;
+  size_t nbits;
+  intptr_t layout_base;   ///< global byte address of element 0 of the layout
+  size_t elem_size;       ///< bytes per element of the layout (divides block_size)
+  int64_t local_origin;   ///< position (in elements) of this core's first bit in its local layout
+  size_t nlocal;          ///< number of bits this core owns
+  size_t nwords;
+  uint64_t * words;
+  
+  GlobalBitmap(GlobalAddress<GlobalBitmap> self, size_t nbits, intptr_t layout_base, size_t elem_size)
+    : self(self), nbits(nbits), layout_base(layout_base), elem_size(elem_size)
+    , local_origin(0), nlocal(0), nwords(0), words(nullptr)
+  {
+    CHECK_EQ(block_size % elem_size, 0) << "layout elements must evenly divide blocks";
+    CHECK_EQ((layout_base % block_size) % elem_size, 0);
+    
+    // each core's elements are contiguous in its local memory, so its bits are the
+    // dense range between its first and last element
+    int64_t n = nbits;
+    int64_t span = cores() * (block_size / elem_size);
+    int64_t first = -1, last = -1;
+    for (int64_t i = 0; i < std::min(n, span); i++) {
+      if (owner(i) == mycore()) { first = i; break; }
+    }
+    for (int64_t i = n-1; i >= std::max<int64_t>(0, n-span); i--) {
+      if (owner(i) == mycore()) { last = i; break; }
+    }
+    if (first >= 0) {
+      local_origin = local_byte(first) / elem_size;
+      nlocal = local_index(last) + 1;
+    }
+    nwords = (nlocal + 63) / 64;
+    words = nwords ? locale_alloc<uint64_t>(nwords) : nullptr;
+    if (words) std::memset(words, 0, nwords * sizeof(uint64_t));
+  }
+  
+  ~GlobalBitmap() { if (words) locale_free(words); }
+  
+  intptr_t byte_of(int64_t i) const { return layout_base + i * elem_size; }
+  
+  /// Offset of element `i` within its owner's local portion of the layout.
+  intptr_t local_byte(int64_t i) const {
+    intptr_t a = byte_of(i);
+    intptr_t b = a / block_size;
+    return (b / cores()) * block_size + a % block_size;
+  }
+  
+  size_t local_index(int64_t i) const { return local_byte(i) / elem_size - local_origin; }
+  
+  /// Inverse of `local_index` on this core.
+  int64_t global_index(size_t li) const {
+    intptr_t lb = (li + local_origin) * elem_size;
+    intptr_t a = ((lb / block_size) * cores() + mycore()) * block_size + lb % block_size;
+    return (a - layout_base) / elem_size;
+  }
+  
+  static GlobalAddress<GlobalBitmap> create_with_layout(size_t n, intptr_t base, size_t esz) {
+    auto self = symmetric_global_alloc<GlobalBitmap>();
+    call_on_all_cores([self,n,base,esz]{
+      new (self.localize()) GlobalBitmap(self, n, base, esz);
+    });
+    return self;
+  }
+  
+  static size_t local_count_of(GlobalAddress<GlobalBitmap> b) { return b->local_count(); }
+  
+  template< typename Op >
+  void combine(GlobalAddress<GlobalBitmap> other, Op op) {
+    auto self = this->self;
+    CHECK(other->nbits == nbits && other->layout_base == layout_base
+          && other->elem_size == elem_size) << "bitmaps must share a layout";
+    call_on_all_cores([self,other,op]{
+      uint64_t * __restrict a = self->words;
+      const uint64_t * __restrict b = other->words;
+      size_t n = self->nwords;
+      for (size_t w = 0; w < n; w++) a[w] = op(a[w], b[w]);
+    });
+  }
+  
+  /// Apply `op(word, mask)` to each index, grouped into one message per core; returns the
+  /// number of bits whose value changed.
+  template< typename Op >
+  size_t batch(const int64_t * index, size_t n, Op op) {
+    ++bitmap_batch_calls;
+    if (n == 0) return 0;
+    auto self = this->self;
+    Core origin = mycore();
+    const size_t max_per_msg = MAX_MESSAGE_SIZE / sizeof(int64_t);
+    
+    // counting sort by destination, into a locale-shared buffer usable as payload
+    std::vector<size_t> offsets(cores()+1, 0);
+    for (size_t i = 0; i < n; i++) offsets[owner(index[i])+1]++;
+    for (Core c = 0; c < cores(); c++) offsets[c+1] += offsets[c];
+    auto sorted = locale_alloc<int64_t>(n);
+    {
+      std::vector<size_t> pos(offsets.begin(), offsets.end()-1);
+      for (size_t i = 0; i < n; i++) sorted[pos[owner(index[i])]++] = index[i];
+    }
+    
+    size_t nmsg = 0;
+    for (Core c = 0; c < cores(); c++) if (c != origin) {
+      size_t m = offsets[c+1] - offsets[c];
+      nmsg += (m + max_per_msg - 1) / max_per_msg;
+    }
+    
+    CompletionEvent ce(nmsg);
+    auto pce = &ce;
+    size_t changed = 0;
+    auto pchanged = &changed;
+    
+    for (Core c = 0; c < cores(); c++) if (c != origin) {
+      for (size_t s = offsets[c]; s < offsets[c+1]; s += max_per_msg) {
+        size_t m = std::min(max_per_msg, offsets[c+1] - s);
+        ++bitmap_batch_msgs;
+        send_heap_message(c, [self,origin,pce,pchanged,op](void * payload, size_t psz){
+          auto idx = static_cast<int64_t*>(payload);
+          size_t ch = self->apply_local(idx, psz / sizeof(int64_t), op);
+          send_heap_message(origin, [pce,pchanged,ch]{
+            *pchanged += ch;
+            pce->complete();
+          });
+        }, sorted + s, m * sizeof(int64_t));
+      }
+    }
+    
+    changed += apply_local(sorted + offsets[origin], offsets[origin+1] - offsets[origin], op);
+    ce.wait();
+    locale_free(sorted);
+    return changed;
+  }
+  
+  template< typename Op >
+  size_t apply_local(const int64_t * idx, size_t n, Op op) {
+    size_t changed = 0;
+    for (size_t j = 0; j < n; j++) {
+      size_t li = local_index(idx[j]);
+      uint64_t& w = words[li / 64];
+      uint64_t old = w;
+      w = op(w, uint64_t(1) << (li % 64));
+      changed += (old != w);
+    }
+    return changed;
+  }
+  
+public:
+  // for static construction
+  GlobalBitmap() {}
+  
+  /// Bitmap of `n` bits laid out like the elements of `layout` (bit `i` lives on
+  /// `(layout+i).core()`). `sizeof(T)` must evenly divide the block size.
+  template< typename T >
+  static GlobalAddress<GlobalBitmap> create(size_t n, GlobalAddress<T> layout) {
+    CHECK(!layout.is_2D()) << "layout must be a linear (global heap) array";
+    return create_with_layout(n, layout.raw_bits(), sizeof(T));
+  }
+  
+  /// Bitmap of `n` bits laid out like an array of block-sized elements starting on core
+  /// 0 (bit `i` on core `i % cores()`).
+  static GlobalAddress<GlobalBitmap> create(size_t n) {
+    return create_with_layout(n, 0, block_size);
+  }
+  
+  /// New, empty bitmap with the same size and layout as `other`.
+  static GlobalAddress<GlobalBitmap> create_like(GlobalAddress<GlobalBitmap> other) {
+    return create_with_layout(other->nbits, other->layout_base, other->elem_size);
+  }
+  
+  void destroy() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->~GlobalBitmap(); });
+    global_free(self);
+  }
+  
+  size_t size() const { return nbits; }
+  
+  Core owner(int64_t i) const { return (byte_of(i) / block_size) % cores(); }
+  
+  ///
+  /// Local operations: only valid on `owner(i)`. These never block or communicate, so
+  /// they can be used inside delegates and message handlers.
+  ///
+  
+  bool local_test(int64_t i) const {
+    DCHECK_EQ(owner(i), mycore());
+    size_t li = local_index(i);
+    return (words[li / 64] >> (li % 64)) & 1;
+  }
+  
+  /// Set bit `i`, returning its previous value.
+  bool local_test_and_set(int64_t i) {
+    DCHECK_EQ(owner(i), mycore());
+    size_t li = local_index(i);
+    uint64_t mask = uint64_t(1) << (li % 64);
+    bool prev = words[li / 64] & mask;
+    words[li / 64] |= mask;
+    return prev;
+  }
+  
+  /// Clear bit `i`, returning its previous value.
+  bool local_test_and_clear(int64_t i) {
+    DCHECK_EQ(owner(i), mycore());
+    size_t li = local_index(i);
+    uint64_t mask = uint64_t(1) << (li % 64);
+    bool prev = words[li / 64] & mask;
+    words[li / 64] &= ~mask;
+    return prev;
+  }
+  
+  /// Number of set bits on this core.
+  size_t local_count() const {
+    size_t c = 0;
+    for (size_t w = 0; w < nwords; w++) c += __builtin_popcountll(words[w]);
+    return c;
+  }
+  
+  ///
+  /// Global operations, callable from any task.
+  ///
+  
+  bool test(int64_t i) {
+    auto self = this->self;
+    return delegate::call(owner(i), [self,i]{ return self->local_test(i); });
+  }
+  
+  /// Atomically set bit `i` at its owner, returning its previous value (so exactly one
+  /// caller sees `false`).
+  bool test_and_set(int64_t i) {
+    auto self = this->self;
+    return delegate::call(owner(i), [self,i]{ return self->local_test_and_set(i); });
+  }
+  
+  bool test_and_clear(int64_t i) {
+    auto self = this->self;
+    return delegate::call(owner(i), [self,i]{ return self->local_test_and_clear(i); });
+  }
+  
+  /// Set the bits at `index[0..n)`; returns how many were not already set.
+  size_t set(const int64_t * index, size_t n) {
+    return batch(index, n, [](uint64_t w, uint64_t m){ return w | m; });
+  }
+  
+  /// Clear the bits at `index[0..n)`; returns how many were set.
+  size_t clear(const int64_t * index, size_t n) {
+    return batch(index, n, [](uint64_t w, uint64_t m){ return w & ~m; });
+  }
+  
+  /// Clear all bits (collective).
+  void clear() {
+    auto self = this->self;
+    call_on_all_cores([self]{
+      if (self->words) std::memset(self->words, 0, self->nwords * sizeof(uint64_t));
+    });
+  }
+  
+  /// Total number of set bits (collective).
+  size_t count() {
+    return reduce<size_t,GlobalBitmap,collective_add,&local_count_of>(self);
+  }
+  
+  /// this |= other (collective; bitmaps must share a layout)
+  void union_with(GlobalAddress<GlobalBitmap> other) {
+    combine(other, [](uint64_t a, uint64_t b){ return a | b; });
+  }
+  
+  /// this &= other
+  void intersect_with(GlobalAddress<GlobalBitmap> other) {
+    combine(other, [](uint64_t a, uint64_t b){ return a & b; });
+  }
+  
+  /// this &= ~other
+  void andnot_with(GlobalAddress<GlobalBitmap> other) {
+    combine(other, [](uint64_t a, uint64_t b){ return a & ~b; });
+  }
+  
+  /// Parallel loop over the indices of set bits, run on their owners: `body(int64_t i)`.
+  template< SyncMode S = SyncMode::Blocking,
+            GlobalCompletionEvent * C = &impl::local_gce,
+            int64_t Th = impl::USE_LOOP_THRESHOLD_FLAG,
+            typename F = nullptr_t >
+  void forall_set(F body) {
+    auto b = self;
+    on_all_cores([=]{
+      Grappa::forall_here<TaskMode::Bound,SyncMode::Async,C,Th>(0, b->nwords, [=](int64_t w){
+        uint64_t x = b->words[w];
+        while (x) {
+          int bit = __builtin_ctzll(x);
+          x &= x - 1;
+          body(b->global_index(w*64 + bit));
+        }
+      });
+    });
+    if (S == SyncMode::Blocking && C) C->wait();
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// @}
+
+} // namespace Grappa
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalBitmap.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalBitmap_tests );
+
+DEFINE_int64(nelems, 10007, "number of bits");
+
+struct Pair { int64_t a, b; };
+
+/// Bits are co-located with the elements of the layout array.
+void test_layout() {
+  int64_t N = FLAGS_nelems;
+  auto arr = global_alloc<Pair>(N);
+  auto bm = GlobalBitmap::create(N, arr);
+  
+  forall(arr, N, [bm,arr](int64_t i, Pair& p){
+    BOOST_CHECK_EQUAL(bm->owner(i), mycore());
+    BOOST_CHECK(!bm->local_test_and_set(i));
+  });
+  BOOST_CHECK_EQUAL(bm->count(), N);
+  
+  // local indices are dense and invertible
+  on_all_cores([bm]{
+    for (size_t li = 0; li < bm->nlocal; li++) {
+      auto i = bm->global_index(li);
+      if (i < (int64_t)bm->size()) {
+        BOOST_CHECK_EQUAL(bm->owner(i), mycore());
+        BOOST_CHECK_EQUAL(bm->local_index(i), li);
+      }
+    }
+  });
+  
+  bm->destroy();
+  global_free(arr);
+}
+
+void test_atomics_and_batches() {
+  int64_t N = FLAGS_nelems;
+  auto bm = GlobalBitmap::create(N);
+  
+  BOOST_CHECK(!bm->test_and_set(7));
+  BOOST_CHECK(bm->test_and_set(7));
+  BOOST_CHECK(bm->test(7));
+  BOOST_CHECK(bm->test_and_clear(7));
+  BOOST_CHECK(!bm->test(7));
+  
+  // every 3rd bit, with duplicates
+  std::vector<int64_t> idx;
+  for (int64_t i = 0; i < N; i += 3) { idx.push_back(i); idx.push_back(i); }
+  size_t changed = bm->set(&idx[0], idx.size());
+  BOOST_CHECK_EQUAL(changed, (N+2)/3);
+  BOOST_CHECK_EQUAL(bm->count(), (N+2)/3);
+  
+  static int64_t seen;
+  call_on_all_cores([]{ seen = 0; });
+  bm->forall_set([bm](int64_t i){
+    BOOST_CHECK_EQUAL(i % 3, 0);
+    BOOST_CHECK_EQUAL(bm->owner(i), mycore());
+    seen++;
+  });
+  int64_t total = reduce<int64_t,collective_add>(&seen);
+  BOOST_CHECK_EQUAL(total, (N+2)/3);
+  
+  std::vector<int64_t> some = {0, 1, 3};
+  BOOST_CHECK_EQUAL(bm->clear(&some[0], some.size()), 2);
+  bm->destroy();
+}
+
+void test_word_ops() {
+  int64_t N = FLAGS_nelems;
+  auto a = GlobalBitmap::create(N);
+  auto b = GlobalBitmap::create_like(a);
+  
+  std::vector<int64_t> evens, threes;
+  for (int64_t i = 0; i < N; i += 2) evens.push_back(i);
+  for (int64_t i = 0; i < N; i += 3) threes.push_back(i);
+  a->set(&evens[0], evens.size());
+  b->set(&threes[0], threes.size());
+  
+  int64_t sixes = (N+5)/6;
+  a->intersect_with(b);
+  BOOST_CHECK_EQUAL(a->count(), sixes);
+  a->union_with(b);
+  BOOST_CHECK_EQUAL(a->count(), (int64_t)threes.size());
+  a->andnot_with(b);
+  BOOST_CHECK_EQUAL(a->count(), 0);
+  
+  a->destroy();
+  b->destroy();
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_layout();
+    test_atomics_and_batches();
+    test_word_ops();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
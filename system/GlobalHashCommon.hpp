@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Addressing.hpp"
+#include <functional>
+#include <vector>
+#include <new>
+
+namespace Grappa {
+
+/// Finalizer from MurmurHash3: scrambles all bits of `k` so that nearby keys land in
+/// unrelated cells even when taken modulo a small capacity.
+inline uint64_t hash_mix64(uint64_t k) {
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+/// Default hash for GlobalHashMap/GlobalHashSet: `std::hash` (so existing
+/// specializations for user key types keep working) followed by a fast 64-bit mix,
+/// since `std::hash` of integers is the identity.
+template< typename K >
+struct hash {
+  size_t operator()(const K& k) const { return hash_mix64(std::hash<K>()(k)); }
+};
+
+namespace impl {
+
+/// Bucket of a global hash table, packed into one block so a lookup touches a single
+/// cache line at the owning core in the common case.
+///
+/// The first few entries are stored inline (as many as fit next to the header); only
+/// cells with unusually long chains spill into a separately-allocated overflow vector.
+/// `Entry` must have a `key` member comparable with `==`.
+template< typename Entry >
+struct HashCell {
+  static const size_t header_size = sizeof(std::vector<Entry>*) + 2*sizeof(uint32_t);
+  static const size_t inline_capacity = (block_size - header_size) / sizeof(Entry);
+  
+  std::vector<Entry> * overflow;
+  uint32_t ninline;
+  uint32_t flags;   ///< spare bits for the owning container's per-cell state
+  typename std::aligned_storage< block_size - header_size, alignof(Entry) >::type storage;
+  
+  HashCell(): overflow(nullptr), ninline(0), flags(0) {}
+  ~HashCell() { clear(); }
+  
+  Entry * inline_entries() { return reinterpret_cast<Entry*>(&storage); }
+  
+  size_t size() const { return ninline + (overflow ? overflow->size() : 0); }
+  
+  void clear() {
+    for (uint32_t i = 0; i < ninline; i++) inline_entries()[i].~Entry();
+    ninline = 0;
+    if (overflow) { delete overflow; overflow = nullptr; }
+  }
+  
+  /// Find the entry for `key`, or nullptr.
+  template< typename K >
+  Entry * find(const K& key) {
+    Entry * es = inline_entries();
+    for (uint32_t i = 0; i < ninline; i++) if (es[i].key == key) return &es[i];
+    if (overflow) for (auto& e : *overflow) if (e.key == key) return &e;
+    return nullptr;
+  }
+  
+  /// Add a new entry (caller must have checked it's not already present).
+  template< typename... Args >
+  Entry * emplace(Args&&... args) {
+    if (ninline < inline_capacity) {
+      return new (inline_entries() + ninline++) Entry(std::forward<Args>(args)...);
+    } else {
+      if (overflow == nullptr) overflow = new std::vector<Entry>();
+      overflow->emplace_back(std::forward<Args>(args)...);
+      return &overflow->back();
+    }
+  }
+  
+  /// Remove the entry for `key` (filling its slot from the end so inline entries stay
+  /// packed); returns false if there was none.
+  template< typename K >
+  bool erase(const K& key) {
+    Entry * es = inline_entries();
+    for (uint32_t i = 0; i < ninline; i++) {
+      if (es[i].key == key) {
+        if (overflow && !overflow->empty()) {
+          es[i] = std::move(overflow->back());
+          overflow->pop_back();
+        } else {
+          if (i != ninline-1) es[i] = std::move(es[ninline-1]);
+          ninline--;
+          es[ninline].~Entry();
+        }
+        return true;
+      }
+    }
+    if (overflow) {
+      for (auto& e : *overflow) {
+        if (e.key == key) {
+          if (&e != &overflow->back()) e = std::move(overflow->back());
+          overflow->pop_back();
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+  
+  template< typename F >
+  void for_each(F f) {
+    Entry * es = inline_entries();
+    for (uint32_t i = 0; i < ninline; i++) f(es[i]);
+    if (overflow) for (auto& e : *overflow) f(e);
+  }
+};
+
+} // namespace impl
+} // namespace Grappa
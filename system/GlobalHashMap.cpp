@@ -21,9 +21,27 @@
 // http://www.affero.org/oagpl.html.
 ////////////////////////////////////////////////////////////////////////
 
+#include "GlobalHashMap.hpp"
 #include "GlobalHashSet.hpp"
 
 GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_insert_ops, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_insert_msgs, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_lookup_ops, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_lookup_msgs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_update_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_update_msgs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_combined_updates, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_erase_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_resizes, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_migrated_entries, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_forwarded_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<size_t>, hashmap_retried_ops, 0);
+
+DEFINE_double(global_hash_max_load, 4.0, "Average entries per GlobalHashMap cell (on any core) that triggers doubling the table; <= 0 disables automatic resizing");
+
+namespace Grappa {
+namespace impl {
+  GlobalCompletionEvent hashmap_resize_gce;
+  bool hashmap_resize_busy = false; ///< (core 0) some map's resize is using hashmap_resize_gce
+}
+}
@@ -27,19 +27,54 @@
 #include "ParallelLoop.hpp"
 #include "Metrics.hpp"
 #include "FlatCombiner.hpp"
+#include "FullEmpty.hpp"
+#include "Collective.hpp"
+#include "GlobalHashCommon.hpp"
 #include <utility>
 #include <unordered_map>
+#include <unordered_set>
+#include <tuple>
 #include <vector>
 
+DECLARE_double(global_hash_max_load);
+
 GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_insert_ops);
 GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_insert_msgs);
 GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_lookup_ops);
 GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_lookup_msgs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_update_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_update_msgs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_combined_updates);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_erase_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_resizes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_migrated_entries);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_forwarded_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashmap_retried_ops);
 
 
 namespace Grappa {
 
-template< typename K, typename V > 
+namespace impl {
+  extern GlobalCompletionEvent hashmap_resize_gce;
+  extern bool hashmap_resize_busy;
+}
+
+/// Distributed hash map, stored as a global array of cells (buckets) hashed by key.
+///
+/// Each cell is one block holding its first few entries inline (see impl::HashCell);
+/// `Hash` may be replaced by any functor mapping keys to `size_t`.
+///
+/// The table grows online: when the entries stored on any core exceed
+/// `--global_hash_max_load` per local cell, core 0 kicks off a resize to twice the
+/// capacity (or call `resize()` explicitly). Cells are migrated to the new table in the
+/// background while inserts and lookups continue; an operation that reaches a cell that
+/// has already moved is forwarded to the new table, one that reaches a cell in the middle
+/// of moving is retried. Once every cell has moved, all cores switch over to the new table
+/// and the old one is freed as soon as operations still using it have drained.
+///
+/// Whole-table operations (`size`, `clear`, `destroy`, `forall_entries`, `forall`) first
+/// wait for any pending resize to finish (see `wait_resize()`).
+template< typename K, typename V, typename Hash = Grappa::hash<K> > 
 class GlobalHashMap {
 public:
   struct Entry {
@@ -55,33 +90,50 @@ public:
     V val;
   };
   
+  /// Folds `update` into the value already stored for a key (e.g. `current += update`).
+  /// Runs at the cell's owner, and also at the sender to pre-combine updates to the same
+  /// key, so it must be associative. Being a plain function pointer (captureless lambdas
+  /// convert implicitly), it is valid on every core.
+  typedef void (*MergeFn)(V& current, const V& update);
+  
 public:
-  struct Cell { // TODO: keep first few in the 64-byte block, then go to secondary storage
-    std::vector<Entry> entries;
-    
-    Cell() : entries() { entries.reserve(10); }
-    
-    void clear() { entries.clear(); }
+  struct Cell : public impl::HashCell<Entry> {
+    /// Cell flags used during a resize.
+    enum : uint32_t { MOVING = 0x1, MOVED = 0x2 };
     
     std::pair<bool,V> lookup(K key) {
-      
-      for (auto& e : this->entries) if (e.key == key) return std::pair<bool,K>{true, e.val};
-      return std::pair<bool,K>(false,V());
+      Entry * e = this->find(key);
+      if (e) return std::pair<bool,V>(true, e->val);
+      return std::pair<bool,V>(false, V());
     }
+    
     void insert(const K& key, const V& val) {
-      bool found = false;
-      for (auto& e : entries) {
-        if (e.key == key) {
-          e.val = val;
-          found = true;
-          break;
-        }
+      Entry * e = this->find(key);
+      if (e) {
+        e->val = val;
+      } else {
+        this->emplace(key, val);
       }
-      if (!found) {
-        entries.emplace_back(key, val);
+    }
+    
+    /// Insert `val` if `key` is absent, otherwise merge it into the existing value.
+    void update(const K& key, const V& val, MergeFn merge) {
+      Entry * e = this->find(key);
+      if (e) {
+        merge(e->val, val);
+      } else {
+        this->emplace(key, val);
       }
     }
   } GRAPPA_BLOCK_ALIGNED;
+  
+  /// Snapshot of the table an operation was issued against. Holding one keeps that
+  /// table from being freed by a concurrent resize (see `acquire`/`release`).
+  struct Table {
+    GlobalAddress<Cell> base;
+    size_t capacity;
+    uint64_t epoch;
+  };
 
   struct Proxy {
     static const size_t LOCAL_HASH_SIZE = 1<<10;
@@ -89,21 +141,25 @@ public:
     GlobalHashMap * owner;
     std::unordered_map<K,V> map;
     std::unordered_map<K,ResultEntry*> lookups;
+    std::unordered_map<K,std::pair<V,MergeFn>> updates;
+    std::vector<std::tuple<K,V,MergeFn>> unmerged; ///< same key, different merge function
     
     Proxy(GlobalHashMap * owner): owner(owner)
       , map(LOCAL_HASH_SIZE)
       , lookups(LOCAL_HASH_SIZE)
+      , updates(LOCAL_HASH_SIZE)
     {
       clear();
     }
     
-    void clear() { map.clear(); lookups.clear(); }
+    void clear() { map.clear(); lookups.clear(); updates.clear(); unmerged.clear(); }
     
     Proxy * clone_fresh() { return locale_new<Proxy>(owner); }
     
     bool is_full() {
       return map.size() >= LOCAL_HASH_SIZE
-          || lookups.size() >= LOCAL_HASH_SIZE;
+          || lookups.size() >= LOCAL_HASH_SIZE
+          || updates.size() + unmerged.size() >= LOCAL_HASH_SIZE;
     }
     
     void insert(const K& newk, const V& newv) {
@@ -112,34 +168,57 @@ public:
       }
     }
     
+    /// Combine with any pending insert or update of the same key.
+    void update(const K& k, const V& v, MergeFn merge) {
+      auto i = map.find(k);
+      if (i != map.end()) {
+        merge(i->second, v);
+        ++hashmap_combined_updates;
+        return;
+      }
+      auto u = updates.find(k);
+      if (u == updates.end()) {
+        updates.emplace(k, std::make_pair(v, merge));
+      } else if (u->second.second == merge) {
+        merge(u->second.first, v);
+        ++hashmap_combined_updates;
+      } else {
+        unmerged.emplace_back(k, v, merge);
+      }
+    }
+    
     void sync() {
-      CompletionEvent ce(map.size()+lookups.size());
+      CompletionEvent ce(map.size()+lookups.size()+updates.size()+unmerged.size());
       auto cea = make_global(&ce);
+      auto t = owner->acquire();
       
       for (auto& e : map) { auto& k = e.first; auto& v = e.second;
         ++hashmap_insert_msgs;
-        auto cell = owner->base+owner->computeIndex(k);
-        send_heap_message(cell.core(), [cell,cea,k,v]{
-          cell->insert(k, v);
+        visit_cell(owner->self, t, k, [cea,k,v](Cell& c){
+          c.insert(k, v);
           complete(cea);
         });
       }
       
+      auto send_update = [this,&t,cea](K k, V v, MergeFn merge){
+        ++hashmap_update_msgs;
+        visit_cell(owner->self, t, k, [cea,k,v,merge](Cell& c){
+          c.update(k, v, merge);
+          complete(cea);
+        });
+      };
+      for (auto& e : updates) send_update(e.first, e.second.first, e.second.second);
+      for (auto& e : unmerged) send_update(std::get<0>(e), std::get<1>(e), std::get<2>(e));
+      
       for (auto& e : lookups) { auto k = e.first;
         ++hashmap_lookup_msgs;
         auto re = e.second;
         DVLOG(3) << "lookup " << k << " with re = " << re;
-        auto cell = owner->base+owner->computeIndex(k);
         
-        send_heap_message(cell.core(), [cell,k,cea,re]{
-          Cell * c = cell.localize();
-          bool found = false;
-          V val;
-          for (auto& e : c->entries) if (e.key == k) {
-            found = true;
-            val = e.val;
-            break;
-          }
+        visit_cell(owner->self, t, k, [k,cea,re](Cell& c){
+          auto r = c.lookup(k);
+          bool found = r.first;
+          V val = r.second;
           send_heap_message(cea.core(), [cea,re,found,val]{
             ResultEntry * r = re;
             while (r != nullptr) {
@@ -152,6 +231,7 @@ public:
         });
       }
       ce.wait();
+      owner->release(t);
     }
   };
 
@@ -161,17 +241,228 @@ public:
   size_t capacity;
   
   FlatCombiner<Proxy> proxy;
+  
+  // resize state (per core)
+  GlobalAddress< Cell > next_base;  ///< table being migrated into (only while next_capacity != 0)
+  size_t next_capacity;
+  uint64_t epoch;                   ///< bumped at each switch-over
+  int64_t refs[2];                  ///< operations in flight from this core, by epoch parity
+  int64_t local_entries;            ///< entries stored in cells on this core
+  bool resize_requested;            ///< this core's resize request hasn't been dealt with yet
+  bool resizing;                    ///< (core 0 only) a resize is in progress
 
-  uint64_t computeIndex(K key) {
-    static std::hash<K> hasher;
-    return hasher(key) % capacity;
+  static uint64_t index(const K& key, size_t cap) {
+    static Hash hasher;
+    return hasher(key) % cap;
+  }
+  
+  uint64_t computeIndex(K key) { return index(key, capacity); }
+  
+  static int64_t local_entries_of(GlobalAddress<GlobalHashMap> m) { return m->local_entries; }
+  static int64_t resize_requests_of(GlobalAddress<GlobalHashMap> m) { return m->resize_requested; }
+  
+  Table acquire() {
+    refs[epoch & 1]++;
+    return Table{ base, capacity, epoch };
+  }
+  
+  void release(const Table& t) { refs[t.epoch & 1]--; }
+  
+  /// Run `f(Cell&)` on the cell that currently holds `key`, starting from table `t`.
+  /// May be called from a task or a message handler; `f` runs in handler context at the
+  /// cell's core (so it must not block) and is responsible for notifying the origin.
+  template< typename F >
+  static void visit_cell(GlobalAddress<GlobalHashMap> self, Table t, K key, F f) {
+    auto cell = t.base + index(key, t.capacity);
+    if (cell.core() != mycore()) {
+      send_heap_message(cell.core(), [self,t,key,f]{ visit_cell(self, t, key, f); });
+      return;
+    }
+    
+    auto c = cell.localize();
+    auto m = self.localize();
+    if (c->flags & Cell::MOVING) {
+      // entries are in flight to the new table; try again once they've landed
+      ++hashmap_retried_ops;
+      send_heap_message(mycore(), [self,t,key,f]{ visit_cell(self, t, key, f); });
+    } else if (c->flags & Cell::MOVED) {
+      ++hashmap_forwarded_ops;
+      CHECK_GT(m->next_capacity, 0) << "moved cell without a table to forward to";
+      visit_cell(self, Table{ m->next_base, m->next_capacity, t.epoch }, key, f);
+    } else {
+      int64_t before = c->size();
+      f(*c);
+      m->local_entries += static_cast<int64_t>(c->size()) - before;
+      m->check_load();
+    }
+  }
+  
+  /// Ask core 0 for a resize once the entries on this core pass the load threshold.
+  ///
+  /// `resize_requested` stays set until core 0 has either turned the request down or
+  /// finished the resize it started, so `wait_resize()` can see requests still in flight.
+  void check_load() {
+    if (FLAGS_global_hash_max_load <= 0 || resize_requested || next_capacity != 0) return;
+    auto local_cells = std::max<size_t>(1, capacity / cores());
+    if (local_entries > FLAGS_global_hash_max_load * local_cells) {
+      resize_requested = true;
+      auto self = this->self;
+      auto ep = epoch;
+      auto origin = mycore();
+      send_heap_message(0, [self,ep,origin]{
+        auto m = self.localize();
+        // turn down stale requests from before the last resize
+        if (m->resizing || m->epoch != ep) {
+          send_heap_message(origin, [self]{ self.localize()->resize_requested = false; });
+          return;
+        }
+        m->resizing = true;
+        auto cap = m->capacity;
+        spawn([self,cap,origin]{ self->do_resize(2*cap, origin); });
+      });
+    }
+  }
+  
+  /// Blocking visit of `key`'s cell, returning `f(Cell&)` to the caller.
+  template< typename F >
+  auto call_on_key(K key, F f) -> decltype(f(*(Cell*)nullptr)) {
+    using R = decltype(f(*(Cell*)nullptr));
+    FullEmpty<R> result;
+    auto ra = make_global(&result);
+    auto t = acquire();
+    visit_cell(self, t, key, [ra,f](Cell& c){
+      R r = f(c);
+      if (ra.core() == mycore()) {
+        ra->writeXF(r);
+      } else {
+        send_heap_message(ra.core(), [ra,r]{ ra->writeXF(r); });
+      }
+    });
+    R r = result.readFF();
+    release(t);
+    return r;
+  }
+  
+  /// Visit `key`'s cell without waiting; `C` (if non-null) is enrolled and completed
+  /// once `f` has run.
+  template< GlobalCompletionEvent * C, typename F >
+  void call_on_key_async(K key, F f) {
+    if (C) C->enroll();
+    auto self = this->self;
+    auto t = acquire();
+    auto origin = mycore();
+    visit_cell(self, t, key, [self,t,origin,f](Cell& c){
+      f(c);
+      auto done = [self,t]{
+        self.localize()->release(t);
+        if (C) C->complete();
+      };
+      if (origin == mycore()) done();
+      else send_heap_message(origin, done);
+    });
+  }
+  
+  /// Move the entries of one (local) cell of the old table into the new one.
+  static void migrate_cell(GlobalAddress<GlobalHashMap> self, Cell& c) {
+    auto m = self.localize();
+    auto nb = m->next_base;
+    auto ncap = m->next_capacity;
+    
+    c.flags |= Cell::MOVING;
+    
+    CompletionEvent ce(c.size());
+    auto cea = make_global(&ce);
+    c.for_each([self,nb,ncap,cea](Entry& e){
+      auto k = e.key; auto v = e.val;
+      auto dst = nb + index(k, ncap);
+      send_heap_message(dst.core(), [self,dst,k,v,cea]{
+        // keys of one old cell only ever reach the new table through here until the old
+        // cell is marked MOVED, so no need to check for an existing entry
+        dst.localize()->emplace(k, v);
+        self.localize()->local_entries++;
+        complete(cea);
+      });
+    });
+    ce.wait();
+    
+    hashmap_migrated_entries += c.size();
+    m->local_entries -= c.size();
+    c.clear();
+    c.flags = Cell::MOVED;
+  }
+  
+  /// Body of a resize; caller must have set `resizing` on core 0. `requester` is the core
+  /// whose load-triggered request started it (if any), whose `resize_requested` is
+  /// cleared at the end.
+  void do_resize(size_t new_capacity, Core requester = -1) {
+    auto self = this->self;
+    CHECK_GT(new_capacity, 0);
+    
+    // resizes of all maps share hashmap_resize_gce, so run one at a time
+    while (!delegate::call(0, []{
+      if (impl::hashmap_resize_busy) return false;
+      impl::hashmap_resize_busy = true;
+      return true;
+    })) {
+      Grappa::yield();
+    }
+    
+    auto old_base = this->base;
+    auto old_capacity = this->capacity;
+    VLOG(2) << "resizing GlobalHashMap " << old_capacity << " -> " << new_capacity;
+    
+    auto nb = global_alloc<Cell>(new_capacity);
+    forall<&impl::hashmap_resize_gce>(nb, new_capacity, [](Cell& c){ new (&c) Cell(); });
+    
+    call_on_all_cores([self,nb,new_capacity]{
+      auto m = self.localize();
+      m->next_base = nb;
+      m->next_capacity = new_capacity;
+    });
+    
+    forall<&impl::hashmap_resize_gce>(old_base, old_capacity, [self](Cell& c){
+      migrate_cell(self, c);
+    });
+    
+    // switch over: new operations go straight to the new table
+    call_on_all_cores([self]{
+      auto m = self.localize();
+      m->base = m->next_base;
+      m->capacity = m->next_capacity;
+      m->epoch++;
+    });
+    
+    // wait for operations issued against the old table (they forward from moved cells)
+    on_all_cores([self]{
+      auto m = self.localize();
+      while (m->refs[(m->epoch - 1) & 1] > 0) Grappa::yield();
+    });
+    
+    forall<&impl::hashmap_resize_gce>(old_base, old_capacity, [](Cell& c){ c.~Cell(); });
+    global_free(old_base);
+    
+    call_on_all_cores([self,requester]{
+      auto m = self.localize();
+      m->next_base = GlobalAddress<Cell>();
+      m->next_capacity = 0;
+      if (mycore() == requester) m->resize_requested = false;
+    });
+    ++hashmap_resizes;
+    delegate::call(0, [self]{
+      self.localize()->resizing = false;
+      impl::hashmap_resize_busy = false;
+    });
   }
 
   // for creating local GlobalHashMap
   GlobalHashMap( GlobalAddress<GlobalHashMap> self, GlobalAddress<Cell> base, size_t capacity )
     : self(self), base(base), capacity(capacity)
     , proxy(locale_new<Proxy>(this))
+    , next_base(), next_capacity(0)
+    , epoch(0), refs{0,0}, local_entries(0)
+    , resize_requested(false), resizing(false)
   {
+    static_assert(sizeof(Cell) == block_size, "hash cells must be exactly one block");
     CHECK_LT(sizeof(self)+sizeof(base)+sizeof(capacity)+sizeof(proxy), 2*block_size);
   }
   
@@ -190,14 +481,56 @@ public:
   }
   
   GlobalAddress<Cell> begin() { return this->base; }
+  
+  /// Number of cells as of the last completed resize (call `wait_resize()` first to
+  /// include one that may still be running).
   size_t ncells() { return this->capacity; }
   
+  /// Block until no resize is running or requested. Only meaningful once the caller's
+  /// own operations on the map have completed (those are what trigger resizes).
+  void wait_resize() {
+    auto self = this->self;
+    // A request in flight keeps its sender's `resize_requested` set until core 0 has
+    // turned it down or finished the resize it started, which clears `resizing` last;
+    // so checking the requests before core 0 can't miss one.
+    while (reduce<int64_t,GlobalHashMap,collective_add,&resize_requests_of>(self) > 0
+           || delegate::call(0, [self]{ return self.localize()->resizing; })) {
+      Grappa::yield();
+    }
+  }
+  
+  /// Total number of entries (collective over all cores' counts).
+  size_t size() {
+    wait_resize();
+    return reduce<int64_t,GlobalHashMap,collective_add,&local_entries_of>(self);
+  }
+  
+  /// Rehash into a table with `new_capacity` cells. Blocks until the old table has been
+  /// freed; inserts and lookups from other tasks proceed meanwhile. If a resize is already
+  /// in progress, waits for it to finish first.
+  void resize(size_t new_capacity) {
+    auto self = this->self;
+    while (!delegate::call(0, [self]{
+      auto m = self.localize();
+      if (m->resizing) return false;
+      m->resizing = true;
+      return true;
+    })) {
+      Grappa::yield();
+    }
+    do_resize(new_capacity);
+  }
+  
   void clear() {
+    auto self = this->self;
+    wait_resize();
     forall(base, capacity, [](Cell& c){ c.clear(); });
+    call_on_all_cores([self]{ self->local_entries = 0; });
   }
   
   void destroy() {
     auto self = this->self;
+    wait_resize();
     forall(this->base, this->capacity, [](Cell& c){ c.~Cell(); });
     global_free(this->base);
     call_on_all_cores([self]{ self->~GlobalHashMap(); });
@@ -206,13 +539,9 @@ public:
   
   template< typename F >
   void forall_entries(F visit) {
+    wait_resize();
     forall(base, capacity, [visit](int64_t i, Cell& c){
-      // if cell is not hit then no action
-      if (c.entries == nullptr) return;
-      DVLOG(3) << "c<" << &c << "> entries:" << c.entries << " size: " << c.entries->size();
-      for (Entry& e : *c.entries) {
-        visit(e.key, *e.val);
-      }
+      c.for_each([visit](Entry& e){ visit(e.key, e.val); });
     });
   }
   
@@ -239,8 +568,8 @@ public:
       return re.found;
     } else {
       ++hashmap_lookup_msgs;
-      auto result = delegate::call(base+computeIndex(key), [key](Cell* c){
-        return c->lookup(key);
+      auto result = call_on_key(key, [key](Cell& c){
+        return c.lookup(key);
       });
       *val = result.second;
       return result.first;
@@ -253,42 +582,126 @@ public:
       proxy.combine([key,val](Proxy& p){ p.map[key] = val; return FCStatus::BLOCKED; });
     } else {
       ++hashmap_insert_msgs;
-      delegate::call(base+computeIndex(key), [key,val](Cell * c) { c->insert(key,val); });
+      call_on_key(key, [key,val](Cell& c) { c.insert(key,val); return true; });
+    }
+  }
+  
+  /// Insert `val` for `key`, or if present, `merge(current, val)` at the cell's owner, so
+  /// that aggregations (counts, sums, mins...) never need a read-modify-write round trip.
+  /// With flat combining, concurrent updates of the same key from this core are merged
+  /// before being sent.
+  ///
+  /// @b Example:
+  /// @code
+  ///   auto counts = GlobalHashMap<std::string,int64_t>::create(1024);
+  ///   forall(words, nwords, [counts](Word& w){
+  ///     counts->insert_or_update(w.str(), 1, [](int64_t& c, const int64_t& n){ c += n; });
+  ///   });
+  /// @endcode
+  void insert_or_update(K key, V val, MergeFn merge) {
+    ++hashmap_update_ops;
+    if (FLAGS_flat_combining) {
+      proxy.combine([key,val,merge](Proxy& p){
+        p.update(key, val, merge);
+        return FCStatus::BLOCKED;
+      });
+    } else {
+      ++hashmap_update_msgs;
+      call_on_key(key, [key,val,merge](Cell& c){ c.update(key, val, merge); return true; });
     }
   }
+  
+  /// Bulk `insert_or_update`: merges the batch locally first, then sends one update per
+  /// distinct key. Blocks until all have been applied.
+  void insert_or_update(const K * keys, const V * vals, size_t n, MergeFn merge) {
+    hashmap_update_ops += n;
+    std::unordered_map<K,V> pending(n);
+    for (size_t i = 0; i < n; i++) {
+      auto r = pending.emplace(keys[i], vals[i]);
+      if (!r.second) {
+        merge(r.first->second, vals[i]);
+        ++hashmap_combined_updates;
+      }
+    }
+    
+    CompletionEvent ce(pending.size());
+    auto cea = make_global(&ce);
+    auto t = acquire();
+    for (auto& e : pending) { auto k = e.first; auto v = e.second;
+      ++hashmap_update_msgs;
+      visit_cell(self, t, k, [cea,k,v,merge](Cell& c){
+        c.update(k, v, merge);
+        complete(cea);
+      });
+    }
+    ce.wait();
+    release(t);
+  }
+  
+  /// Remove `key`; returns false if it wasn't present.
+  bool erase(K key) {
+    ++hashmap_erase_ops;
+    return call_on_key(key, [key](Cell& c){ return c.erase(key); });
+  }
+  
+  /// Bulk `erase` (duplicates in `keys` are sent once). Returns the number of keys removed.
+  size_t erase(const K * keys, size_t n) {
+    hashmap_erase_ops += n;
+    std::unordered_set<K> distinct(keys, keys+n);
+    
+    size_t erased = 0;
+    CompletionEvent ce(distinct.size());
+    auto cea = make_global(&ce);
+    auto ea = make_global(&erased);
+    auto t = acquire();
+    for (auto& k : distinct) {
+      visit_cell(self, t, k, [cea,ea,k](Cell& c){
+        bool found = c.erase(k);
+        send_heap_message(cea.core(), [cea,ea,found]{
+          if (found) (*ea.pointer())++;
+          complete(cea);
+        });
+      });
+    }
+    ce.wait();
+    release(t);
+    return erased;
+  }
     
 } GRAPPA_BLOCK_ALIGNED;
 
 template< SyncMode S = SyncMode::Blocking,
           GlobalCompletionEvent * C = &impl::local_gce,
-          typename K = nullptr_t, typename V = nullptr_t,
+          typename K = nullptr_t, typename V = nullptr_t, typename H = nullptr_t,
           typename F = nullptr_t >
-void insert(GlobalAddress<GlobalHashMap<K,V>> self, K key, F on_insert) {
+void insert(GlobalAddress<GlobalHashMap<K,V,H>> self, K key, F on_insert) {
   ++hashmap_insert_msgs;
-  delegate::call<S,C>(self->base+self->computeIndex(key),
-  [=](typename GlobalHashMap<K,V>::Cell& c){
-    for (auto& e : c.entries) {
-      if (e.key == key) {
-        on_insert(e.val);
-        return;
-      }
-    }
-    c.entries.emplace_back(key);
-    on_insert(c.entries.back().val);
-  });
+  auto visit = [key,on_insert](typename GlobalHashMap<K,V,H>::Cell& c){
+    auto e = c.find(key);
+    if (e == nullptr) e = c.emplace(key);
+    on_insert(e->val);
+    return true;
+  };
+  if (S == SyncMode::Async) {
+    self->template call_on_key_async<C>(key, visit);
+  } else {
+    self->call_on_key(key, visit);
+  }
 }
 
 template< GlobalCompletionEvent * GCE = &impl::local_gce,
           int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG,
           typename T = decltype(nullptr),
           typename V = decltype(nullptr),
+          typename H = decltype(nullptr),
           typename F = decltype(nullptr) >
-void forall(GlobalAddress<GlobalHashMap<T,V>> self, F visit) {
+void forall(GlobalAddress<GlobalHashMap<T,V,H>> self, F visit) {
+  self->wait_resize();
   forall<GCE,Threshold>(self->begin(), self->ncells(),
-  [visit](typename GlobalHashMap<T,V>::Cell& c){
-    for (auto& e : c.entries) {
+  [visit](typename GlobalHashMap<T,V,H>::Cell& c){
+    c.for_each([visit](typename GlobalHashMap<T,V,H>::Entry& e){
       visit(e.key, e.val);
-    }
+    });
   });
 }
 
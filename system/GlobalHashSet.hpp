@@ -29,6 +29,7 @@
 #include "Metrics.hpp"
 #include "Array.hpp"
 #include "FlatCombiner.hpp"
+#include "GlobalHashCommon.hpp"
 
 #include <vector>
 #include <unordered_set>
@@ -45,7 +46,9 @@ GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, hashset_matched_lookups);
 
 namespace Grappa {
 
-template <typename K>
+/// Distributed hash set, stored as a global array of one-block cells hashed by key
+/// (see impl::HashCell); `Hash` may be replaced by any functor mapping keys to `size_t`.
+template< typename K, typename Hash = Grappa::hash<K> >
 class GlobalHashSet {
 protected:
   struct Entry {
@@ -54,9 +57,15 @@ protected:
     Entry(K key) : key(key) {}
   };
   
-  struct Cell { // TODO: keep first few in the 64-byte block, then go to secondary storage
-    std::vector<Entry> entries;
-    Cell() { entries.reserve(16); }
+  struct Cell : public impl::HashCell<Entry> {
+    bool contains(const K& key) { return this->find(key) != nullptr; }
+    
+    /// returns true if newly inserted
+    bool insert(const K& key) {
+      if (contains(key)) return false;
+      this->emplace(key);
+      return true;
+    }
   } GRAPPA_BLOCK_ALIGNED;
 
   struct ResultEntry {
@@ -99,10 +108,7 @@ protected:
         ++hashset_insert_msgs;
         auto cell = owner->base+owner->computeIndex(k);
         send_heap_message(cell.core(), [cell,k,cea]{
-          Cell * c = cell.localize();
-          bool found = false;
-          for (auto& e : c->entries) if (e.key == k) { found = true; break; }
-          if (!found) c->entries.emplace_back(k);
+          cell.localize()->insert(k);
           complete(cea);
         });
       }
@@ -113,9 +119,7 @@ protected:
         auto cell = owner->base+owner->computeIndex(k);
         
         send_heap_message(cell.core(), [cell,k,cea,re]{
-          Cell * c = cell.localize();
-          bool found = false;
-          for (auto& e : c->entries) if (e.key == k) { found = true; break; }
+          bool found = cell.localize()->contains(k);
           
           send_heap_message(cea.core(), [cea,re,found]{
             ResultEntry * r = re;
@@ -141,7 +145,7 @@ protected:
   FlatCombiner<Proxy> proxy;
   
   uint64_t computeIndex( K key ) {
-    static std::hash<K> hasher;
+    static Hash hasher;
     return hasher(key) % capacity;
   }
 
@@ -149,7 +153,9 @@ protected:
   GlobalHashSet( GlobalAddress<GlobalHashSet> self, GlobalAddress<Cell> base, size_t capacity )
     : self(self), base(base), capacity(capacity)
     , proxy(locale_new<Proxy>(this))
-  { }
+  {
+    static_assert(sizeof(Cell) == block_size, "hash cells must be exactly one block");
+  }
   
 public:
   
@@ -194,8 +200,7 @@ public:
     } else {
       ++hashset_lookup_msgs;
       return delegate::call(base+computeIndex(key), [key](Cell* c){
-        for (auto& e : c->entries) if (e.key == key) return true;
-        return false;
+        return c->contains(key);
       });
     }
   }
@@ -213,12 +218,8 @@ public:
     } else {
       ++hashset_insert_msgs;
       delegate::call(base+computeIndex(key), [key](Cell * c) {
-        // find matching key in the list, if found, no insert necessary
-        for (auto& e : c->entries) if (e.key == key) return;
-        
-        // this is the first time the key has been seen so add it to the list
-        c->entries.emplace_back( key );
-        return;
+        // no-op if the key has been seen before
+        c->insert(key);
       });
     }
   }
@@ -255,9 +256,7 @@ public:
   template< GlobalCompletionEvent * GCE = &impl::local_gce, typename F = decltype(nullptr) >
   void forall_keys(F visit) {
     forall<GCE>(base, capacity, [visit](int64_t i, Cell& c){
-      for (auto& e : c.entries) {
-        visit(e.key);
-      }
+      c.for_each([visit](Entry& e){ visit(e.key); });
     });
   }
   
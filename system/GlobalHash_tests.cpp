@@ -145,6 +145,109 @@ void test_set_correctness() {
   sa->destroy();
 }
 
+void test_cell_overflow() {
+  LOG(INFO) << "Testing cells that overflow their inline entries...";
+  // few cells, many keys: most entries land in the overflow storage
+  const long nkeys = 256;
+  auto ha = GlobalHashMap<long,long>::create(4);
+  auto sa = GlobalHashSet<long>::create(4);
+  
+  forall(0, nkeys, [ha,sa](int64_t i){
+    ha->insert(i, 2*i);
+    sa->insert(i);
+  });
+  forall(0, nkeys, [ha](int64_t i){
+    ha->insert(i, 3*i); // overwrite
+  });
+  
+  for (long i=0; i<nkeys; i++) {
+    long val;
+    BOOST_CHECK_EQUAL(ha->lookup(i, &val), true);
+    BOOST_CHECK_EQUAL(val, 3*i);
+    BOOST_CHECK_EQUAL(sa->lookup(i), true);
+  }
+  BOOST_CHECK_EQUAL(sa->lookup(nkeys), false);
+  BOOST_CHECK_EQUAL(sa->size(), nkeys);
+  
+  ha->clear();
+  long v;
+  BOOST_CHECK_EQUAL(ha->lookup(7, &v), false);
+  
+  ha->destroy();
+  sa->destroy();
+}
+
+void test_resize() {
+  LOG(INFO) << "Testing GlobalHashMap resizing...";
+  const long nkeys = 2048;
+  auto ha = GlobalHashMap<long,long>::create(8);
+  
+  // grows automatically while inserts are in flight
+  forall(0, nkeys, [ha](int64_t i){ ha->insert(i, i+1); });
+  BOOST_CHECK_EQUAL(ha->size(), nkeys); // (waits for the resize to finish)
+  BOOST_CHECK(ha->ncells() > 8);
+  forall(0, nkeys, [ha](int64_t i){
+    long val;
+    BOOST_CHECK_EQUAL(ha->lookup(i, &val), true);
+    BOOST_CHECK_EQUAL(val, i+1);
+  });
+  
+  // explicit (shrinking) resize
+  auto n = ha->ncells();
+  ha->resize(n / 2);
+  BOOST_CHECK_EQUAL(ha->ncells(), n / 2);
+  BOOST_CHECK_EQUAL(ha->size(), nkeys);
+  
+  forall(0, nkeys, [ha](int64_t i){
+    long val;
+    BOOST_CHECK_EQUAL(ha->lookup(i, &val), true);
+    BOOST_CHECK_EQUAL(val, i+1);
+  });
+  
+  // the shrunk table may be over the load limit, so the lookups can start another resize
+  BOOST_CHECK_EQUAL(ha->size(), nkeys);
+  
+  ha->destroy();
+}
+
+void test_update_erase() {
+  LOG(INFO) << "Testing GlobalHashMap insert_or_update/erase...";
+  const long nkeys = 100;
+  auto ha = GlobalHashMap<long,long>::create(FLAGS_global_hash_size);
+  
+  // every core adds 1 to each key, twice through the single-key path...
+  on_all_cores([ha]{
+    forall_here(0, 2*nkeys, [ha](int64_t i){
+      ha->insert_or_update(i % nkeys, 1, [](long& c, const long& n){ c += n; });
+    });
+  });
+  // ...and once in bulk, with duplicates merged at the sender
+  on_all_cores([ha]{
+    std::vector<long> keys, ones;
+    for (long i=0; i<nkeys; i++) { keys.push_back(i); ones.push_back(1); }
+    keys.push_back(0); ones.push_back(1);
+    ha->insert_or_update(&keys[0], &ones[0], keys.size(),
+                         [](long& c, const long& n){ c += n; });
+  });
+  
+  for (long i=0; i<nkeys; i++) {
+    long val;
+    BOOST_CHECK_EQUAL(ha->lookup(i, &val), true);
+    BOOST_CHECK_EQUAL(val, cores()*(i == 0 ? 4 : 3));
+  }
+  
+  BOOST_CHECK_EQUAL(ha->erase(0), true);
+  BOOST_CHECK_EQUAL(ha->erase(0), false);
+  long v;
+  BOOST_CHECK_EQUAL(ha->lookup(0, &v), false);
+  
+  std::vector<long> gone = {1, 2, 3, 3, nkeys+5};
+  BOOST_CHECK_EQUAL(ha->erase(&gone[0], gone.size()), 3);
+  BOOST_CHECK_EQUAL(ha->size(), nkeys-4);
+  
+  ha->destroy();
+}
+
 double test_set_insert_throughput() {
   auto sa = GlobalHashSet<long>::create(FLAGS_global_hash_size);
   
@@ -193,6 +296,9 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     } else {
       test_correctness();
       test_set_correctness();
+      test_cell_overflow();
+      test_resize();
+      test_update_erase();
     }
   
     Metrics::merge_and_print();
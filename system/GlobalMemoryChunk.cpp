@@ -57,7 +57,7 @@ void * global_memory_chunk_base = NULL;
 
 /// Tear down GlobalMemoryChunk, removing shm region if possible
 GlobalMemoryChunk::~GlobalMemoryChunk() {
-  Grappa::impl::locale_shared_memory.deallocate( memory_ );
+  Grappa::impl::locale_shared_memory.deallocate( memory_, Grappa::impl::LocaleAllocTag::GlobalHeap );
 }
 
 /// Construct GlobalMemoryChunk.
@@ -66,7 +66,7 @@ GlobalMemoryChunk::GlobalMemoryChunk( size_t size )
   , memory_( 0 )
 {
   DVLOG(2) << "Core " << Grappa::mycore() << " allocating " << size_ << " bytes ";
-  memory_ = Grappa::impl::locale_shared_memory.allocate_aligned( size_, 64 );
+  memory_ = Grappa::impl::locale_shared_memory.allocate_aligned( size_, 64, Grappa::impl::LocaleAllocTag::GlobalHeap );
   CHECK_NOTNULL( memory_ );
   Grappa::impl::global_memory_chunk_base = memory_;
   DVLOG(2) << "Core " << Grappa::mycore() << " allocated " << size_ << " bytes ";
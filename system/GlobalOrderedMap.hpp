@@ -0,0 +1,351 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GlobalAllocator.hpp"
+#include "ParallelLoop.hpp"
+#include "Delegate.hpp"
+#include "Collective.hpp"
+#include "Metrics.hpp"
+#include "BPlusTree.hpp"
+#include "LocaleSharedMemory.hpp"
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include <tuple>
+
+DECLARE_int64(ordered_map_samples_per_core);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, ordered_map_inserts);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, ordered_map_lookups);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, ordered_map_bulk_loaded);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, ordered_map_range_scans);
+
+namespace Grappa {
+
+/// @addtogroup Containers
+/// @{
+
+/// Distributed ordered map: keys are range-partitioned across cores by splitter keys,
+/// and each core stores its partition in a BPlusTree.
+///
+/// Splitters are chosen by sampling the input of `bulk_load`, so partitions are balanced
+/// for the initial data; later `insert`s go to whichever partition the key falls in.
+/// Because partitions are ordered by core, anything in key order (range scans, top-k)
+/// is just the concatenation of each core's ordered results.
+///
+/// Like everything sent in messages, `K` and `V` must be trivially copyable.
+///
+/// @b Example:
+/// @code
+///   auto m = GlobalOrderedMap<int64_t,double>::create();
+///   m->bulk_load(pairs, npairs);
+///   forall(key_range(m, 100, 200), [](const int64_t& k, double& v){ ... });
+///   auto top = m->collect(lo, hi, 10);   // first 10 entries >= lo, in order
+/// @endcode
+template< typename K, typename V >
+class GlobalOrderedMap {
+public:
+  typedef std::pair<K,V> Entry;
+  typedef BPlusTree<K,V> Tree;
+  
+  /// Combines values of duplicate keys during `bulk_load` (see GlobalHashMap::MergeFn).
+  typedef void (*MergeFn)(V& current, const V& update);
+  
+  // private members (per core)
+  GlobalAddress<GlobalOrderedMap> self;
+  std::vector<K> splitters;   ///< core c holds keys in [splitters[c-1], splitters[c])
+  Tree tree;
+  std::vector<Entry> staging; ///< entries shuffled here during bulk load
+  std::vector<K> samples;     ///< (on the loading core) sampled keys
+  
+  GlobalOrderedMap(GlobalAddress<GlobalOrderedMap> self): self(self) {}
+  
+  static size_t local_size_of(GlobalAddress<GlobalOrderedMap> m) { return m->tree.size(); }
+  
+public:
+  // for static construction
+  GlobalOrderedMap() {}
+  
+  /// Create an empty map; until the first `bulk_load`, every key lives on core 0.
+  static GlobalAddress<GlobalOrderedMap> create() {
+    auto self = symmetric_global_alloc<GlobalOrderedMap>();
+    call_on_all_cores([self]{ new (self.localize()) GlobalOrderedMap(self); });
+    return self;
+  }
+  
+  void destroy() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->~GlobalOrderedMap(); });
+    global_free(self);
+  }
+  
+  /// Core whose partition holds `key`.
+  Core owner(const K& key) const {
+    return std::upper_bound(splitters.begin(), splitters.end(), key) - splitters.begin();
+  }
+  
+  /// Replace the contents with `n` entries from a global array (in any order), choosing
+  /// new splitters from a regular sample of the input. Duplicate keys are combined with
+  /// `merge` if given, otherwise one of their values is kept.
+  void bulk_load(GlobalAddress<Entry> entries, size_t n, MergeFn merge = nullptr) {
+    auto self = this->self;
+    Core root = mycore();
+    
+    call_on_all_cores([self]{
+      self->samples.clear();
+      self->staging.clear();
+      self->tree.clear();
+    });
+    
+    // sample every stride'th entry, gathering keys here
+    int64_t want = std::max<int64_t>(1, FLAGS_ordered_map_samples_per_core * cores());
+    int64_t stride = std::max<int64_t>(1, n / want);
+    forall(entries, n, [self,root,stride](int64_t i, Entry& e){
+      if (i % stride == 0) {
+        K k = e.first;
+        delegate::call<SyncMode::Async>(root, [self,k]{ self->samples.push_back(k); });
+      }
+    });
+    
+    // pick evenly spaced splitters and send them everywhere
+    std::sort(samples.begin(), samples.end());
+    size_t nsplit = samples.empty() ? 0 : cores()-1;
+    call_on_all_cores([self,nsplit]{ self->splitters.resize(nsplit); });
+    
+    CompletionEvent ce(nsplit * cores());
+    auto cea = make_global(&ce);
+    for (size_t i = 0; i < nsplit; i++) {
+      K k = samples[(i+1) * samples.size() / cores()];
+      for (Core c = 0; c < cores(); c++) {
+        send_heap_message(c, [self,i,k,cea]{
+          self->splitters[i] = k;
+          complete(cea);
+        });
+      }
+    }
+    ce.wait();
+    samples.clear();
+    samples.shrink_to_fit();
+    
+    // shuffle entries to their partitions
+    forall(entries, n, [self](Entry& e){
+      Entry kv = e;
+      delegate::call<SyncMode::Async>(self->owner(kv.first), [self,kv]{
+        self->staging.push_back(kv);
+      });
+    });
+    
+    // sort, combine duplicates and build each partition's tree
+    on_all_cores([self,merge]{
+      auto& st = self->staging;
+      std::sort(st.begin(), st.end(), [](const Entry& a, const Entry& b){
+        return a.first < b.first;
+      });
+      size_t m = 0;
+      for (size_t i = 0; i < st.size(); i++) {
+        if (m > 0 && !(st[m-1].first < st[i].first)) {
+          if (merge) merge(st[m-1].second, st[i].second);
+        } else {
+          st[m++] = st[i];
+        }
+      }
+      self->tree.bulk_load(st.begin(), m);
+      ordered_map_bulk_loaded += m;
+      st.clear();
+      st.shrink_to_fit();
+    });
+  }
+  
+  /// Insert or overwrite; returns true if `key` was new.
+  bool insert(K key, V val) {
+    ++ordered_map_inserts;
+    auto self = this->self;
+    return delegate::call(owner(key), [self,key,val]{
+      return self->tree.insert(key, val);
+    });
+  }
+  
+  bool lookup(K key, V * val) {
+    ++ordered_map_lookups;
+    auto self = this->self;
+    auto r = delegate::call(owner(key), [self,key]{
+      V * v = self->tree.find(key);
+      return v ? std::make_pair(true, *v) : std::make_pair(false, V());
+    });
+    *val = r.second;
+    return r.first;
+  }
+  
+  /// Total number of entries.
+  size_t size() {
+    return reduce<size_t,GlobalOrderedMap,collective_add,&local_size_of>(self);
+  }
+  
+  /// Fetch the entries with keys in `[lo,hi)` to the calling core, in key order, stopping
+  /// after `limit` entries (so `collect(lo, hi, k)` is a top-k query). Partitions are
+  /// visited in order; each one gathers its matches in a single pass and ships them
+  /// back in as few messages as fit.
+  std::vector<Entry> collect(K lo, K hi, size_t limit = SIZE_MAX) {
+    ++ordered_map_range_scans;
+    auto self = this->self;
+    std::vector<Entry> out;
+    if (!(lo < hi) || limit == 0) return out;
+    
+    auto outp = &out;
+    Core c0 = owner(lo), c1 = owner(hi);
+    for (Core c = c0; c <= c1 && out.size() < limit; c++) {
+      size_t base = out.size(), remaining = limit - base;
+      // the first chunk to arrive enrolls the rest
+      CompletionEvent ce(1);
+      auto cea = make_global(&ce);
+      spawnRemote<nullptr>(c, [self,lo,hi,remaining,base,outp,cea]{
+        // no yields between here and the copy, so the partition can't change underneath
+        std::vector<Entry> run;
+        self->tree.for_each_run(lo, hi, [&run,remaining](typename Tree::Leaf * l, int b, int e){
+          for (int j = b; j < e && run.size() < remaining; j++) {
+            run.emplace_back(l->keys[j], l->vals[j]);
+          }
+        });
+        
+        size_t n = run.size();
+        if (n == 0) {
+          complete(cea);
+          return;
+        }
+        size_t per_msg = MAX_MESSAGE_SIZE / sizeof(Entry);
+        size_t nmsg = (n + per_msg - 1) / per_msg;
+        auto here = mycore();
+        for (size_t k = 0; k < n; k += per_msg) {
+          size_t m = std::min(per_msg, n-k);
+          // payloads must live in locale shared memory; freed when the caller acks
+          auto buf = locale_alloc<Entry>(m);
+          std::copy(&run[k], &run[k]+m, buf);
+          send_heap_message(cea.core(), [outp,base,k,n,nmsg,cea,here,buf](void * payload, size_t sz){
+            auto ce = cea.pointer();
+            if (outp->size() < base+n) {
+              outp->resize(base+n);
+              ce->enroll(nmsg);
+              ce->complete();
+            }
+            auto in = static_cast<Entry*>(payload);
+            std::copy(in, in + sz/sizeof(Entry), &(*outp)[base+k]);
+            send_heap_message(here, [buf]{ locale_free(buf); });
+            ce->complete();
+          }, buf, m*sizeof(Entry));
+        }
+      });
+      ce.wait();
+    }
+    return out;
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// Range of keys `[lo,hi)` in a GlobalOrderedMap, for use with Grappa::forall().
+template< typename M, typename K >
+struct KeyRange {
+  GlobalAddress<M> map;
+  K lo, hi;
+};
+
+template< typename K, typename V >
+KeyRange<GlobalOrderedMap<K,V>,K> key_range(GlobalAddress<GlobalOrderedMap<K,V>> m, K lo, K hi) {
+  return KeyRange<GlobalOrderedMap<K,V>,K>{ m, lo, hi };
+}
+
+namespace impl {
+  template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename M, typename K, typename F >
+  void forall(KeyRange<M,K> r, F body) {
+    if (!(r.lo < r.hi)) return;
+    ++ordered_map_range_scans;
+    Core c0 = r.map->owner(r.lo), c1 = r.map->owner(r.hi);
+    auto origin = mycore();
+    
+    // each partition splits its matching leaf runs among local tasks, enrolled in `C`
+    // (if any) so async work started by `body` is waited for like in any other forall
+    auto loop = [r,body]{
+      struct Runs {
+        std::vector<std::tuple<typename M::Tree::Leaf*,int,int>> runs;
+        int64_t refs;
+      };
+      auto rs = new Runs();
+      r.map->tree.for_each_run(r.lo, r.hi, [rs](typename M::Tree::Leaf * l, int b, int e){
+        rs->runs.emplace_back(l, b, e);
+      });
+      rs->refs = rs->runs.size();
+      auto visit = [rs,body](int64_t i){
+        auto l = std::get<0>(rs->runs[i]);
+        for (int j = std::get<1>(rs->runs[i]); j < std::get<2>(rs->runs[i]); j++) {
+          body(l->keys[j], l->vals[j]);
+        }
+      };
+      if (rs->refs == 0) {
+        delete rs;
+      } else if (C) {
+        forall_here<TaskMode::Bound,SyncMode::Async,C,Threshold>(0, rs->refs, [rs,visit](int64_t i){
+          visit(i);
+          if (--rs->refs == 0) delete rs;
+        });
+      } else {
+        forall_here<TaskMode::Bound,SyncMode::Blocking,nullptr,Threshold>(0, rs->refs, visit);
+        delete rs;
+      }
+    };
+    
+    CompletionEvent ce((S == SyncMode::Blocking && !C) ? c1-c0+1 : 0);
+    auto ce_a = make_global(&ce);
+    if (C) C->enroll(c1-c0+1);
+    for (Core c = c0; c <= c1; c++) {
+      spawnRemote<nullptr>(c, [loop,origin,ce_a]{
+        loop();
+        if (C) C->send_completion(origin);
+        else if (S == SyncMode::Blocking) complete(ce_a);
+      });
+    }
+    if (S == SyncMode::Blocking) {
+      if (C) C->wait();
+      else ce.wait();
+    }
+  }
+}
+
+#define OVERLOAD(...) \
+  template< __VA_ARGS__, typename M = nullptr_t, typename K = nullptr_t, typename F = nullptr_t > \
+  void forall(KeyRange<M,K> r, F body) { \
+    impl::forall<S,C,Threshold>(r, body); \
+  }
+/// Parallel loop over the entries of a GlobalOrderedMap with keys in a range (see
+/// key_range()); `body` is called as `body(const K& key, V& val)` on the owning core.
+OVERLOAD( SyncMode S = SyncMode::Blocking,
+          GlobalCompletionEvent * C = &impl::local_gce,
+          int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
+OVERLOAD( GlobalCompletionEvent * C,
+          SyncMode S = SyncMode::Blocking,
+          int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
+#undef OVERLOAD
+
+/// @}
+
+} // namespace Grappa
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalOrderedMap.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalOrderedMap_tests );
+
+DEFINE_int64(nelems, 10000, "number of entries to bulk load");
+
+typedef GlobalOrderedMap<int64_t,int64_t> Map;
+
+/// Local tree: random-order inserts split nodes at every level.
+void test_btree() {
+  BPlusTree<int64_t,int64_t> t;
+  const int64_t n = 5000;
+  for (int64_t i = 0; i < n; i++) {
+    int64_t k = (i * 7919) % n;
+    BOOST_CHECK(t.insert(k, 2*k));
+  }
+  BOOST_CHECK(!t.insert(42, -1)); // overwrite
+  BOOST_CHECK_EQUAL(t.size(), n);
+  BOOST_CHECK_EQUAL(*t.find(42), -1);
+  BOOST_CHECK_EQUAL(*t.find(4999), 2*4999);
+  BOOST_CHECK(t.find(n) == nullptr);
+  
+  int64_t expect = 100;
+  t.for_each(100, 200, [&expect](const int64_t& k, int64_t& v){
+    BOOST_CHECK_EQUAL(k, expect++);
+  });
+  BOOST_CHECK_EQUAL(expect, 200);
+  BOOST_CHECK_EQUAL(t.count_range(100, 200), 100);
+  BOOST_CHECK_EQUAL(t.count_range(100, 200, 10), 10);
+}
+
+void test_bulk_load_and_scan() {
+  int64_t N = FLAGS_nelems;
+  auto entries = global_alloc<Map::Entry>(N);
+  // keys 0,2,4,... scattered over the array
+  forall(entries, N, [N](int64_t i, Map::Entry& e){
+    int64_t k = (i * 7919) % N;
+    e = Map::Entry(2*k, k);
+  });
+  
+  auto m = Map::create();
+  m->bulk_load(entries, N);
+  BOOST_CHECK_EQUAL(m->size(), N);
+  
+  int64_t v;
+  BOOST_CHECK(m->lookup(2*17, &v));
+  BOOST_CHECK_EQUAL(v, 17);
+  BOOST_CHECK(!m->lookup(2*17+1, &v));
+  
+  // parallel range scan
+  static int64_t count, sum;
+  call_on_all_cores([]{ count = 0; sum = 0; });
+  int64_t lo = N/4, hi = N;
+  forall(key_range(m, lo, hi), [](const int64_t& k, int64_t& v){
+    count++;
+    sum += v;
+  });
+  int64_t total_count = reduce<int64_t,collective_add>(&count);
+  int64_t total_sum = reduce<int64_t,collective_add>(&sum);
+  // keys lo..hi-1 that are even: values lo/2..(hi-1)/2
+  int64_t a = (lo+1)/2, b = (hi-1)/2;
+  BOOST_CHECK_EQUAL(total_count, b-a+1);
+  BOOST_CHECK_EQUAL(total_sum, (a+b)*(b-a+1)/2);
+  
+  // ordered, limited collect
+  auto top = m->collect(lo, hi, 10);
+  BOOST_CHECK_EQUAL(top.size(), 10);
+  for (size_t i = 0; i < top.size(); i++) {
+    BOOST_CHECK_EQUAL(top[i].first, 2*(a+(int64_t)i));
+  }
+  auto all = m->collect(0, 2*N);
+  BOOST_CHECK_EQUAL(all.size(), N);
+  BOOST_CHECK(std::is_sorted(all.begin(), all.end()));
+  
+  // point inserts land in the right partitions
+  BOOST_CHECK(m->insert(2*17+1, 99));
+  BOOST_CHECK(!m->insert(2*17, 99));
+  auto mid = m->collect(2*17, 2*17+3);
+  BOOST_CHECK_EQUAL(mid.size(), 3);
+  BOOST_CHECK_EQUAL(mid[1].first, 2*17+1);
+  BOOST_CHECK_EQUAL(mid[1].second, 99);
+  BOOST_CHECK(m->collect(2*N, 4*N).empty());
+  
+  m->destroy();
+  global_free(entries);
+}
+
+/// Duplicates are combined by the merge function.
+void test_bulk_load_merge() {
+  int64_t N = 1000;
+  auto entries = global_alloc<Map::Entry>(N);
+  forall(entries, N, [](int64_t i, Map::Entry& e){ e = Map::Entry(i % 10, 1); });
+  
+  auto m = Map::create();
+  m->bulk_load(entries, N, [](int64_t& c, const int64_t& n){ c += n; });
+  BOOST_CHECK_EQUAL(m->size(), 10);
+  for (int64_t k = 0; k < 10; k++) {
+    int64_t v;
+    BOOST_CHECK(m->lookup(k, &v));
+    BOOST_CHECK_EQUAL(v, N/10);
+  }
+  m->destroy();
+  global_free(entries);
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_btree();
+    test_bulk_load_and_scan();
+    test_bulk_load_merge();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
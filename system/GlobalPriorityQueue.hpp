@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GlobalAllocator.hpp"
+#include "ParallelLoop.hpp"
+#include "Delegate.hpp"
+#include "Collective.hpp"
+#include "GlobalCompletionEvent.hpp"
+#include "Metrics.hpp"
+#include <map>
+#include <vector>
+#include <cmath>
+#include <limits>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, priority_queue_pushes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, priority_queue_remote_pushes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, priority_queue_processed);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, priority_queue_buckets);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, priority_queue_rounds);
+
+namespace Grappa {
+
+/// @addtogroup Containers
+/// @{
+
+namespace impl {
+  /// Tracks pushes and visits in flight during GlobalPriorityQueue::process().
+  extern GlobalCompletionEvent priority_queue_gce;
+}
+
+/// Distributed relaxed priority queue for ordered algorithms (SSSP, A*-style search...),
+/// in the style of delta-stepping.
+///
+/// Each item lives on an owner core chosen by the pusher (typically the core of the
+/// vertex it refers to), in a per-core map of buckets of width `delta`. `process()` works
+/// through buckets in increasing order: all cores drain the globally smallest non-empty
+/// bucket in parallel, repeating while visits keep refilling it, before moving on to the
+/// next one. Order *within* a bucket is arbitrary, so `delta` trades parallelism for
+/// wasted (later superseded) work.
+///
+/// Pushes to other cores are asynchronous delegates, so they are batched by the aggregator.
+///
+/// @b Example (SSSP):
+/// @code
+///   auto q = GlobalPriorityQueue<VertexID>::create(delta);
+///   q->push((g->vs+root).core(), 0.0, root);
+///   q->process([=](VertexID& i, double d){
+///     auto& v = *(g->vs+i).pointer();
+///     if (d > v->dist) return;  // stale entry
+///     forall<async,&impl::priority_queue_gce>(adj(g,v), [=](G::Edge& e){
+///       double nd = d + e->weight;
+///       delegate::call<async,&impl::priority_queue_gce>(e.ga, [=](G::Vertex& w){
+///         if (nd < w->dist) { w->dist = nd; q->push_here(nd, e.id); }
+///       });
+///     });
+///   });
+/// @endcode
+template< typename T >
+class GlobalPriorityQueue {
+public:
+  struct Item {
+    double priority;
+    T value;
+  };
+  
+  // private members (per core)
+  GlobalAddress<GlobalPriorityQueue> self;
+  double delta;
+  std::map<int64_t,std::vector<Item>> buckets;
+  int64_t local_size;
+  int64_t current;   ///< bucket being drained by process()
+  
+  static const int64_t NONE = std::numeric_limits<int64_t>::max();
+  
+  GlobalPriorityQueue(GlobalAddress<GlobalPriorityQueue> self, double delta)
+    : self(self), delta(delta), local_size(0), current(NONE) {}
+  
+  int64_t bucket_of(double priority) const {
+    return static_cast<int64_t>(std::floor(priority / delta));
+  }
+  
+  static int64_t min_bucket_of(GlobalAddress<GlobalPriorityQueue> q) {
+    auto m = q.localize();
+    return m->buckets.empty() ? NONE : m->buckets.begin()->first;
+  }
+  static int64_t current_size_of(GlobalAddress<GlobalPriorityQueue> q) {
+    auto m = q.localize();
+    auto it = m->buckets.find(m->current);
+    return (it == m->buckets.end()) ? 0 : it->second.size();
+  }
+  static int64_t local_size_of(GlobalAddress<GlobalPriorityQueue> q) {
+    return q.localize()->local_size;
+  }
+  
+public:
+  // for static construction
+  GlobalPriorityQueue() {}
+  
+  /// @param delta  bucket width: priorities in `[k*delta, (k+1)*delta)` share bucket k
+  static GlobalAddress<GlobalPriorityQueue> create(double delta) {
+    CHECK_GT(delta, 0);
+    auto self = symmetric_global_alloc<GlobalPriorityQueue>();
+    call_on_all_cores([self,delta]{
+      new (self.localize()) GlobalPriorityQueue(self, delta);
+    });
+    return self;
+  }
+  
+  void destroy() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->~GlobalPriorityQueue(); });
+    global_free(self);
+  }
+  
+  /// Add an item on this core. Never blocks, so it can be used from message handlers
+  /// (e.g. from a delegate that just updated the item's owner).
+  void push_here(double priority, const T& value) {
+    ++priority_queue_pushes;
+    buckets[bucket_of(priority)].push_back(Item{priority, value});
+    local_size++;
+  }
+  
+  /// Add an item on core `owner`. From inside `process()` this is tracked by
+  /// `impl::priority_queue_gce`; otherwise it is guaranteed to have landed by the time
+  /// the next `process()` starts.
+  template< GlobalCompletionEvent * C = &impl::priority_queue_gce >
+  void push(Core owner, double priority, T value) {
+    if (owner == mycore()) {
+      push_here(priority, value);
+    } else {
+      ++priority_queue_remote_pushes;
+      auto self = this->self;
+      delegate::call<SyncMode::Async,C>(owner, [self,priority,value]{
+        self->push_here(priority, value);
+      });
+    }
+  }
+  
+  /// Total number of items queued (collective).
+  size_t size() {
+    return reduce<int64_t,GlobalPriorityQueue,collective_add,&local_size_of>(self);
+  }
+  
+  /// Visit items in bucket order until the queue is empty everywhere. `visit(T& item,
+  /// double priority)` runs in a task on the item's owner and may push more items (with
+  /// `push`, `push_here`, or async delegates enrolled in `impl::priority_queue_gce`).
+  ///
+  /// Must be called from a single task; blocks until done.
+  template< typename F >
+  void process(F visit) {
+    auto self = this->self;
+    
+    // make sure pushes issued before now have landed
+    on_all_cores([]{ impl::priority_queue_gce.wait(); });
+    
+    while (true) {
+      int64_t b = reduce<int64_t,GlobalPriorityQueue,collective_min,&min_bucket_of>(self);
+      if (b == NONE) break;
+      ++priority_queue_buckets;
+      call_on_all_cores([self,b]{ self->current = b; });
+      
+      do {
+        ++priority_queue_rounds;
+        on_all_cores([self,visit]{
+          auto m = self.localize();
+          auto it = m->buckets.find(m->current);
+          if (it != m->buckets.end()) {
+            // take the bucket: visits may refill it for the next round
+            auto items = new std::vector<Item>(std::move(it->second));
+            m->buckets.erase(it);
+            m->local_size -= items->size();
+            priority_queue_processed += items->size();
+            
+            forall_here<SyncMode::Async,&impl::priority_queue_gce>(0, items->size(),
+            [items,visit](int64_t i){
+              auto& e = (*items)[i];
+              visit(e.value, e.priority);
+            });
+            impl::priority_queue_gce.wait();
+            delete items;
+          } else {
+            impl::priority_queue_gce.wait();
+          }
+        });
+      } while (reduce<int64_t,GlobalPriorityQueue,collective_add,&current_size_of>(self) > 0);
+    }
+    call_on_all_cores([self]{ self->current = NONE; });
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// @}
+
+} // namespace Grappa
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalPriorityQueue.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalPriorityQueue_tests );
+
+DEFINE_int64(nelems, 1000, "number of items to push");
+
+typedef GlobalPriorityQueue<int64_t> Queue;
+
+int64_t visited = 0;
+int64_t max_bucket_seen = -1;
+bool out_of_order = false;
+
+/// Buckets are drained in increasing order (nothing pushes below the current bucket).
+void test_bucket_order() {
+  int64_t N = FLAGS_nelems;
+  auto q = Queue::create(10.0);
+  
+  forall(0, N, [q](int64_t i){
+    q->push(i % cores(), (i * 37) % 1000, i);
+  });
+  BOOST_CHECK_EQUAL(q->size(), N);
+  
+  call_on_all_cores([]{ visited = 0; max_bucket_seen = -1; out_of_order = false; });
+  q->process([q](int64_t& item, double priority){
+    int64_t b = priority / 10.0;
+    if (b < max_bucket_seen) out_of_order = true;
+    max_bucket_seen = std::max(max_bucket_seen, b);
+    visited++;
+  });
+  
+  int64_t total = reduce<int64_t,collective_add>(&visited);
+  bool any_out_of_order = reduce<bool,collective_or>(&out_of_order);
+  BOOST_CHECK_EQUAL(total, N);
+  BOOST_CHECK(!any_out_of_order);
+  BOOST_CHECK_EQUAL(q->size(), 0);
+  q->destroy();
+}
+
+/// Visits push follow-up items, some into the bucket being drained.
+void test_refill() {
+  const int64_t depth = 50;
+  auto q = Queue::create(4.0);
+  q->push(0, 0.0, 0);
+  
+  call_on_all_cores([]{ visited = 0; });
+  q->process([q](int64_t& item, double priority){
+    visited++;
+    if (item < depth) {
+      // alternate between same-bucket and next-bucket pushes on other cores
+      double next = priority + ((item % 2) ? 1.0 : 4.0);
+      q->push((item+1) % cores(), next, item+1);
+    }
+  });
+  
+  int64_t total = reduce<int64_t,collective_add>(&visited);
+  BOOST_CHECK_EQUAL(total, depth+1);
+  q->destroy();
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_bucket_order();
+    test_refill();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
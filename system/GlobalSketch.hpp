@@ -0,0 +1,304 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GlobalAllocator.hpp"
+#include "Collective.hpp"
+#include "CompletionEvent.hpp"
+#include "GlobalHashCommon.hpp"
+#include "LocaleSharedMemory.hpp"
+#include <vector>
+#include <cmath>
+#include <limits>
+
+namespace Grappa {
+
+/// @addtogroup Containers
+/// @{
+
+namespace impl {
+
+/// Common part of the sketch containers: a fixed-size array of words per core that
+/// local updates go into, plus a replicated `merged` copy filled in by `merge()`.
+/// `Derived::combine(a,b)` merges two words (it must be associative and commutative).
+template< typename Derived, typename W >
+class Sketch {
+public:
+  // private members
+  GlobalAddress<Derived> self;
+  std::vector<W> local;    ///< updates made on this core
+  std::vector<W> merged;   ///< sketch of all cores' updates, as of the last merge()
+  
+  Sketch(GlobalAddress<Derived> self, size_t nwords)
+    : self(self), local(nwords), merged(nwords) {}
+  
+  /// Send this core's `merged` to `dest`, which combines it into (or replaces) its own.
+  void send_merged(Core dest, bool combine) {
+    auto self = this->self;
+    size_t per_msg = MAX_MESSAGE_SIZE / sizeof(W);
+    CompletionEvent ce((merged.size() + per_msg - 1) / per_msg);
+    auto pce = &ce;
+    Core origin = mycore();
+    for (size_t k = 0; k < merged.size(); k += per_msg) {
+      size_t n = std::min(per_msg, merged.size()-k);
+      // payloads must live in locale shared memory; freed when `dest` acks
+      auto buf = locale_alloc<W>(n);
+      std::copy(&merged[k], &merged[k]+n, buf);
+      send_heap_message(dest, [self,k,combine,origin,pce,buf](void * payload, size_t sz){
+        auto in = static_cast<W*>(payload);
+        auto out = &self->merged[k];
+        for (size_t i = 0; i < sz/sizeof(W); i++) {
+          out[i] = combine ? Derived::combine(out[i], in[i]) : in[i];
+        }
+        send_heap_message(origin, [pce,buf]{
+          locale_free(buf);
+          pce->complete();
+        });
+      }, buf, n*sizeof(W));
+    }
+    ce.wait();
+  }
+  
+public:
+  Sketch() {}
+  
+  /// Combine all cores' updates into `merged` on every core, by reducing up a binomial
+  /// tree to core 0 and copying the result back down it (log(cores) rounds each way).
+  /// Call from a single task, with no updates in flight.
+  void merge() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->merged = self->local; });
+    
+    Core top = 1;
+    for (; top < cores(); top *= 2) {
+      on_all_cores([self,top]{
+        if (mycore() % (2*top) == top) self->send_merged(mycore()-top, true);
+      });
+    }
+    for (top /= 2; top >= 1; top /= 2) {
+      on_all_cores([self,top]{
+        if (mycore() % (2*top) == 0 && mycore()+top < cores()) {
+          self->send_merged(mycore()+top, false);
+        }
+      });
+    }
+  }
+  
+  /// Fold another sketch of the same shape into this core's updates.
+  void merge_local(const Derived& other) {
+    CHECK_EQ(local.size(), other.local.size());
+    for (size_t i = 0; i < local.size(); i++) local[i] = Derived::combine(local[i], other.local[i]);
+  }
+  
+  /// Reset the sketch on all cores (collective).
+  void clear() {
+    auto self = this->self;
+    call_on_all_cores([self]{
+      std::fill(self->local.begin(), self->local.end(), W());
+      std::fill(self->merged.begin(), self->merged.end(), W());
+    });
+  }
+  
+  void destroy() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->~Derived(); });
+    global_free(self);
+  }
+  
+protected:
+  template< typename... Args >
+  static GlobalAddress<Derived> create_sketch(Args... args) {
+    auto self = symmetric_global_alloc<Derived>();
+    call_on_all_cores([self,args...]{
+      new (self.localize()) Derived(self, args...);
+    });
+    return self;
+  }
+};
+
+} // namespace impl
+
+/// HyperLogLog estimate of the number of distinct keys added on all cores.
+///
+/// `add()` only touches this core's registers; after `merge()` every core can call
+/// `estimate()` locally. Relative error is about `1.04/sqrt(2^precision)`.
+///
+/// @code
+///   auto hll = GlobalHyperLogLog<int64_t>::create();
+///   forall(keys, n, [hll](int64_t& k){ hll->add(k); });
+///   hll->merge();
+///   auto distinct = hll->estimate();
+/// @endcode
+template< typename K, typename Hash = Grappa::hash<K> >
+class GlobalHyperLogLog : public impl::Sketch<GlobalHyperLogLog<K,Hash>, uint8_t> {
+  using Base = impl::Sketch<GlobalHyperLogLog<K,Hash>, uint8_t>;
+public:
+  int precision;
+  
+  GlobalHyperLogLog(GlobalAddress<GlobalHyperLogLog> self, int precision)
+    : Base(self, size_t(1) << precision), precision(precision) {}
+  
+  static uint8_t combine(uint8_t a, uint8_t b) { return std::max(a, b); }
+  
+  /// @param precision  log2 of the number of registers (4..18)
+  static GlobalAddress<GlobalHyperLogLog> create(int precision = 14) {
+    CHECK(precision >= 4 && precision <= 18) << "unsupported HyperLogLog precision: " << precision;
+    return Base::create_sketch(precision);
+  }
+  
+  void add(const K& key) {
+    uint64_t h = Hash()(key);
+    auto idx = h >> (64 - precision);
+    uint64_t w = h << precision;
+    uint8_t rank = w ? __builtin_clzll(w) + 1 : 64 - precision + 1;
+    auto& r = this->local[idx];
+    if (rank > r) r = rank;
+  }
+  
+  /// Estimated number of distinct keys, from the merged registers.
+  double estimate() const {
+    double m = this->merged.size();
+    double alpha = (m == 16) ? 0.673 : (m == 32) ? 0.697 : (m == 64) ? 0.709
+                 : 0.7213 / (1 + 1.079/m);
+    double sum = 0;
+    size_t zeros = 0;
+    for (auto r : this->merged) {
+      sum += std::ldexp(1.0, -r);
+      if (r == 0) zeros++;
+    }
+    double e = alpha * m * m / sum;
+    // small range: linear counting is more accurate
+    if (e <= 2.5*m && zeros > 0) e = m * std::log(m / zeros);
+    return e;
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// Count-min sketch: per-key frequency estimates that are never too low, and too high
+/// by at most `e/width` of the total count with probability `1 - exp(-depth)`.
+///
+/// Use `estimate(key) >= phi * total()` to test for heavy hitters.
+template< typename K, typename Hash = Grappa::hash<K> >
+class GlobalCountMinSketch : public impl::Sketch<GlobalCountMinSketch<K,Hash>, uint64_t> {
+  using Base = impl::Sketch<GlobalCountMinSketch<K,Hash>, uint64_t>;
+public:
+  size_t width, depth;
+  
+  GlobalCountMinSketch(GlobalAddress<GlobalCountMinSketch> self, size_t width, size_t depth)
+    : Base(self, width*depth), width(width), depth(depth) {}
+  
+  static uint64_t combine(uint64_t a, uint64_t b) { return a + b; }
+  
+  static GlobalAddress<GlobalCountMinSketch> create(size_t width = 1<<12, size_t depth = 4) {
+    return Base::create_sketch(width, depth);
+  }
+  
+  /// Slot of `key` in each row, by double hashing.
+  template< typename F >
+  void for_each_slot(const K& key, F f) const {
+    uint64_t h1 = Hash()(key), h2 = hash_mix64(h1) | 1;
+    for (size_t i = 0; i < depth; i++) f(i*width + (h1 + i*h2) % width);
+  }
+  
+  void add(const K& key, uint64_t count = 1) {
+    for_each_slot(key, [this,count](size_t s){ this->local[s] += count; });
+  }
+  
+  /// Estimated count of `key` across all cores (from the merged sketch).
+  uint64_t estimate(const K& key) const {
+    uint64_t e = std::numeric_limits<uint64_t>::max();
+    for_each_slot(key, [this,&e](size_t s){ e = std::min(e, this->merged[s]); });
+    return e;
+  }
+  
+  /// Estimated count of `key` from this core's updates only.
+  uint64_t local_estimate(const K& key) const {
+    uint64_t e = std::numeric_limits<uint64_t>::max();
+    for_each_slot(key, [this,&e](size_t s){ e = std::min(e, this->local[s]); });
+    return e;
+  }
+  
+  /// Total of all counts added (exact).
+  uint64_t total() const {
+    uint64_t t = 0;
+    for (size_t i = 0; i < width; i++) t += this->merged[i];
+    return t;
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// Blocked Bloom filter: all of a key's bits fall in a single 64-byte block, so a
+/// lookup touches one cache line. No false negatives; the false positive rate is a
+/// bit higher than an unblocked filter of the same size.
+template< typename K, typename Hash = Grappa::hash<K> >
+class GlobalBloomFilter : public impl::Sketch<GlobalBloomFilter<K,Hash>, uint64_t> {
+  using Base = impl::Sketch<GlobalBloomFilter<K,Hash>, uint64_t>;
+  static const size_t block_words = block_size / sizeof(uint64_t);
+public:
+  size_t nblocks;
+  int nhashes;
+  
+  GlobalBloomFilter(GlobalAddress<GlobalBloomFilter> self, size_t nblocks, int nhashes)
+    : Base(self, nblocks*block_words), nblocks(nblocks), nhashes(nhashes) {}
+  
+  static uint64_t combine(uint64_t a, uint64_t b) { return a | b; }
+  
+  /// @param nbits    filter size (rounded up to a whole number of blocks)
+  /// @param nhashes  bits set per key (at most 7)
+  static GlobalAddress<GlobalBloomFilter> create(size_t nbits, int nhashes = 6) {
+    CHECK(nhashes >= 1 && nhashes <= 7);
+    size_t bits_per_block = block_words * 64;
+    return Base::create_sketch((nbits + bits_per_block - 1) / bits_per_block, nhashes);
+  }
+  
+  /// Calls `f(word, mask)` for each of `key`'s bits: the block is picked by the low
+  /// bits of the hash, and each bit position by 9 more bits of a second hash.
+  template< typename F >
+  void for_each_bit(const K& key, F f) const {
+    uint64_t h = Hash()(key), g = hash_mix64(h);
+    size_t block = (h % nblocks) * block_words;
+    for (int i = 0; i < nhashes; i++) {
+      auto bit = (g >> (9*i)) & 511;
+      f(block + bit/64, uint64_t(1) << (bit%64));
+    }
+  }
+  
+  void add(const K& key) {
+    for_each_bit(key, [this](size_t w, uint64_t mask){ this->local[w] |= mask; });
+  }
+  
+  /// True if `key` may have been added on any core (as of the last merge()).
+  bool may_contain(const K& key) const {
+    bool found = true;
+    for_each_bit(key, [this,&found](size_t w, uint64_t mask){
+      if ((this->merged[w] & mask) == 0) found = false;
+    });
+    return found;
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// @}
+
+} // namespace Grappa
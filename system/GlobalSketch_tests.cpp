@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalSketch.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalSketch_tests );
+
+DEFINE_int64(nelems, 100000, "number of keys added");
+
+/// Every core adds the same N keys, so there are N distinct keys in total.
+void test_hyperloglog() {
+  int64_t N = FLAGS_nelems;
+  auto hll = GlobalHyperLogLog<int64_t>::create(12);
+  on_all_cores([hll,N]{
+    for (int64_t i = 0; i < N; i++) hll->add(i);
+  });
+  hll->merge();
+  on_all_cores([hll,N]{
+    double e = hll->estimate();
+    BOOST_CHECK_LT(std::abs(e - N) / N, 0.1);
+  });
+  hll->destroy();
+}
+
+void test_count_min() {
+  int64_t N = FLAGS_nelems;
+  auto cms = GlobalCountMinSketch<int64_t>::create();
+  on_all_cores([cms,N]{
+    for (int64_t i = 0; i < N; i++) cms->add(i % 100 == 0 ? 7 : i);
+  });
+  cms->merge();
+  on_all_cores([cms,N]{
+    BOOST_CHECK_EQUAL(cms->total(), N*cores());
+    BOOST_CHECK_GE(cms->estimate(7), (N/100)*cores());
+    BOOST_CHECK_GE(cms->estimate(1), cores());
+    BOOST_CHECK_LT(cms->estimate(1), cms->estimate(7));
+  });
+  cms->destroy();
+}
+
+/// Core c adds keys c, c+cores, ...; every core must then see all of them.
+void test_bloom() {
+  int64_t N = FLAGS_nelems;
+  auto bf = GlobalBloomFilter<int64_t>::create(16*N);
+  on_all_cores([bf,N]{
+    for (int64_t i = mycore(); i < N; i += cores()) bf->add(i);
+  });
+  bf->merge();
+  on_all_cores([bf,N]{
+    int64_t false_pos = 0;
+    for (int64_t i = 0; i < N; i++) BOOST_CHECK(bf->may_contain(i));
+    for (int64_t i = N; i < 2*N; i++) if (bf->may_contain(i)) false_pos++;
+    BOOST_CHECK_LT(false_pos, N/100);
+  });
+  bf->destroy();
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_hyperloglog();
+    test_count_min();
+    test_bloom();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
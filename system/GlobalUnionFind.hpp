@@ -0,0 +1,270 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "GlobalAllocator.hpp"
+#include "ParallelLoop.hpp"
+#include "Delegate.hpp"
+#include "Collective.hpp"
+#include "FullEmpty.hpp"
+#include "Metrics.hpp"
+#include <unordered_map>
+#include <vector>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_finds);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_unions);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_hooks);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_hops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_splits);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_batch_dropped);
+GRAPPA_DECLARE_METRIC(SimpleMetric<size_t>, union_find_compress_rounds);
+
+namespace Grappa {
+
+/// @addtogroup Containers
+/// @{
+
+/// Distributed union-find (disjoint sets) over elements `0..n-1`.
+///
+/// The parent array lives in global memory. Operations are message chains that hop from
+/// element to parent at each owner rather than round trips from the caller, and every hop
+/// does path splitting (pointing the previous element at its grandparent). Roots are
+/// always hooked under the smaller-numbered root, so `parent[i] <= i` and concurrent
+/// unions can never form a cycle; this makes the asynchronous mode safe: issue
+/// `unite<async>` for every pair (hooking), then `compress()` so every element points
+/// directly at its root.
+///
+/// @b Example (connected components):
+/// @code
+///   auto uf = GlobalUnionFind::create(nv);
+///   forall(tg.edges, tg.nedge, [uf](TupleGraph::Edge& e){
+///     uf->unite<async>(e.v0, e.v1);
+///   });
+///   uf->compress();
+///   auto ncomponents = uf->count_roots();
+/// @endcode
+class GlobalUnionFind {
+public:
+  // private members
+  GlobalAddress<GlobalUnionFind> self;
+  GlobalAddress<int64_t> parent;
+  int64_t n;
+  int64_t changed;    ///< (per core) scratch for compress()
+  
+  GlobalUnionFind(GlobalAddress<GlobalUnionFind> self, GlobalAddress<int64_t> parent, int64_t n)
+    : self(self), parent(parent), n(n), changed(0) {}
+  
+  /// Follow parents from `x` (whose parent is `prev`'s current parent, or `prev` < 0 at
+  /// the start) to its root, then call `k(root)` in a handler on the root's core.
+  template< typename K >
+  static void chase(GlobalAddress<int64_t> parent, int64_t x, int64_t prev, K k) {
+    auto px = parent + x;
+    if (px.core() != mycore()) {
+      send_heap_message(px.core(), [parent,x,prev,k]{ chase(parent, x, prev, k); });
+      return;
+    }
+    ++union_find_hops;
+    int64_t p = *px.pointer();
+    if (prev >= 0 && p != x) {
+      // path splitting: prev skips over x to x's parent
+      ++union_find_splits;
+      auto pp = parent + prev;
+      auto split = [pp,x,p]{
+        auto q = pp.pointer();
+        if (*q == x) *q = p;
+      };
+      if (pp.core() == mycore()) split();
+      else send_heap_message(pp.core(), split);
+    }
+    if (p == x) k(x);
+    else chase(parent, p, x, k);
+  }
+  
+  /// Merge the sets of `a` and `b`, then call `done(merged)` in some handler.
+  template< typename D >
+  static void unite_roots(GlobalAddress<int64_t> parent, int64_t a, int64_t b, D done) {
+    chase(parent, a, -1, [parent,b,done](int64_t ra){
+      chase(parent, b, -1, [parent,ra,done](int64_t rb){
+        // here rb is a root (we're in the handler that just saw it)
+        if (ra == rb) {
+          done(false);
+        } else if (ra < rb) {
+          ++union_find_hooks;
+          *(parent+rb).pointer() = ra;
+          done(true);
+        } else {
+          send_heap_message((parent+ra).core(), [parent,ra,rb,done]{
+            auto q = (parent+ra).pointer();
+            if (*q == ra) {
+              ++union_find_hooks;
+              *q = rb;
+              done(true);
+            } else {
+              // ra was hooked under something else meanwhile; start over from it
+              unite_roots(parent, ra, rb, done);
+            }
+          });
+        }
+      });
+    });
+  }
+  
+  static int64_t changed_of(GlobalAddress<GlobalUnionFind> u) { return u->changed; }
+  
+public:
+  // for static construction
+  GlobalUnionFind() {}
+  
+  /// Create `n` singleton sets.
+  static GlobalAddress<GlobalUnionFind> create(int64_t n) {
+    auto parent = global_alloc<int64_t>(n);
+    auto self = symmetric_global_alloc<GlobalUnionFind>();
+    call_on_all_cores([self,parent,n]{
+      new (self.localize()) GlobalUnionFind(self, parent, n);
+    });
+    forall(parent, n, [](int64_t i, int64_t& p){ p = i; });
+    return self;
+  }
+  
+  void destroy() {
+    auto self = this->self;
+    global_free(parent);
+    call_on_all_cores([self]{ self->~GlobalUnionFind(); });
+    global_free(self);
+  }
+  
+  int64_t size() const { return n; }
+  
+  /// Global array of parents; after `compress()`, `parent[i]` is `i`'s representative.
+  GlobalAddress<int64_t> parents() const { return parent; }
+  
+  /// Representative of `i`'s set (the smallest element in it).
+  int64_t find(int64_t i) {
+    ++union_find_finds;
+    FullEmpty<int64_t> result;
+    auto ra = make_global(&result);
+    chase(parent, i, -1, [ra](int64_t r){
+      send_heap_message(ra.core(), [ra,r]{ ra->writeXF(r); });
+    });
+    return result.readFF();
+  }
+  
+  bool same(int64_t a, int64_t b) { return find(a) == find(b); }
+  
+  /// Merge the sets of `a` and `b`. Blocking mode returns true if they were distinct;
+  /// async mode enrolls with `C` and returns right away (result is always false).
+  template< SyncMode S = SyncMode::Blocking,
+            GlobalCompletionEvent * C = &impl::local_gce >
+  bool unite(int64_t a, int64_t b) {
+    ++union_find_unions;
+    if (S == SyncMode::Async) {
+      if (C) C->enroll();
+      Core origin = mycore();
+      unite_roots(parent, a, b, [origin](bool merged){
+        if (C) C->send_completion(origin);
+      });
+      return false;
+    } else {
+      FullEmpty<bool> result;
+      auto ra = make_global(&result);
+      unite_roots(parent, a, b, [ra](bool merged){
+        send_heap_message(ra.core(), [ra,merged]{ ra->writeXF(merged); });
+      });
+      return result.readFF();
+    }
+  }
+  
+  /// Union of each pair `(a[i], b[i])`. Pairs made redundant by earlier pairs of the same
+  /// batch are dropped locally first, and the rest are issued concurrently (so requests to
+  /// the same core share aggregated messages). Returns how many sets were merged.
+  size_t unite(const int64_t * a, const int64_t * b, size_t n) {
+    // local union-find over just the elements of this batch
+    std::unordered_map<int64_t,int64_t> local(2*n);
+    auto lfind = [&local](int64_t x){
+      auto it = local.find(x);
+      if (it == local.end()) { local[x] = x; return x; }
+      while (local[x] != x) {
+        local[x] = local[local[x]];
+        x = local[x];
+      }
+      return x;
+    };
+    
+    std::vector<size_t> keep;
+    for (size_t i = 0; i < n; i++) {
+      auto ra = lfind(a[i]), rb = lfind(b[i]);
+      if (ra == rb) continue;
+      local[std::max(ra,rb)] = std::min(ra,rb);
+      keep.push_back(i);
+    }
+    union_find_batch_dropped += n - keep.size();
+    union_find_unions += keep.size();
+    
+    size_t merged = 0;
+    CompletionEvent ce(keep.size());
+    auto cea = make_global(&ce);
+    auto ma = make_global(&merged);
+    for (auto i : keep) {
+      unite_roots(parent, a[i], b[i], [cea,ma](bool m){
+        send_heap_message(cea.core(), [cea,ma,m]{
+          if (m) (*ma.pointer())++;
+          cea->complete();
+        });
+      });
+    }
+    ce.wait();
+    return merged;
+  }
+  
+  /// Pointer-jump until every element points directly at its root (collective).
+  void compress() {
+    auto self = this->self;
+    auto parent = this->parent;
+    do {
+      ++union_find_compress_rounds;
+      call_on_all_cores([self]{ self->changed = 0; });
+      forall(parent, n, [self,parent](int64_t i, int64_t& p){
+        if (p == i) return;
+        auto gp = delegate::read(parent + p);
+        if (gp != p) {
+          p = gp;
+          self->changed++;
+        }
+      });
+    } while (reduce<int64_t,GlobalUnionFind,collective_add,&changed_of>(self) > 0);
+  }
+  
+  /// Number of sets (collective).
+  int64_t count_roots() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->changed = 0; });
+    forall(parent, n, [self](int64_t i, int64_t& p){ if (p == i) self->changed++; });
+    return reduce<int64_t,GlobalUnionFind,collective_add,&changed_of>(self);
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// @}
+
+} // namespace Grappa
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalUnionFind.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalUnionFind_tests );
+
+DEFINE_int64(nelems, 10007, "number of elements");
+
+void test_blocking() {
+  auto uf = GlobalUnionFind::create(16);
+  BOOST_CHECK(uf->unite(3, 5));
+  BOOST_CHECK(uf->unite(5, 9));
+  BOOST_CHECK(!uf->unite(9, 3));
+  BOOST_CHECK(uf->same(3, 9));
+  BOOST_CHECK(!uf->same(3, 4));
+  BOOST_CHECK_EQUAL(uf->find(9), 3);
+  BOOST_CHECK_EQUAL(uf->count_roots(), 14);
+  uf->destroy();
+}
+
+/// Chain every element to its successor from all cores at once; must end in one set.
+void test_async_chain() {
+  int64_t N = FLAGS_nelems;
+  auto uf = GlobalUnionFind::create(N);
+  forall(uf->parents(), N-1, [uf,N](int64_t i, int64_t& p){
+    uf->unite<SyncMode::Async>(N-1-i, N-2-i);
+  });
+  uf->compress();
+  BOOST_CHECK_EQUAL(uf->count_roots(), 1);
+  forall(uf->parents(), N, [](int64_t i, int64_t& p){
+    BOOST_CHECK_EQUAL(p, 0);
+  });
+  uf->destroy();
+}
+
+/// Batched unions of residues mod 7.
+void test_batch() {
+  int64_t N = FLAGS_nelems;
+  auto uf = GlobalUnionFind::create(N);
+  on_all_cores([uf,N]{
+    std::vector<int64_t> a, b;
+    for (int64_t i = mycore(); i+7 < N; i += cores()) {
+      a.push_back(i); b.push_back(i+7);
+      a.push_back(i+7); b.push_back(i);   // redundant
+    }
+    uf->unite(&a[0], &b[0], a.size());
+  });
+  uf->compress();
+  BOOST_CHECK_EQUAL(uf->count_roots(), 7);
+  forall(uf->parents(), N, [](int64_t i, int64_t& p){
+    BOOST_CHECK_EQUAL(p, i % 7);
+  });
+  uf->destroy();
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_blocking();
+    test_async_chain();
+    test_batch();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -36,3 +36,7 @@ GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, global_vector_pop_latency, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, global_vector_deq_latency, 0);
 
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, global_vector_master_combined, 0);
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_vector_append_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_vector_appended, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_vector_grows, 0);
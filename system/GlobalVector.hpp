@@ -31,7 +31,9 @@
 #include "FlatCombiner.hpp"
 #include "ParallelLoop.hpp"
 #include "Delegate.hpp"
+#include "Array.hpp"
 #include <queue>
+#include <vector>
 
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_vector_push_ops);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_vector_push_msgs);
@@ -48,7 +50,12 @@ GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, global_vector_pop_latency);
 // tracks number of operations combined at a time on the master
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, global_vector_master_combined);
 
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_vector_append_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_vector_appended);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_vector_grows);
+
 namespace Grappa {
+
 /// @addtogroup Containers
 /// @{
 
@@ -98,6 +105,10 @@ public:
     bool combining;
     CompletionEvent ce;
     SuspendedDelegateQueue push_q, pop_q, deq_q;
+    
+    int64_t writers;  ///< appends still writing into their reserved range
+    bool growing;     ///< storage is being reallocated; new reservations wait
+    std::vector<std::pair<size_t,GlobalAddress<FullEmpty<GlobalAddress<T>>>>> waiting;
     bool has_requests() { return !push_q.empty() || !pop_q.empty() || !deq_q.empty(); }
     
     void clear() {
@@ -108,7 +119,7 @@ public:
       combining = false;
     }
     
-    Master() { clear(); }
+    Master(): writers(0), growing(false) { clear(); }
     ~Master() {}
     
     static void master_combine(GlobalAddress<GlobalVector> self) {
@@ -262,6 +273,74 @@ public:
       send_message(MASTER, [self]{ self->master.ce.complete(); });
     }
     
+    /// Reserve `n` slots at the end for an append, replying with the address of the first
+    /// one. If the free space after the last element is too small, the request waits for
+    /// the storage to grow. (runs on MASTER; doesn't block)
+    static void reserve(GlobalAddress<GlobalVector> self, size_t n,
+                        GlobalAddress<FullEmpty<GlobalAddress<T>>> result) {
+      auto m = &self->master;
+      auto end = m->head + m->size;
+      size_t room = (end <= self->capacity) ? self->capacity - end : 0;
+      
+      if (m->growing || room < n) {
+        m->waiting.push_back(std::make_pair(n, result));
+        if (!m->growing) {
+          m->growing = true;
+          if (m->writers == 0) spawn([self]{ grow(self); });
+        }
+        return;
+      }
+      
+      auto at = self->base + end;
+      m->size += n;
+      m->tail = m->tail_allocator = (m->head + m->size) % self->capacity;
+      m->writers++;
+      
+      auto reply = [result,at]{ result->writeXF(at); };
+      if (result.core() == mycore()) reply();
+      else send_heap_message(result.core(), reply);
+    }
+    
+    static void done_writing(GlobalAddress<GlobalVector> self) {
+      auto m = &self->master;
+      m->writers--;
+      if (m->writers == 0 && m->growing) spawn([self]{ grow(self); });
+    }
+    
+    /// Move the elements into new storage (at least twice as big, with room for all
+    /// waiting appends) starting at index 0, then grant the waiting reservations.
+    static void grow(GlobalAddress<GlobalVector> self) {
+      auto m = &self->master;
+      ++global_vector_grows;
+      
+      size_t needed = m->size;
+      for (auto& w : m->waiting) needed += w.first;
+      
+      auto old = self->base;
+      size_t cap = self->capacity, head = m->head, size = m->size;
+      size_t new_cap = std::max(2*cap, needed);
+      auto nb = global_alloc<T>(new_cap);
+      DVLOG(2) << "growing " << cap << " -> " << new_cap;
+      
+      // the elements are at most two contiguous runs of the ring: [head,cap) and [0,tail)
+      size_t first = std::min(size, cap - head);
+      if (first > 0) Grappa::memcpy(nb, old+head, first);
+      if (size > first) Grappa::memcpy(nb+first, old, size-first);
+      call_on_all_cores([self,nb,new_cap]{
+        self->base = nb;
+        self->capacity = new_cap;
+      });
+      global_free(old);
+      
+      m->head = m->head_allocator = 0;
+      m->tail = m->tail_allocator = size % new_cap;
+      m->growing = false;
+      
+      auto waiting = std::move(m->waiting);
+      m->waiting.clear();
+      for (auto& w : waiting) reserve(self, w.first, w.second);
+    }
+    
   };
 
   inline void incr_with_wrap(size_t * i, long incr) {
@@ -422,6 +501,36 @@ public:
   
   inline void enqueue(const T& e) { push(e); }
   
+  /// Append `n` elements to the back in one bulk operation.
+  ///
+  /// Only a single message to MASTER is needed to reserve a contiguous range; the
+  /// elements are then written straight into global memory, so concurrent appends from
+  /// many cores proceed in parallel. If the vector is out of space, its storage is
+  /// reallocated (at least doubling capacity). Must not run concurrently with
+  /// push/pop/dequeue.
+  void append(const T * elems, size_t n) {
+    if (n == 0) return;
+    ++global_vector_append_ops;
+    global_vector_appended += n;
+    auto self = this->self;
+    
+    FullEmpty<GlobalAddress<T>> result;
+    auto result_addr = make_global(&result);
+    if (MASTER == mycore()) Master::reserve(self, n, result_addr);
+    else send_message(MASTER, [self,n,result_addr]{ Master::reserve(self, n, result_addr); });
+    auto at = result.readFF();
+    
+    {
+      typename Incoherent<T>::WO c(at, n, const_cast<T*>(elems));
+      c.block_until_acquired();
+    }
+    
+    if (MASTER == mycore()) Master::done_writing(self);
+    else send_message(MASTER, [self]{ Master::done_writing(self); });
+  }
+  
+  void append(const std::vector<T>& elems) { append(elems.data(), elems.size()); }
+  
   T dequeue() {
     ++global_vector_deq_ops;
     double t = Grappa::walltime();
@@ -202,6 +202,30 @@ void test_stack() {
   sa->destroy();
 }
 
+/// Bulk appends from all cores, starting small enough that storage has to grow.
+void test_append() {
+  auto va = GlobalVector<long>::create(16);
+  
+  on_all_cores([va]{
+    forall_here(0, 10, [va](int64_t i){
+      std::vector<long> elems;
+      for (long j = 0; j < 100; j++) elems.push_back(mycore()*1000 + i*100 + j);
+      va->append(elems);
+    });
+  });
+  BOOST_CHECK_EQUAL(va->size(), cores()*1000);
+  BOOST_CHECK_GE(va->capacity, cores()*1000);
+  
+  // every element made it exactly once (each core's values sum to the same total)
+  static long total;
+  call_on_all_cores([]{ total = 0; });
+  forall(va, [](long& e){ total += e % 1000; });
+  long sum = reduce<long,collective_add>(&total);
+  BOOST_CHECK_EQUAL(sum, cores()*(999*1000/2));
+  
+  va->destroy();
+}
+
 using StatTuple = std::tuple<long,long,long,long,long,long,long,long>;
 StatTuple save_global_vector_stats() {
   return std::make_tuple(global_vector_push_msgs,
@@ -266,6 +290,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       test_global_vector();
       test_dequeue();
       test_stack();
+      test_append();
     }
   
   });
@@ -23,6 +23,14 @@
 
 #include "LocaleSharedMemory.hpp"
 
+#include <algorithm>
+#include <vector>
+#include <execinfo.h>
+
+#ifndef COMMUNICATOR_TEST
+#include "Metrics.hpp"
+#endif
+
 DEFINE_int64( locale_shared_size, 0, "Total shared memory between cores on node (when 0, defaults to locale_shared_fraction * total node memory)" );
 
 DEFINE_double( locale_shared_fraction, 0.5, "Fraction of total node memory to allocate for Grappa" );
@@ -31,6 +39,8 @@ DEFINE_double( locale_user_heap_fraction, 0.1, "Fraction of locale shared memory
 
 DEFINE_double( global_heap_fraction, 0.25, "Fraction of locale shared memory to set aside for global shared heap" );
 
+DEFINE_bool( locale_shared_track_sites, false, "Record bytes allocated from locale shared memory by call site (reported if an allocation fails)" );
+
 DECLARE_int64( node_memsize );
 DECLARE_bool( global_memory_use_hugepages );
 
@@ -58,6 +68,32 @@ namespace impl {
 /// global LocaleSharedMemory instance
 LocaleSharedMemory locale_shared_memory;
 
+}
+}
+
+#ifndef COMMUNICATOR_TEST
+#define LOCALE_SHARED_USAGE_METRICS( name, tag )                                  \
+  GRAPPA_DEFINE_METRIC( CallbackMetric<int64_t>, locale_shared_##name##_bytes, []{  \
+      return Grappa::impl::locale_shared_memory.get_usage( tag ).current;         \
+    });                                                                           \
+  GRAPPA_DEFINE_METRIC( CallbackMetric<int64_t>, locale_shared_##name##_peak_bytes, []{ \
+      return Grappa::impl::locale_shared_memory.get_usage( tag ).peak;            \
+    })
+
+using Grappa::impl::LocaleAllocTag;
+LOCALE_SHARED_USAGE_METRICS( user,         LocaleAllocTag::User );
+LOCALE_SHARED_USAGE_METRICS( global_heap,  LocaleAllocTag::GlobalHeap );
+LOCALE_SHARED_USAGE_METRICS( stacks,       LocaleAllocTag::Stacks );
+LOCALE_SHARED_USAGE_METRICS( messages,     LocaleAllocTag::Messages );
+LOCALE_SHARED_USAGE_METRICS( communicator, LocaleAllocTag::Communicator );
+LOCALE_SHARED_USAGE_METRICS( aggregator,   LocaleAllocTag::Aggregator );
+LOCALE_SHARED_USAGE_METRICS( cache,        LocaleAllocTag::Cache );
+LOCALE_SHARED_USAGE_METRICS( tasks,        LocaleAllocTag::Tasks );
+#endif
+
+namespace Grappa {
+namespace impl {
+
 
 
 
@@ -143,6 +179,8 @@ LocaleSharedMemory::LocaleSharedMemory()
   , base_address( reinterpret_cast<void*>( 0x400000000000L ) )
   , segment() // default constructor; initialize later
   , allocated(0)
+  , usage()
+  , sites()
 { 
   boost::interprocess::shared_memory_object::remove( region_name.c_str() );
 
@@ -178,23 +216,84 @@ void LocaleSharedMemory::finish() {
   //if( Grappa::locale_mycore() == 0 ) { destroy(); }
 }
 
-void * LocaleSharedMemory::allocate( size_t size ) {
+const char * LocaleSharedMemory::tag_name( LocaleAllocTag tag ) {
+  switch( tag ) {
+  case LocaleAllocTag::User:         return "user";
+  case LocaleAllocTag::GlobalHeap:   return "global_heap";
+  case LocaleAllocTag::Stacks:       return "stacks";
+  case LocaleAllocTag::Messages:     return "messages";
+  case LocaleAllocTag::Communicator: return "communicator";
+  case LocaleAllocTag::Aggregator:   return "aggregator";
+  case LocaleAllocTag::Cache:        return "cache";
+  case LocaleAllocTag::Tasks:        return "tasks";
+  default:                           return "unknown";
+  }
+}
+
+void LocaleSharedMemory::record_allocation( void * p, LocaleAllocTag tag, void * site ) {
+  int64_t sz = segment.get_segment_manager()->size( p );
+  auto& u = usage[ static_cast<int>(tag) ];
+  u.current += sz;
+  u.allocations++;
+  if( u.current > u.peak ) u.peak = u.current;
+  
+  if( FLAGS_locale_shared_track_sites ) {
+    auto& s = sites[ site ];
+    s.bytes += sz;
+    s.allocations++;
+  }
+}
+
+void LocaleSharedMemory::dump_usage( size_t max_sites ) const {
+  LOG(INFO) << "Locale shared memory on core " << global_communicator.mycore << ": "
+            << get_free_memory() << " free of " << get_size();
+  for( int i = 0; i < static_cast<int>(LocaleAllocTag::Count); ++i ) {
+    LOG(INFO) << "  " << tag_name( static_cast<LocaleAllocTag>(i) ) << ": "
+              << usage[i].current << " bytes current, "
+              << usage[i].peak << " bytes peak, "
+              << usage[i].allocations << " allocations";
+  }
+  
+  if( FLAGS_locale_shared_track_sites && !sites.empty() ) {
+    std::vector< std::pair< void*, SiteUsage > > v( sites.begin(), sites.end() );
+    std::sort( v.begin(), v.end(), []( const std::pair< void*, SiteUsage >& a,
+                                       const std::pair< void*, SiteUsage >& b ) {
+        return a.second.bytes > b.second.bytes;
+      });
+    if( v.size() > max_sites ) v.resize( max_sites );
+    
+    std::vector< void* > addrs;
+    for( auto& e : v ) addrs.push_back( e.first );
+    char ** names = backtrace_symbols( addrs.data(), addrs.size() );
+    LOG(INFO) << "  Top allocation sites (total bytes allocated):";
+    for( size_t i = 0; i < v.size(); ++i ) {
+      LOG(INFO) << "    " << v[i].second.bytes << " bytes in "
+                << v[i].second.allocations << " allocations from "
+                << ( names ? names[i] : "?" );
+    }
+    if( names ) free( names );
+  }
+}
+
+void * LocaleSharedMemory::allocate( size_t size, LocaleAllocTag tag ) {
   void * p = NULL;
   try {
     p = segment.allocate( size );
     allocated += size;
   }
   catch(...){
-    LOG(ERROR) << "Allocation of " << size << " bytes failed with " 
-               << get_free_memory() << " free and "
+    LOG(ERROR) << "Allocation of " << size << " bytes for " << tag_name( tag )
+               << " failed with " << get_free_memory() << " free and "
                << allocated << " allocated locally";
+    dump_usage();
     failure_function();
     throw;
   }
+  record_allocation( p, tag, __builtin_return_address(0) );
   return p;
 }
 
-void * LocaleSharedMemory::allocate_aligned( size_t size, size_t alignment ) {
+void * LocaleSharedMemory::allocate_aligned( size_t size, size_t alignment, LocaleAllocTag tag ) {
   void * p = NULL;
   try {
     p = segment.allocate_aligned( size, alignment );
@@ -202,16 +301,20 @@ void * LocaleSharedMemory::allocate_aligned( size_t size, size_t alignment ) {
   }
   catch(...){
     LOG(ERROR) << "Allocation of " << size << " bytes with alignment " << alignment 
+               << " for " << tag_name( tag )
                << " failed with " << get_free_memory() << " free and "
                << allocated << " allocated locally";
+    dump_usage();
     failure_function();
     throw;
   }
+  record_allocation( p, tag, __builtin_return_address(0) );
   return p;
 }
 
-void LocaleSharedMemory::deallocate( void * ptr ) {
+void LocaleSharedMemory::deallocate( void * ptr, LocaleAllocTag tag ) {
   try {
+    usage[ static_cast<int>(tag) ].current -= segment.get_segment_manager()->size( ptr );
     segment.deallocate( ptr );
   }
   catch(...){
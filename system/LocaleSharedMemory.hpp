@@ -29,6 +29,7 @@
 #include <glog/logging.h>
 
 #include <string>
+#include <unordered_map>
 
 #include <boost/interprocess/managed_shared_memory.hpp>
 
@@ -37,13 +38,49 @@
 namespace Grappa {
 namespace impl {
 
+/// Subsystem on whose behalf memory is allocated from the locale shared heap, so we can
+/// tell which one is using it up.
+enum class LocaleAllocTag : int {
+  User,          ///< locale_alloc() and friends
+  GlobalHeap,    ///< this core's chunk of the global heap
+  Stacks,        ///< worker stacks
+  Messages,      ///< heap-allocated messages and message pools
+  Communicator,  ///< Communicator send/receive buffers
+  Aggregator,    ///< RDMAAggregator buffers
+  Cache,         ///< Cache/Incoherent buffers
+  Tasks,         ///< task queues
+  Count
+};
+
 class LocaleSharedMemory {
+public:
+  /// Bytes from locale shared memory currently held and peak held for one tag.
+  ///
+  /// These are per-core counts: memory freed by a different core than the one that
+  /// allocated it is debited to the freeing core, so only sums over a locale are exact.
+  struct TagUsage {
+    int64_t current;
+    int64_t peak;
+    int64_t allocations;
+  };
+  
+  /// Total bytes and number of allocations from one call site.
+  struct SiteUsage {
+    int64_t bytes;
+    int64_t allocations;
+  };
+
 private:
   size_t region_size;
   std::string region_name;
   void * base_address;
   
   size_t allocated;
+  
+  TagUsage usage[static_cast<int>(LocaleAllocTag::Count)];
+  std::unordered_map< void*, SiteUsage > sites;
+  
+  void record_allocation( void * p, LocaleAllocTag tag, void * site );
 
   void create();
   void attach();
@@ -68,6 +105,14 @@ public:
   // clean up before shutting down
   void finish();
 
+  /// Is [addr, addr+size) inside the locale shared memory (so other cores on this
+  /// locale can read it directly)?
+  inline bool contains( const void * addr, size_t size = 1 ) const {
+    const char * char_base = reinterpret_cast< const char* >( base_address );
+    const char * char_addr = reinterpret_cast< const char* >( addr );
+    return (char_base <= char_addr) && (char_addr + size <= char_base + region_size);
+  }
+
   // make sure an address is in the locale shared memory
   inline void validate_address( void * addr ) {
     //#ifndef NDEBUG
@@ -78,13 +123,21 @@ public:
   }
     //#endif
 
-  void * allocate( size_t size );
-  void * allocate_aligned( size_t size, size_t alignment );
-  void deallocate( void * ptr );
+  void * allocate( size_t size, LocaleAllocTag tag = LocaleAllocTag::User );
+  void * allocate_aligned( size_t size, size_t alignment, LocaleAllocTag tag = LocaleAllocTag::User );
+  
+  /// Free memory; `tag` should match the one it was allocated with.
+  void deallocate( void * ptr, LocaleAllocTag tag = LocaleAllocTag::User );
 
   const size_t get_free_memory() const { return segment.get_free_memory(); }
   const size_t get_size() const { return segment.get_size(); }
   const size_t get_allocated() const { return allocated; }
+  
+  const TagUsage& get_usage( LocaleAllocTag tag ) const { return usage[static_cast<int>(tag)]; }
+  static const char * tag_name( LocaleAllocTag tag );
+  
+  /// Log per-tag usage and (with --locale_shared_track_sites) the biggest allocation sites.
+  void dump_usage( size_t max_sites = 20 ) const;
 };
 
 
@@ -64,6 +64,22 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         BOOST_CHECK_EQUAL( arr[ Grappa::locale_mycore() ], other_index );
       });
 
+    LOG(INFO) << "Checking usage accounting";
+    {
+      using Grappa::impl::LocaleAllocTag;
+      auto& lsm = Grappa::impl::locale_shared_memory;
+      auto before = lsm.get_usage( LocaleAllocTag::Cache );
+      void * p = lsm.allocate( 1<<12, LocaleAllocTag::Cache );
+      auto during = lsm.get_usage( LocaleAllocTag::Cache );
+      BOOST_CHECK_GE( during.current - before.current, 1<<12 );
+      BOOST_CHECK_GE( during.peak, during.current );
+      BOOST_CHECK_EQUAL( during.allocations, before.allocations + 1 );
+      lsm.deallocate( p, LocaleAllocTag::Cache );
+      BOOST_CHECK_EQUAL( lsm.get_usage( LocaleAllocTag::Cache ).current, before.current );
+      BOOST_CHECK_GT( lsm.get_usage( LocaleAllocTag::Stacks ).current, 0 );
+      lsm.dump_usage();
+    }
+
     LOG(INFO) << "Done";
   });
   Grappa::finalize();
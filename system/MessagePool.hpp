@@ -92,7 +92,7 @@ namespace impl {
   class MessagePool : public impl::MessagePoolBase {
   public:
     MessagePool(size_t bytes)
-      : MessagePoolBase( reinterpret_cast<char*>( Grappa::impl::locale_shared_memory.allocate_aligned( bytes, 8 ) ), bytes, true) 
+      : MessagePoolBase( reinterpret_cast<char*>( Grappa::impl::locale_shared_memory.allocate_aligned( bytes, 8, Grappa::impl::LocaleAllocTag::Messages ) ), bytes, true) 
     {}
     MessagePool(void * ext_buf, size_t bytes):
       MessagePoolBase(static_cast<char*>(ext_buf), bytes, false) {}
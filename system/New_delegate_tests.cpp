@@ -24,6 +24,7 @@
 #include <boost/test/unit_test.hpp>
 #include "Grappa.hpp"
 #include "PerformanceTools.hpp"
+#include "BatchDelegate.hpp"
 
 BOOST_AUTO_TEST_SUITE( New_delegate_tests );
 
@@ -230,6 +231,42 @@ void check_call_suspending() {
   BOOST_CHECK_EQUAL(x, y);
 }
 
+void check_batch() {
+  BOOST_MESSAGE("Check batched delegates...");
+  
+  const int64_t N = 1000;
+  auto arr = global_alloc<int64_t>(N);
+  Grappa::memset(arr, 0, N);
+  
+  // each index appears twice so updates to the same element must accumulate
+  std::vector<int64_t> idx(2*N), ops(2*N), prev(2*N);
+  for (int64_t i = 0; i < 2*N; i++) { idx[i] = (i * 7) % N; ops[i] = i; }
+  
+  delegate::batch_fetch_and_add(arr, idx.data(), ops.data(), 2*N, prev.data());
+  
+  for (int64_t i = 0; i < N; i++) {
+    // index k is hit by i = j and i = j+N for the unique j < N with (j*7)%N == k
+    BOOST_CHECK_EQUAL(prev[i], 0);
+    BOOST_CHECK_EQUAL(prev[i+N], i);
+    BOOST_CHECK_EQUAL(delegate::read(arr+idx[i]), 2*i+N);
+  }
+  
+  for (int64_t i = 0; i < N; i++) { idx[i] = i; ops[i] = i % 5; }
+  delegate::batch_min(arr, idx.data(), ops.data(), N);
+  forall(arr, N, [](int64_t i, int64_t& e){ BOOST_CHECK_EQUAL(e, i % 5); });
+  
+  std::vector<int64_t> cmp(N), val(N);
+  for (int64_t i = 0; i < N; i++) { cmp[i] = (i % 2) ? i % 5 : -1; val[i] = 42; }
+  bool success[N];
+  delegate::batch_compare_and_swap(arr, idx.data(), cmp.data(), val.data(), N, success);
+  for (int64_t i = 0; i < N; i++) {
+    BOOST_CHECK_EQUAL(success[i], (i % 2) == 1);
+    BOOST_CHECK_EQUAL(delegate::read(arr+i), (i % 2) ? 42 : i % 5);
+  }
+  
+  global_free(arr);
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -247,6 +284,8 @@ BOOST_AUTO_TEST_CASE( test1 ) {
  
     check_call_suspending();
  
+    check_batch();
+ 
     int64_t seed = 111;
     GlobalAddress<int64_t> seed_addr = make_global(&seed);
 
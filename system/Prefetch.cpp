@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include "Prefetch.hpp"
+#include "Message.hpp"
+#include "Collective.hpp"
+#include <cstring>
+#include <vector>
+
+DEFINE_int64( prefetch_buffer_blocks, 1024, "Number of blocks in each core's prefetch buffer" );
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, prefetch_blocks_requested, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, prefetch_msgs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, prefetch_evictions, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, prefetch_hits, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, prefetch_waits, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, prefetch_misses, 0);
+
+namespace Grappa {
+namespace impl {
+
+namespace {
+  
+  PrefetchLine * lines = nullptr;
+  size_t nlines = 0;
+  
+  /// Request for one block, as sent to its home core.
+  struct BlockRequest {
+    intptr_t block;
+    uint32_t line;
+    uint32_t seq;
+  };
+  
+  inline size_t line_index(intptr_t block) {
+    if (lines == nullptr) {
+      nlines = FLAGS_prefetch_buffer_blocks;
+      CHECK_GT(nlines, 0);
+      lines = new PrefetchLine[nlines];
+      for (size_t i = 0; i < nlines; i++) {
+        lines[i].block = -1;
+        lines[i].seq = 0;
+        lines[i].ready = false;
+      }
+    }
+    return (block / block_size) % nlines;
+  }
+  
+  /// Claim a line for `block`; returns false if it is already there (or on the way).
+  inline bool claim(intptr_t block, BlockRequest * r) {
+    size_t i = line_index(block);
+    auto& l = lines[i];
+    if (l.block == block) return false;
+    if (l.block != -1) prefetch_evictions++;
+    l.block = block;
+    l.seq++;
+    l.ready = false;
+    r->block = block;
+    r->line = i;
+    r->seq = l.seq;
+    return true;
+  }
+  
+  /// At the block's home core: send its current contents back to `origin`.
+  inline void reply(Core origin, const BlockRequest& r) {
+    auto line = r.line;
+    auto seq = r.seq;
+    char * p = GlobalAddress<char>::Raw(r.block).pointer();
+    send_heap_message(origin, [line,seq](void * payload, size_t sz) {
+      auto& l = lines[line];
+      if (l.seq == seq) {
+        std::memcpy(l.data, payload, block_size);
+        l.ready = true;
+        broadcast(&l.cv);
+      }
+    }, p, block_size);
+  }
+  
+} // namespace
+
+void prefetch_blocks(const intptr_t * blocks, size_t n) {
+  Core origin = mycore();
+  std::vector< std::vector<BlockRequest> > reqs(cores());
+  
+  for (size_t i = 0; i < n; i++) {
+    Core c = GlobalAddress<char>::Raw(blocks[i]).core();
+    if (c == origin) continue;
+    BlockRequest r;
+    if (claim(blocks[i], &r)) reqs[c].push_back(r);
+  }
+  
+  const size_t max_per_msg = MAX_MESSAGE_SIZE / sizeof(BlockRequest);
+  
+  for (Core c = 0; c < cores(); c++) {
+    auto& v = reqs[c];
+    prefetch_blocks_requested += v.size();
+    for (size_t s = 0; s < v.size(); s += max_per_msg) {
+      size_t m = std::min(max_per_msg, v.size() - s);
+      prefetch_msgs++;
+      if (m == 1) {
+        BlockRequest r = v[s];
+        send_heap_message(c, [origin,r]{ reply(origin, r); });
+      } else {
+        // payload must stay valid until sent, so it can't live in this vector
+        auto buf = locale_alloc<BlockRequest>(m);
+        std::memcpy(buf, &v[s], m * sizeof(BlockRequest));
+        send_heap_message(c, [origin,buf](void * payload, size_t sz) {
+          auto rs = static_cast<BlockRequest*>(payload);
+          for (size_t i = 0; i < sz / sizeof(BlockRequest); i++) reply(origin, rs[i]);
+          send_heap_message(origin, [buf]{ locale_free(buf); });
+        }, buf, m * sizeof(BlockRequest));
+      }
+    }
+  }
+}
+
+void prefetch_bytes(GlobalAddress<char> addr, size_t nbytes) {
+  if (nbytes == 0) return;
+  std::vector<intptr_t> blocks;
+  intptr_t first = addr.raw_bits();
+  intptr_t last = first + nbytes - 1;
+  for (intptr_t b = block_of(first); b <= last; b += block_size) blocks.push_back(b);
+  prefetch_blocks(blocks.data(), blocks.size());
+}
+
+bool prefetch_copy(GlobalAddress<char> addr, size_t nbytes, void * out, bool wait) {
+  char * o = static_cast<char*>(out);
+  intptr_t raw = addr.raw_bits();
+  
+  while (nbytes > 0) {
+    intptr_t block = block_of(raw);
+    size_t off = raw - block;
+    size_t n = std::min<size_t>(nbytes, block_size - off);
+    
+    auto a = GlobalAddress<char>::Raw(raw);
+    if (a.core() == mycore()) {
+      std::memcpy(o, a.pointer(), n);
+    } else {
+      if (lines == nullptr) { prefetch_misses++; return false; }
+      auto& l = lines[line_index(block)];
+      while (true) {
+        if (l.block != block) { prefetch_misses++; return false; }
+        if (l.ready) break;
+        if (!wait) return false;
+        prefetch_waits++;
+        Grappa::wait(&l.cv);
+      }
+      std::memcpy(o, l.data + off, n);
+      prefetch_hits++;
+    }
+    raw += n; o += n; nbytes -= n;
+  }
+  return true;
+}
+
+} // namespace impl
+
+void prefetch_invalidate() {
+  using namespace impl;
+  for (size_t i = 0; i < nlines; i++) {
+    lines[i].block = -1;
+    lines[i].seq++;
+    lines[i].ready = false;
+    broadcast(&lines[i].cv);
+  }
+}
+
+} // namespace Grappa
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Addressing.hpp"
+#include "ConditionVariableLocal.hpp"
+#include "Delegate.hpp"
+#include "Metrics.hpp"
+#include <vector>
+
+DECLARE_int64( prefetch_buffer_blocks );
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, prefetch_blocks_requested);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, prefetch_msgs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, prefetch_evictions);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, prefetch_hits);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, prefetch_waits);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, prefetch_misses);
+
+namespace Grappa {
+  
+  namespace impl {
+    
+    /// One block-sized slot of the per-core prefetch landing buffer.
+    struct PrefetchLine {
+      intptr_t block;        ///< raw bits of the first byte of the block held (-1 if empty)
+      uint32_t seq;          ///< bumped on every reuse so stale replies can be dropped
+      bool ready;            ///< data has arrived
+      ConditionVariable cv;  ///< tasks waiting for data to arrive
+      char data[block_size];
+    } GRAPPA_BLOCK_ALIGNED;
+    
+    /// Issue non-blocking fetches of the blocks holding bytes (addr..addr+nbytes).
+    void prefetch_bytes(GlobalAddress<char> addr, size_t nbytes);
+    
+    /// Issue non-blocking fetches for a list of blocks, one request message per core.
+    void prefetch_blocks(const intptr_t * blocks, size_t n);
+    
+    /// Copy `nbytes` at `addr` out of the landing buffer (or directly, if local).
+    /// If `wait` is true, blocks until in-flight prefetches of the data arrive.
+    /// Returns false if the data was never prefetched (or has since been evicted).
+    bool prefetch_copy(GlobalAddress<char> addr, size_t nbytes, void * out, bool wait);
+    
+    inline intptr_t block_of(intptr_t raw) { return raw & ~static_cast<intptr_t>(block_size-1); }
+  }
+  
+  /// @addtogroup Caches
+  /// @{
+  
+  /// Start fetching `count` elements at `addr` into this core's prefetch buffer without
+  /// blocking. A later `prefetched_read()` of the same data is satisfied locally once it
+  /// has arrived, so a loop can issue its next hops before it needs them.
+  ///
+  /// The prefetch buffer is a small direct-mapped set of blocks
+  /// (`--prefetch_buffer_blocks`), so prefetching much more than fits evicts earlier
+  /// data. Like `Incoherent<T>::RO`, prefetched data is a snapshot: it is not updated
+  /// if the remote copy changes; use `prefetch_invalidate()` between phases.
+  template< typename T >
+  void prefetch(GlobalAddress<T> addr, size_t count = 1) {
+    impl::prefetch_bytes(static_cast<GlobalAddress<char>>(addr), count * sizeof(T));
+  }
+  
+  /// Batched prefetch: start fetching one element at each of `n` addresses, sending one
+  /// request message per destination core.
+  template< typename T >
+  void prefetch(const GlobalAddress<T> * addrs, size_t n) {
+    std::vector<intptr_t> blocks;
+    blocks.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      intptr_t first = addrs[i].raw_bits();
+      intptr_t last = first + sizeof(T) - 1;
+      for (intptr_t b = impl::block_of(first); b <= last; b += block_size) {
+        blocks.push_back(b);
+      }
+    }
+    impl::prefetch_blocks(blocks.data(), blocks.size());
+  }
+  
+  /// Read an element, using this core's prefetch buffer if it was prefetched (waiting for
+  /// it to arrive if it is still in flight), and a blocking delegate read otherwise.
+  template< typename T >
+  T prefetched_read(GlobalAddress<T> addr) {
+    T val;
+    if (!impl::prefetch_copy(static_cast<GlobalAddress<char>>(addr), sizeof(T), &val, true)) {
+      val = delegate::read(addr);
+    }
+    return val;
+  }
+  
+  /// Check if an element is already in this core's prefetch buffer and, if so, copy it
+  /// into `val` without blocking.
+  template< typename T >
+  bool try_prefetched_read(GlobalAddress<T> addr, T * val) {
+    return impl::prefetch_copy(static_cast<GlobalAddress<char>>(addr), sizeof(T), val, false);
+  }
+  
+  /// Drop everything in this core's prefetch buffer (in-flight data will be discarded).
+  void prefetch_invalidate();
+  
+  /// @}
+}
@@ -0,0 +1,84 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "Prefetch.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( Prefetch_tests );
+
+const int64_t N = 1000;
+
+/// Chase a linked list laid out across all cores, prefetching the next hop.
+void test_chase() {
+  auto next = global_alloc<int64_t>(N);
+  // i -> (i + 17) % N visits every element since gcd(17, N) == 1
+  forall(next, N, [](int64_t i, int64_t& e){ e = (i + 17) % N; });
+  
+  int64_t cur = 0;
+  prefetch(next+cur);
+  for (int64_t k = 0; k < N; k++) {
+    int64_t nxt = prefetched_read(next+cur);
+    BOOST_CHECK_EQUAL(nxt, (cur + 17) % N);
+    prefetch(next+nxt);
+    cur = nxt;
+  }
+  BOOST_CHECK_EQUAL(cur, 0);
+  
+  global_free(next);
+}
+
+/// Batched prefetch, then check reads are served from the buffer.
+void test_batch() {
+  auto xs = global_alloc<int64_t>(N);
+  forall(xs, N, [](int64_t i, int64_t& e){ e = 3*i; });
+  
+  std::vector<GlobalAddress<int64_t>> addrs;
+  for (int64_t i = 0; i < N; i += 37) addrs.push_back(xs+i);
+  prefetch(addrs.data(), addrs.size());
+  
+  for (auto a : addrs) BOOST_CHECK_EQUAL(prefetched_read(a), 3*(a-xs));
+  
+  // after invalidating, nothing remote is in the buffer
+  prefetch_invalidate();
+  int64_t v;
+  for (auto a : addrs) {
+    if (a.core() != mycore()) BOOST_CHECK(!try_prefetched_read(a, &v));
+  }
+  
+  global_free(xs);
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_chase();
+    test_batch();
+    Metrics::merge_and_print();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
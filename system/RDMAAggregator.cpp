@@ -248,7 +248,8 @@ namespace Grappa {
   }
 
     void RDMAAggregator::fill_free_pool( size_t num_buffers ) {
-        void * p = Grappa::impl::locale_shared_memory.allocate_aligned( sizeof(RDMABuffer) * num_buffers, 8 );
+        void * p = Grappa::impl::locale_shared_memory.allocate_aligned( sizeof(RDMABuffer) * num_buffers, 8,
+                                                                                Grappa::impl::LocaleAllocTag::Aggregator );
         CHECK_NOTNULL( p );
         DVLOG(2) << "Allocated buffers: " << num_buffers;
         rdma_buffers_ = reinterpret_cast< RDMABuffer * >( p );
@@ -458,7 +459,7 @@ namespace Grappa {
       dest_core_for_locale_ = NULL;
 
       if( core_partner_locales_ ) delete [] core_partner_locales_;
-      Grappa::impl::locale_shared_memory.deallocate( rdma_buffers_ );
+      Grappa::impl::locale_shared_memory.deallocate( rdma_buffers_, Grappa::impl::LocaleAllocTag::Aggregator );
 #endif
     }
 
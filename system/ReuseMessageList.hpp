@@ -56,7 +56,8 @@ public:
 
   // initialize list in locale shared memory
   void activate() {
-    void * p = Grappa::impl::locale_shared_memory.allocate( sizeof(ReuseMessage<T>) * outstanding_ );
+    void * p = Grappa::impl::locale_shared_memory.allocate( sizeof(ReuseMessage<T>) * outstanding_,
+                                                              Grappa::impl::LocaleAllocTag::Messages );
     messages_ = new (p) ReuseMessage<T>[ outstanding_ ];
     for( int i = 0; i < outstanding_; ++i ) {
       messages_[i].list_ = this;
@@ -68,7 +69,7 @@ public:
     while( !(this->empty()) ) {
       this->block_until_pop();
     }
-    Grappa::impl::locale_shared_memory.deallocate( messages_ );
+    Grappa::impl::locale_shared_memory.deallocate( messages_, Grappa::impl::LocaleAllocTag::Messages );
   }
 
   template< typename F >
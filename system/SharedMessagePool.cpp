@@ -109,7 +109,7 @@ void* alloc(size_t sz) {
   
   if( sz > MAX_POOL_MESSAGE_SIZE ) {
     shared_pool_alloc_toobig++;
-    return locale_alloc_aligned<char>(CACHE_LINE_SIZE, sz);
+    return impl::locale_shared_memory.allocate_aligned(sz, CACHE_LINE_SIZE, impl::LocaleAllocTag::Messages);
   } else {
     // record the pool allocation (bucketed by number of cachelines)
     switch( cacheline_count ) {
@@ -126,7 +126,7 @@ void free(MessageBase * m, size_t sz) {
   size_t cacheline_count = sz / CACHE_LINE_SIZE;
   
   if( sz > MAX_POOL_MESSAGE_SIZE ) {
-    return locale_free(m);
+    return impl::locale_shared_memory.deallocate(m, impl::LocaleAllocTag::Messages);
   } else {
     return aligned_pool_allocator_free( &message_pool[cacheline_count], m );
   }
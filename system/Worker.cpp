@@ -128,7 +128,8 @@ void coro_spawn(Worker * me, Worker * c, coro_func f, size_t ssize) {
   c->idle = 0;
 
   // allocate stack and guard page
-  c->base = Grappa::impl::locale_shared_memory.allocate_aligned( ssize+4096*2, 4096 );
+  c->base = Grappa::impl::locale_shared_memory.allocate_aligned( ssize+4096*2, 4096,
+                                                                 Grappa::impl::LocaleAllocTag::Stacks );
   CHECK_NOTNULL( c->base );
   c->ssize = ssize;
 
@@ -215,7 +216,7 @@ void destroy_coro(Worker * c) {
     checked_mprotect( (void*)(c), 4096, PROT_READ | PROT_WRITE );
 #endif
     remove_coro(c); // remove from debugging list of coros
-    Grappa::impl::locale_shared_memory.deallocate(c->base);
+    Grappa::impl::locale_shared_memory.deallocate(c->base, Grappa::impl::LocaleAllocTag::Stacks);
   }
 }
 
@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Grappa.hpp"
+#include "Metrics.hpp"
+#include "LocaleSharedMemory.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, write_combiner_writes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, write_combiner_local_writes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, write_combiner_msgs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, write_combiner_runs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, write_combiner_overwritten);
+
+namespace Grappa {
+
+namespace impl {
+  /// Completion event used by default to track outstanding WriteCombiner flushes.
+  /// Kept separate from `local_gce` so a flush may be done while a loop using the
+  /// default GCE is still outstanding.
+  extern GlobalCompletionEvent write_combiner_gce;
+}
+
+/// @addtogroup Containers
+/// @{
+
+/// Buffers scattered remote writes (`*addr = val`) per destination core and ships them
+/// in bulk, instead of sending one delegate message per element.
+///
+/// When a destination's buffer fills up (or on `flush()`), its writes are sorted by the
+/// destination-local address, repeated writes to the same element are collapsed (the
+/// last one issued wins), and writes to adjacent elements are coalesced into runs that
+/// the receiver applies with a single `memcpy`. Writes to local addresses are performed
+/// immediately.
+///
+/// Writes are *not* visible until the next `flush()`, and no ordering is guaranteed
+/// between writes to the same element issued from different cores.
+///
+/// @code
+///   auto wc = WriteCombiner<int64_t>::create();
+///   forall(src, n, [=](int64_t i, int64_t& d){ wc->write(dst+perm(i), d); });
+///   wc->flush();
+///   wc->destroy();
+/// @endcode
+template< typename T, GlobalCompletionEvent * C = &impl::write_combiner_gce >
+class WriteCombiner {
+public:
+  struct Entry {
+    GlobalAddress<T> addr;
+    T val;
+  };
+  
+  /// Header of a run of consecutive elements in a flush payload; followed by `count` values.
+  struct Run {
+    GlobalAddress<T> start;
+    int64_t count;
+  };
+  
+  /// Number of buffered writes per destination, chosen so that even a payload with no
+  /// coalescing at all fits in a single message.
+  static const size_t capacity = (MAX_MESSAGE_SIZE / (sizeof(Run)+sizeof(T)) > 0)
+                                 ? MAX_MESSAGE_SIZE / (sizeof(Run)+sizeof(T)) : 1;
+  
+protected:
+  GlobalAddress<WriteCombiner> self;
+  Entry ** bins;
+  size_t * counts;
+  
+  /// Position of an element within the destination core's memory, so that sorting
+  /// by key puts elements that are contiguous at the destination next to each other.
+  static std::pair<bool,intptr_t> local_key(GlobalAddress<T> a) {
+    if (a.is_2D()) {
+      return std::make_pair(true, reinterpret_cast<intptr_t>(a.pointer()));
+    } else {
+      intptr_t raw = a.raw_bits();
+      return std::make_pair(false, (raw / block_size) / cores() * block_size
+                                   + raw % block_size);
+    }
+  }
+  
+  /// Sort, dedup and coalesce one bin into a payload, then send it.
+  void flush_bin(Core dest) {
+    size_t n = counts[dest];
+    if (n == 0) return;
+    
+    // detach entries before anything that could yield
+    std::vector<Entry> es(bins[dest], bins[dest]+n);
+    counts[dest] = 0;
+    
+    std::stable_sort(es.begin(), es.end(), [](const Entry& a, const Entry& b){
+      return local_key(a.addr) < local_key(b.addr);
+    });
+    
+    auto buf = locale_alloc<char>(n * (sizeof(Run)+sizeof(T)));
+    char * p = buf;
+    Run * run = nullptr;
+    std::pair<bool,intptr_t> prev;
+    
+    for (size_t i = 0; i < n; i++) {
+      auto k = local_key(es[i].addr);
+      if (run && k == prev) {
+        // later write to the same element wins
+        std::memcpy(p - sizeof(T), &es[i].val, sizeof(T));
+        write_combiner_overwritten++;
+        continue;
+      }
+      if (!run || k.first != prev.first || k.second != prev.second + (intptr_t)sizeof(T)) {
+        run = reinterpret_cast<Run*>(p);
+        run->start = es[i].addr;
+        run->count = 0;
+        p += sizeof(Run);
+        write_combiner_runs++;
+      }
+      std::memcpy(p, &es[i].val, sizeof(T));
+      p += sizeof(T);
+      run->count++;
+      prev = k;
+    }
+    
+    size_t sz = p - buf;
+    DCHECK_LE(sz, MAX_MESSAGE_SIZE);
+    
+    write_combiner_msgs++;
+    C->enroll();
+    Core origin = mycore();
+    send_heap_message(dest, [origin,buf](void * payload, size_t payload_size){
+      char * q = static_cast<char*>(payload);
+      char * end = q + payload_size;
+      while (q < end) {
+        Run r;
+        std::memcpy(&r, q, sizeof(Run));
+        q += sizeof(Run);
+        std::memcpy(r.start.pointer(), q, r.count * sizeof(T));
+        q += r.count * sizeof(T);
+      }
+      send_heap_message(origin, [buf]{
+        locale_free(buf);
+        C->complete();
+      });
+    }, buf, sz);
+  }
+  
+  /// Send all of this core's buffered writes.
+  void flush_local() {
+    for (Core c = 0; c < cores(); c++) flush_bin(c);
+  }
+  
+public:
+  WriteCombiner(): bins(nullptr), counts(nullptr) {}
+  WriteCombiner(GlobalAddress<WriteCombiner> self)
+    : self(self)
+    , bins(new Entry*[cores()])
+    , counts(new size_t[cores()])
+  {
+    for (Core c = 0; c < cores(); c++) { bins[c] = nullptr; counts[c] = 0; }
+  }
+  
+  ~WriteCombiner() {
+    if (bins) {
+      for (Core c = 0; c < cores(); c++) {
+        CHECK_EQ(counts[c], 0) << "WriteCombiner destroyed with unflushed writes";
+        if (bins[c]) delete[] bins[c];
+      }
+      delete[] bins;
+      delete[] counts;
+    }
+  }
+  
+  static GlobalAddress<WriteCombiner> create() {
+    auto self = symmetric_global_alloc<WriteCombiner>();
+    call_on_all_cores([self]{
+      new (self.localize()) WriteCombiner(self);
+    });
+    return self;
+  }
+  
+  void destroy() {
+    auto self = this->self;
+    call_on_all_cores([self]{ self->~WriteCombiner(); });
+    global_free(self);
+  }
+  
+  /// Buffer a write of `val` to `addr`. Local writes happen immediately; remote writes
+  /// happen at the latest on the next `flush()`. May block if the destination's buffer
+  /// is full and must be sent.
+  ///
+  /// @warning Target element must lie on a single core (not span blocks).
+  void write(GlobalAddress<T> addr, const T& val) {
+    write_combiner_writes++;
+    Core dest = addr.core();
+    if (dest == mycore()) {
+      write_combiner_local_writes++;
+      *addr.pointer() = val;
+      return;
+    }
+    
+    if (bins[dest] == nullptr) bins[dest] = new Entry[capacity];
+    auto& e = bins[dest][counts[dest]++];
+    e.addr = addr;
+    e.val = val;
+    
+    if (counts[dest] == capacity) flush_bin(dest);
+  }
+  
+  /// Number of writes currently buffered on this core.
+  size_t local_pending() const {
+    size_t n = 0;
+    for (Core c = 0; c < cores(); c++) n += counts[c];
+    return n;
+  }
+  
+  /// Send buffered writes from all cores and block until they have all been applied.
+  /// Must be called from a single task (not SPMD); must not be called while the same
+  /// GCE is being used by an outstanding loop.
+  void flush() {
+    auto self = this->self;
+    on_all_cores([self]{
+      self->flush_local();
+      C->wait();
+    });
+  }
+  
+} GRAPPA_BLOCK_ALIGNED;
+
+/// @}
+
+} // namespace Grappa
@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////
+// This file is part of Grappa, a system for scaling irregular
+// applications on commodity clusters. 
+
+// Copyright (C) 2010-2014 University of Washington and Battelle
+// Memorial Institute. University of Washington authorizes use of this
+// Grappa software.
+
+// Grappa is free software: you can redistribute it and/or modify it
+// under the terms of the Affero General Public License as published
+// by Affero, Inc., either version 1 of the License, or (at your
+// option) any later version.
+
+// Grappa is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// Affero General Public License for more details.
+
+// You should have received a copy of the Affero General Public
+// License along with this program. If not, you may obtain one from
+// http://www.affero.org/oagpl.html.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "WriteCombiner.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( WriteCombiner_tests );
+
+DEFINE_int64(nelems, (1L<<14) - 21, "number of elements in test arrays");
+
+struct Pair {
+  int64_t a, b;
+};
+
+/// Scatter with a stride permutation so almost every write is remote.
+void test_scatter() {
+  int64_t N = FLAGS_nelems;
+  auto src = global_alloc<int64_t>(N);
+  auto dst = global_alloc<int64_t>(N);
+  forall(src, N, [](int64_t i, int64_t& e){ e = i; });
+  Grappa::memset(dst, -1, N);
+  
+  auto wc = WriteCombiner<int64_t>::create();
+  forall(src, N, [=](int64_t i, int64_t& e){
+    wc->write(dst + (N-1-i), e);
+  });
+  wc->flush();
+  
+  forall(dst, N, [=](int64_t i, int64_t& e){
+    BOOST_CHECK_EQUAL(e, N-1-i);
+  });
+  wc->destroy();
+  global_free(src);
+  global_free(dst);
+}
+
+/// Repeated writes to the same elements from one task: last write wins.
+void test_overwrite() {
+  int64_t N = 100;
+  auto dst = global_alloc<Pair>(N);
+  auto wc = WriteCombiner<Pair>::create();
+  
+  for (int64_t r = 0; r < 3; r++) {
+    for (int64_t i = 0; i < N; i++) wc->write(dst+i, Pair{i, r});
+  }
+  wc->flush();
+  
+  forall(dst, N, [](int64_t i, Pair& p){
+    BOOST_CHECK_EQUAL(p.a, i);
+    BOOST_CHECK_EQUAL(p.b, 2);
+  });
+  wc->destroy();
+  global_free(dst);
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    test_scatter();
+    test_overwrite();
+    Metrics::merge_and_print();
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
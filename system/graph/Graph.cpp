@@ -23,3 +23,17 @@
 
 #include "Graph.hpp"
 
+DEFINE_bool(graph_bulk_create, true, "Build Graph adjacencies by shuffling edges in bulk and counting-sorting them locally (otherwise a delegate per edge endpoint)");
+DEFINE_string(graph_partition, "cyclic", "Vertex placement for Graph::create(): cyclic (by id), block (edge-balanced ranges of ids), degree (degree-sorted round-robin) or hash");
+DEFINE_string(graph_order, "none", "Vertex numbering for Graph::create(), for locality: none (as in the input), degree (descending), rcm (reverse Cuthill-McKee) or hub (above-average degree first)");
+DEFINE_int64(graph_split_degree, 0, "Vertex-cut: vertices with more edges than this keep their edges to other cores on mirrors there (0: off)");
+DEFINE_bool(graph_compress_adj, false, "Store Graph adjacency lists as varint-encoded deltas (about 2-3 bytes per edge instead of 8)");
+DEFINE_double(graph_update_slack, 0.25, "Spare room per vertex (fraction of its edges) left when Graph::commit() compacts a core's edges after updates");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_edge_imbalance, 1.0);
+
+namespace Grappa {
+  namespace impl {
+    Empty EdgeRecord<Empty>::data;
+  }
+}
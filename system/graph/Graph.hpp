@@ -31,10 +31,27 @@
 #include <Delegate.hpp>
 #include <AsyncDelegate.hpp>
 #include <Array.hpp>
+#include <Metrics.hpp>
+#include <GlobalHashCommon.hpp>
+#include <FileIO.hpp>
 #include "TupleGraph.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <iomanip>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+DECLARE_bool(graph_bulk_create);
+DECLARE_string(graph_partition);
+DECLARE_string(graph_order);
+DECLARE_int64(graph_split_degree);
+DECLARE_bool(graph_compress_adj);
+DECLARE_double(graph_update_slack);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_edge_imbalance);
 
 // #define USE_MPI3_COLLECTIVES
 #undef USE_MPI3_COLLECTIVES
@@ -52,21 +69,61 @@ namespace Grappa {
   /// Empty struct, for specifying lack of either Vertex or Edge data in @ref Graph.
   struct Empty {};
   
+  /// Policies for combining the payloads of duplicate edges when a Graph is
+  /// created from a TupleGraph with edge payloads (see Graph::create()).
+  /// Each is called as `combine(kept, dup)` and should fold `dup` into `kept`.
+  struct EdgeCombine {
+    /// Keep the payload of one of the duplicates (which one is unspecified).
+    struct First { template< typename P > void operator()(P& kept, const P& dup) const {} };
+    struct Min { template< typename P > void operator()(P& kept, const P& dup) const { if (dup < kept) kept = dup; } };
+    struct Max { template< typename P > void operator()(P& kept, const P& dup) const { if (kept < dup) kept = dup; } };
+    struct Sum { template< typename P > void operator()(P& kept, const P& dup) const { kept += dup; } };
+  };
+  
   namespace impl {
     
+    /// Edge as shipped by Graph::build_bulk(), with the payload imported from the TupleGraph.
+    template< typename P >
+    struct EdgeRecord {
+      int64_t v0, v1;
+      P data;
+    };
+    
+    /// No payload: don't pay for one in the shuffle.
+    template<>
+    struct EdgeRecord<Empty> {
+      int64_t v0, v1;
+      static Empty data;
+    };
+    
+    template< typename P >
+    inline P edge_payload(const TupleGraph& tg, TupleGraph::Edge& e) { return tg.payload<P>(e); }
+    
+    template<>
+    inline Empty edge_payload<Empty>(const TupleGraph& tg, TupleGraph::Edge& e) { return Empty(); }
+    
+    template< typename E, typename P >
+    inline void init_edge_state(E * e, const P& p) { new (e) E{p}; }
+    
+    /// (never called; keeps build_bulk<Empty> compiling for edge types not constructible from Empty)
+    template< typename E >
+    inline void init_edge_state(E * e, const Empty& p) { new (e) E(); }
+    
     struct VertexBase {
       bool valid; // vertices with no connections (in/out) are marked invalid TODO: eliminate these from the representation entirely
+      bool split; // vertex-cut: a master whose edges are partly held by mirrors, or a mirror
       VertexID * local_adj; // adjacencies that are local
       int64_t nadj;        // number of adjacencies
       int64_t local_sz;    // size of local allocation (regardless of how full it is)
       
-      VertexBase(): valid(true), local_adj(nullptr), nadj(0), local_sz(0) {}
+      VertexBase(): valid(true), split(false), local_adj(nullptr), nadj(0), local_sz(0) {}
       
       VertexBase(const VertexBase& v):
         local_adj(v.local_adj),
         nadj(v.nadj),
         local_sz(v.local_sz),
-        valid(true)
+        valid(true),
+        split(v.split)
       { }
     };
     
@@ -125,7 +182,306 @@ namespace Grappa {
       static constexpr size_t size() { return locale_heap_size() + global_heap_size(); }
       
     } GRAPPA_BLOCK_ALIGNED;
-  
+    
+    /// Compressed adjacency lists are split into blocks of this many neighbors; each
+    /// block starts with an absolute id (the rest are deltas), so any neighbor can be
+    /// found by decoding at most one block.
+    constexpr int64_t cadj_block = 32;
+    
+    /// Append `x` as a varint (7 bits per byte, low bits first).
+    inline void put_varint(std::vector<uint8_t>& out, uint64_t x) {
+      while (x >= 0x80) { out.push_back(static_cast<uint8_t>(x) | 0x80); x >>= 7; }
+      out.push_back(static_cast<uint8_t>(x));
+    }
+    
+    /// Decode a varint at `p` into `x`, returning the byte after it.
+    inline const uint8_t * get_varint(const uint8_t * p, uint64_t& x) {
+      uint64_t b = *p++;
+      x = b & 0x7f;
+      for (int shift = 7; b & 0x80; shift += 7) {
+        b = *p++;
+        x |= (b & 0x7f) << shift;
+      }
+      return p;
+    }
+    
+    /// Registration of a mirror with its master, while building a vertex-cut.
+    struct MirrorReg { VertexID id; Core core; int64_t index; int64_t nadj; };
+    
+    /// Location of a mirror: index into Graph::mirrors on `core`.
+    struct MirrorRef { Core core; int64_t index; };
+    
+    /// Per-core record of a local split vertex: its total degree and its
+    /// mirrors (Graph::mirror_refs[first_ref, first_ref+nrefs)).
+    struct SplitMaster { VertexID id; int64_t degree; int64_t first_ref, nrefs; };
+    
+    /// Vertex layout chosen by Graph::place() for --graph_partition
+    /// (or, without `vs`, the numbering chosen by Graph::order() for --graph_order).
+    template< typename Vertex >
+    struct Placement {
+      GlobalAddress<Vertex> vs;          ///< vertex slots
+      int64_t nv;                        ///< number of slots (including padding)
+      GlobalAddress<VertexID> orig_ids;  ///< internal id -> original id (-1 for padding)
+      GlobalAddress<VertexID> new_ids;   ///< original id -> internal id
+    };
+    
+    /// Number of edges each vertex will store (before de-dup), indexed by vertex id.
+    inline GlobalAddress<int64_t> tuple_degrees(const TupleGraph& tg, bool directed, int64_t nv) {
+      auto deg = global_alloc<int64_t>(nv);
+      Grappa::memset(deg, 0, nv);
+      forall(tg.edges, tg.nedge, [deg,directed](TupleGraph::Edge& e){
+        delegate::increment<SyncMode::Async>(deg+e.v0, 1);
+        if (!directed) delegate::increment<SyncMode::Async>(deg+e.v1, 1);
+      });
+      return deg;
+    }
+    
+    /// Sort key of a vertex for Graph::order(): by `k0`, then `k1`, then id.
+    struct OrderRec {
+      int64_t k0, k1;
+      VertexID id;
+      bool operator<(const OrderRec& o) const {
+        return std::tie(k0, k1, id) < std::tie(o.k0, o.k1, o.id);
+      }
+    };
+    
+    /// Per-vertex state of the Cuthill-McKee traversal in Graph::order().
+    struct OrderState {
+      int64_t level;   ///< BFS level (-1 until reached)
+      int64_t parent;  ///< least rank of a neighbor in the previous level
+      int64_t rank;    ///< position in the ordering (once its level is numbered)
+      int64_t deg;
+    };
+    
+    /// All-to-all exchange of records, used to build graphs in bulk.
+    /// 
+    /// Each core stages records for other cores with `push()` (purely local), then
+    /// `exchange()` ships them in message-sized batches so that each core ends up with
+    /// the records sent to it in `received`.
+    template< typename T >
+    struct Shuffle {
+      static const size_t max_in_flight = 16; ///< chunks each core may have unacked
+      
+      GlobalAddress<Shuffle> self;
+      std::vector<std::vector<T>> outgoing; ///< staged records, per destination core
+      std::vector<T> received;
+      
+      Shuffle(GlobalAddress<Shuffle> self): self(self), outgoing(cores()) {}
+      
+      static GlobalAddress<Shuffle> create() {
+        auto self = symmetric_global_alloc<Shuffle>();
+        call_on_all_cores([self]{ new (self.localize()) Shuffle(self); });
+        return self;
+      }
+      
+      void destroy() {
+        auto self = this->self;
+        call_on_all_cores([self]{ self->~Shuffle(); });
+        global_free(self);
+      }
+      
+      void push(Core dest, const T& t) { outgoing[dest].push_back(t); }
+      
+      /// Send all staged records (collective, call from one task).
+      ///
+      /// Payloads must live in locale shared memory, so each core stages its chunks in a
+      /// small pool of buffers, reused as the receivers ack them, rather than copying all
+      /// of `outgoing` there at once.
+      void exchange() {
+        auto self = this->self;
+        on_all_cores([self]{
+          auto s = self.localize();
+          size_t per_msg = MAX_MESSAGE_SIZE / sizeof(T);
+          size_t nmsg = 0;
+          for (Core c = 0; c < cores(); c++) {
+            if (c != mycore()) nmsg += (s->outgoing[c].size() + per_msg - 1) / per_msg;
+          }
+          CompletionEvent ce(nmsg);
+          ConditionVariable freed;
+          std::vector<T*> bufs;
+          size_t nbufs = (nmsg < max_in_flight) ? nmsg : max_in_flight;
+          for (size_t i = 0; i < nbufs; i++) {
+            bufs.push_back(locale_alloc<T>(per_msg));
+          }
+          auto pce = &ce;
+          auto pfreed = &freed;
+          auto pbufs = &bufs;
+          Core origin = mycore();
+          
+          for (Core c = 0; c < cores(); c++) {
+            auto& out = s->outgoing[c];
+            if (c == mycore()) {
+              s->received.insert(s->received.end(), out.begin(), out.end());
+              continue;
+            }
+            for (size_t k = 0; k < out.size(); k += per_msg) {
+              size_t n = std::min(per_msg, out.size()-k);
+              while (bufs.empty()) Grappa::wait(&freed);
+              auto buf = bufs.back();
+              bufs.pop_back();
+              std::memcpy(buf, &out[k], n*sizeof(T));
+              send_heap_message(c, [self,origin,pce,pfreed,pbufs,buf](void * payload, size_t sz){
+                auto r = static_cast<T*>(payload);
+                auto& recv = self->received;
+                recv.insert(recv.end(), r, r + sz/sizeof(T));
+                send_heap_message(origin, [pce,pfreed,pbufs,buf]{
+                  pbufs->push_back(buf);
+                  Grappa::signal(pfreed);
+                  pce->complete();
+                });
+              }, buf, n*sizeof(T));
+            }
+          }
+          ce.wait();
+          for (auto buf : bufs) locale_free(buf);
+          for (auto& out : s->outgoing) std::vector<T>().swap(out);
+        });
+      }
+    } GRAPPA_BLOCK_ALIGNED;
+    
+    template< typename T >
+    int64_t received_count(GlobalAddress<Shuffle<T>> s) { return s->received.size(); }
+    
+    /// Header of a Graph::save() snapshot, in `<path>/graph.meta`.
+    /// 
+    /// The rest of the snapshot is one file per core, `<path>/part.<p>`, holding the
+    /// vertices with `id % cores == p` in id order (which is how Graph's vertex array
+    /// is distributed), as host-endian binary:
+    /// 
+    ///     int64_t  nlocal, nadj_local
+    ///     int64_t  nadj[nlocal]
+    ///     uint8_t  valid[nlocal]
+    ///     V        data[nlocal]
+    ///     VertexID orig_id[nlocal]      (only if `relabeled`)
+    ///     VertexID adj[nadj_local]      (each vertex's sorted neighbors, in turn)
+    ///     E        edge_data[nadj_local]
+    struct GraphFileHeader {
+      uint64_t magic;     ///< graph_file_magic
+      int64_t version;
+      int64_t cores;      ///< number of part files
+      int64_t nv, nadj;
+      int64_t orig_nv;    ///< number of ids in the input (if relabeled)
+      int64_t vertex_data_size, edge_data_size;
+      bool directed, relabeled, in_edges;
+    };
+    constexpr uint64_t graph_file_magic = 0x4850415247505247; // "GRPGRAPH"
+    
+    inline std::string graph_part_path(const char * dir, int64_t p) {
+      return std::string(dir) + "/part." + std::to_string(p);
+    }
+    
+    /// Longest snapshot directory name whose part files' names still fit in a File.
+    constexpr size_t graph_path_max = FNAME_LENGTH - sizeof("/part.18446744073709551615");
+    
+    /// One file of a snapshot, read or written sequentially through FileIO's async IO
+    /// (so only the calling task blocks).
+    struct SnapshotFile {
+      FileDesc fd;
+      size_t offset;
+      
+      SnapshotFile(const std::string& fname, const char * mode)
+        : fd(file_open(fname.c_str(), mode)), offset(0) {}
+      ~SnapshotFile() { file_close(fd); }
+      
+      void read(void * buf, size_t nbytes) {
+        auto p = static_cast<char*>(buf);
+        while (nbytes > 0) {
+          auto n = fread_blocking(p, nbytes, offset, fd);
+          CHECK_GT(n, 0) << "Graph snapshot truncated";
+          p += n; offset += n; nbytes -= n;
+        }
+      }
+      
+      void write(const void * buf, size_t nbytes) {
+        auto p = static_cast<const char*>(buf);
+        while (nbytes > 0) {
+          auto n = fwrite_blocking(p, nbytes, offset, fd);
+          CHECK_GT(n, 0) << "error writing Graph snapshot";
+          p += n; offset += n; nbytes -= n;
+        }
+      }
+    };
+    
+    /// A saved vertex on its way to its new core, when loading on a different number of cores.
+    template< typename V >
+    struct SavedVertex { VertexID id, orig; int64_t nadj; bool valid; V data; };
+    
+    template< typename E >
+    struct SavedEdge { VertexID src, dst; E data; };
+    
+    /// A staged edge insertion or deletion, on the core of its source (see Graph::commit()).
+    struct EdgeUpdate {
+      VertexID src, dst;
+      int64_t seq;    ///< which batch it came from (later batches win)
+      bool insert;
+    };
+    
+    /// Adjacency storage allocated by Graph::commit() for a vertex that outgrew its
+    /// slot in adj_buf (all `cap` edge states are constructed).
+    template< typename E >
+    struct AdjBlock { VertexID * adj; E * edges; int64_t cap; };
+    
+    template< typename G >
+    int64_t local_nadj(GlobalAddress<G> g) { return g->nadj_local; }
+    
+    /// Globally sort the records each core has staged in `s->received` (sample sort),
+    /// and number them `base`, `base+1`, ... in that order: record i's vertex gets
+    /// `new_ids[id] = base+i` and `orig_ids[base+i] = id`. Returns the number of records;
+    /// leaves `s` empty for reuse. (Collective, call from one task.)
+    inline int64_t rank_sorted(GlobalAddress<Shuffle<OrderRec>> s, int64_t base,
+                               GlobalAddress<VertexID> new_ids, GlobalAddress<VertexID> orig_ids) {
+      on_all_cores([s]{
+        // splitters from evenly-spaced samples of each core's sorted records
+        const int64_t per_core = 16;
+        auto& recs = s->received;
+        std::sort(recs.begin(), recs.end());
+        int64_t n = recs.size(), ns = std::min(n, per_core);
+        std::vector<int64_t> samples(3*per_core*cores(), 0);
+        for (int64_t k = 0; k < ns; k++) {
+          auto& r = recs[k*n/ns];
+          auto x = &samples[3*(mycore()*per_core + k)];
+          x[0] = r.k0; x[1] = r.k1; x[2] = r.id+1; // (0 marks an empty sample)
+        }
+        allreduce_inplace<int64_t,collective_add>(samples.data(), samples.size());
+        
+        std::vector<OrderRec> all;
+        for (size_t k = 0; k < samples.size(); k += 3) {
+          if (samples[k+2] > 0) all.push_back(OrderRec{ samples[k], samples[k+1], samples[k+2]-1 });
+        }
+        std::sort(all.begin(), all.end());
+        std::vector<OrderRec> splitters;
+        if (!all.empty()) {
+          for (Core c = 1; c < cores(); c++) splitters.push_back(all[c*all.size()/cores()]);
+        }
+        
+        std::vector<OrderRec> mine;
+        mine.swap(recs);
+        for (auto& r : mine) {
+          s->push(std::upper_bound(splitters.begin(), splitters.end(), r) - splitters.begin(), r);
+        }
+      });
+      s->exchange();
+      
+      int64_t total = reduce<int64_t,Shuffle<OrderRec>,collective_add,
+                             &received_count<OrderRec>>(s);
+      on_all_cores([s,base,new_ids,orig_ids]{
+        auto& recs = s->received;
+        std::sort(recs.begin(), recs.end());
+        std::vector<int64_t> counts(cores(), 0);
+        counts[mycore()] = recs.size();
+        allreduce_inplace<int64_t,collective_add>(counts.data(), counts.size());
+        int64_t offset = base;
+        for (Core c = 0; c < mycore(); c++) offset += counts[c];
+        
+        Grappa::forall_here(0, recs.size(), [offset,new_ids,orig_ids,&recs](int64_t j){
+          delegate::write(new_ids+recs[j].id, offset+j);
+          delegate::write(orig_ids+offset+j, recs[j].id);
+        });
+        std::vector<OrderRec>().swap(recs);
+      });
+      return total;
+    }
+    
   }
   
   /// Distributed graph data structure, with customizable vertex and edge data.
@@ -174,9 +530,45 @@ namespace Grappa {
   /// 
   /// Vertices are randomly distributed among cores (using a simple global
   /// heap allocation). Edges are placed on the core of their *source* vertex.
-  /// Therefore, iterating over outgoing edges is very efficient, but a 
-  /// vertex's incoming edges must be found the hard way (in practice, 
-  /// we just avoid doing it entirely if using this graph structure).
+  /// On skewed graphs, `--graph_partition` can instead place vertices to
+  /// balance edges across cores: `block` (contiguous ranges of ids with
+  /// about equal edge counts), `degree` (degree-sorted round-robin) or `hash`.
+  /// These renumber vertices internally (Graph::vertex_id() and
+  /// Graph::original_id() translate), and may add a few invalid padding
+  /// vertices. The resulting imbalance (most edges on a core over the mean)
+  /// is reported in the `graph_edge_imbalance` metric.
+  /// 
+  /// Independently, `--graph_order` renumbers vertices so that neighbors tend to have
+  /// nearby ids (and so, with `block` placement, share a core): `degree` (descending
+  /// degree), `rcm` (reverse Cuthill-McKee; a pass over the edges per BFS level, so
+  /// best on low-diameter graphs) or `hub` (vertices of above-average degree first,
+  /// by degree, then the rest in their original order). The same two calls translate ids.
+  /// 
+  /// A single hub can still hold more edges than a whole core should. With
+  /// `--graph_split_degree=N`, each vertex with more than N edges becomes a
+  /// *vertex-cut*: its edges to vertices on other cores are kept by *mirrors*
+  /// on those cores, next to their destinations. Iteration over vertices
+  /// sees only masters; iteration over edges covers mirrors' edges too,
+  /// running at the mirror (a Vertex copy whose data is refreshed by
+  /// Graph::broadcast_to_mirrors(), and whose updates are folded back with
+  /// Graph::gather_to_masters()). For a split vertex, `forall(adj(g,v), ...)`
+  /// also runs the body at each of its mirrors, on the mirror's edges (so the body
+  /// must not refer to memory on the master's core, and `i` indexes the adjacency
+  /// of whichever copy holds the edge); `v.nadj` counts only the master's own
+  /// edges, and Graph::degree() gives the total.
+  /// 
+  /// Edges can be added and removed after construction, in batches: see
+  /// Graph::insert_edges(), Graph::delete_edges() and Graph::commit().
+  /// 
+  /// With `--graph_compress_adj` (or Graph::compress_adj()), each core stores its
+  /// sorted adjacency lists as varint-encoded deltas instead of 64-bit ids, and
+  /// `v.local_adj` is null: use the adj() iterators, Graph::neighbor() or
+  /// Graph::for_neighbors() to read them.
+  /// Therefore, iterating over outgoing edges is very efficient. For pull-style
+  /// algorithms, directed graphs can also carry an index of incoming edges
+  /// (see Graph::build_in_edges()), stored on the core of the *destination*
+  /// vertex and iterated with `forall(in_adj(g,v), ...)`; in an undirected
+  /// graph, incoming edges are simply the outgoing ones.
   /// 
   /// Parallel Iterators
   /// -------------------
@@ -227,12 +619,14 @@ namespace Grappa {
   ///   // - or a VertexID: adj(g, v.id)
   ///   
   ///   // `forall` has various specializations for `adj`, including:
-  ///   forall<async>(adj(g,v), [&v](Edge& e){
-  ///     LOG(INFO) << v.id << " -> " << e.id;
+  ///   // (capture by value: for split vertices the body also runs at mirrors)
+  ///   auto i = g->id(v);
+  ///   forall<async>(adj(g,v), [i](Edge& e){
+  ///     LOG(INFO) << i << " -> " << e.id;
   ///   });
   ///   // or this form, which provides the index within the adj list [0,v.nadj)
-  ///   forall<async>(adj(g,v), [&v](int64_t ei, Edge& e){
-  ///     LOG(INFO) << "v.adj[" << ei << "] = " << e.id;
+  ///   forall<async>(adj(g,v), [i](int64_t ei, Edge& e){
+  ///     LOG(INFO) << "adj[" << ei << "] = " << e.id;
   ///   });
   /// 
   /// });
@@ -268,6 +662,47 @@ namespace Grappa {
     // Internal fields
     VertexID * adj_buf;
     EdgeState * edge_storage;
+    bool directed;
+    
+    // Incoming-edge index (directed graphs, after build_in_edges()):
+    // sources of the in-edges of the i'th local vertex are
+    // in_adj_buf[in_offset[i]] .. in_adj_buf[in_offset[i+1]]
+    int64_t * in_offset;
+    VertexID * in_adj_buf;
+    
+    // Vertex renumbering (if --graph_partition isn't 'cyclic' or --graph_order is set)
+    bool relabeled;
+    int64_t orig_nv;  // number of ids in the input TupleGraph (the domain of vertex_id())
+    GlobalAddress<VertexID> orig_ids;
+    GlobalAddress<VertexID> new_ids;
+    TupleGraph::Edge * saved_tuples; // original ids of local TupleGraph edges, during create()
+    
+    // Vertex-cut (if --graph_split_degree): local mirrors of split vertices,
+    // with their masters' ids, and records of local split masters (by id)
+    Vertex * mirrors;
+    VertexID * mirror_ids;
+    int64_t nmirrors_local;
+    int64_t nsplit;
+    std::vector<impl::SplitMaster> splits;
+    std::vector<impl::MirrorRef> mirror_refs;
+    
+    // Dynamic updates: staged updates to local vertices' edges (applied by commit()),
+    // batches staged so far, edge states constructed in edge_storage (may exceed
+    // nadj_local after compaction leaves slack), and storage for vertices that
+    // outgrew their slots (freed by compaction)
+    std::vector<impl::EdgeUpdate> pending;
+    int64_t update_seq;
+    int64_t edge_slots_local;
+    std::vector<impl::AdjBlock<E>> overflow;
+    int64_t overflow_edges;
+    
+    // Compressed adjacency (after compress_adj()): byte offset into cadj of each
+    // block of impl::cadj_block neighbors, and the first block of each local
+    // vertex (vertices in vs, then mirrors)
+    uint8_t * cadj;
+    int64_t * cadj_blocks;
+    int64_t * cadj_first_block;
+    int64_t cadj_bytes; // total, all cores
     
     // Temporary internal state
     void* scratch;
@@ -281,22 +716,59 @@ namespace Grappa {
       , nadj(0)
       , nadj_local(0)
       , adj_buf(nullptr)
+      , edge_storage(nullptr)
+      , directed(false)
+      , in_offset(nullptr)
+      , in_adj_buf(nullptr)
+      , relabeled(false)
+      , orig_nv(nv)
+      , orig_ids()
+      , new_ids()
+      , saved_tuples(nullptr)
+      , mirrors(nullptr)
+      , mirror_ids(nullptr)
+      , nmirrors_local(0)
+      , nsplit(0)
+      , update_seq(0)
+      , edge_slots_local(0)
+      , overflow_edges(0)
+      , cadj(nullptr)
+      , cadj_blocks(nullptr)
+      , cadj_first_block(nullptr)
+      , cadj_bytes(0)
       , scratch(nullptr)
     { }
   
     ~Graph() {
       for (Vertex& v : iterate_local(vs, nv)) { v.~Vertex(); }
       if (edge_storage) {
-        for (int64_t i=0; i<nadj_local; i++) {
+        for (int64_t i=0; i<edge_slots_local; i++) {
           edge_storage[i].~E();
         }
         locale_free(edge_storage);
       }
+      free_overflow();
       if (adj_buf) locale_free(adj_buf);
+      if (in_offset) locale_free(in_offset);
+      if (in_adj_buf) locale_free(in_adj_buf);
+      if (mirrors) {
+        for (int64_t k=0; k<nmirrors_local; k++) mirrors[k].~Vertex();
+        locale_free(mirrors);
+        locale_free(mirror_ids);
+      }
+      if (cadj) {
+        locale_free(cadj);
+        locale_free(cadj_blocks);
+        locale_free(cadj_first_block);
+      }
     }
   
     void destroy() {
       auto self = this->self;
+      if (relabeled) {
+        global_free(orig_ids);
+        global_free(new_ids);
+      }
       global_free(this->vs);
       call_on_all_cores([self]{ self->~Graph(); });
       global_free(self);
@@ -305,10 +777,10 @@ namespace Grappa {
     template< int LEVEL = 0 >
     static void dump(GlobalAddress<Graph> g) {
       for (int64_t i=0; i<g->nv; i++) {
-        delegate::call(g->vs+i, [i](Vertex& v){
+        delegate::call(g->vs+i, [g,i](Vertex& v){
           std::stringstream ss;
           ss << "<" << i << ">";
-          for (int64_t i=0; i<v.nadj; i++) ss << " " << v.local_adj[i];
+          g->for_neighbors(v, 0, v.nadj, [&ss](int64_t k, VertexID j){ ss << " " << j; });
           VLOG(LEVEL) << ss.str();
         });
       }
@@ -317,11 +789,12 @@ namespace Grappa {
     template< int LEVEL = 0, typename F = nullptr_t >
     void dump(F print_vertex) {
       for (int64_t i=0; i<nv; i++) {
-        delegate::call(vs+i, [i,print_vertex](Vertex& v){
+        auto g = self;
+        delegate::call(vs+i, [g,i,print_vertex](Vertex& v){
           std::stringstream ss;
           ss << "<" << std::setw(2) << i << ">";
           print_vertex(ss, v);
-          for (int64_t i=0; i<v.nadj; i++) ss << " " << v.local_adj[i];
+          g->for_neighbors(v, 0, v.nadj, [&ss](int64_t k, VertexID j){ ss << " " << j; });
           if (VLOG_IS_ON(LEVEL)) std::cerr << ss.str() << "\n";
         });
       }
@@ -343,7 +816,7 @@ namespace Grappa {
     /// @endcode
     template< typename VV, typename F = decltype(nullptr) >
     GlobalAddress<Graph<VV,E>> transform(F f) {
-      forall(vs, nv, [f](Vertex& v){
+      auto convert = [f](Vertex& v){
         VV d;
         f(v, d);
         v.~Vertex();
@@ -351,22 +824,278 @@ namespace Grappa {
         auto vv = new (&v) typename Graph<VV,E>::Vertex(b);
         vv->data = d;
         vv->local_edge_state = b.local_edge_state;
-      });
+      };
+      forall(vs, nv, convert);
+      if (nsplit > 0) {
+        auto g = self;
+        on_all_cores([g,convert]{
+          for (int64_t k=0; k<g->nmirrors_local; k++) convert(g->mirrors[k]);
+        });
+      }
       return static_cast<GlobalAddress<Graph<VV,E>>>(self);
     }
     
     // Constructor
-    static GlobalAddress<Graph> create(const TupleGraph& tg, bool directed = false, bool solo_invalid = true);
+    static GlobalAddress<Graph> create(const TupleGraph& tg, bool directed = false,
+                                       bool solo_invalid = true, bool in_edges = false);
+    
+    /// Construct a Graph whose edge data is initialized from the TupleGraph's edge
+    /// payloads (which must be of type P), as `EdgeState{p}`. Payloads of duplicate
+    /// edges (including both directions of an undirected edge given twice) are
+    /// merged with `combine` (see EdgeCombine).
+    ///
+    /// @code
+    /// struct EdgeData { double weight; EdgeData(double w = 1.0): weight(w) {} };
+    /// auto tg = TupleGraph::Load("weighted.tsv", "tsv");
+    /// auto g = Graph<Empty,EdgeData>::create<double>(tg, EdgeCombine::Min());
+    /// @endcode
+    template< typename P, typename Combine = EdgeCombine::First >
+    static GlobalAddress<Graph> create(const TupleGraph& tg, Combine combine = Combine(),
+                                       bool directed = false, bool solo_invalid = true);
+    
+    /// Allocate the Graph proxies and vertices for create(). If vertices are placed
+    /// by --graph_partition, `tg` is relabeled (in place) with the internal ids.
+    static GlobalAddress<Graph> alloc(const TupleGraph& tg, bool directed);
+    
+    /// Choose vertex slots for the --graph_partition strategy (for alloc()).
+    static impl::Placement<Vertex> place(const TupleGraph& tg, bool directed, int64_t nv);
+    
+    /// Number the vertices of `tg` by the --graph_order strategy (for alloc()).
+    /// The result has no `vs`; it's a permutation of [0,nv) and its inverse.
+    static impl::Placement<Vertex> order(const TupleGraph& tg, bool directed, int64_t nv);
+    
+    /// Mark solo vertices invalid (optionally) and report memory use, for create().
+    /// Also gives `tg` back its original ids if alloc() relabeled it.
+    static void finish(GlobalAddress<Graph> g, const TupleGraph& tg, bool solo_invalid);
+    
+    /// Build adjacencies by shuffling edges to their source's core in bulk and
+    /// counting-sorting them into adj_buf (used by create() if --graph_bulk_create).
+    /// Edge data is constructed from the TupleGraph's payloads of type P, unless P is Empty.
+    template< typename P = Empty, typename Combine = EdgeCombine::First >
+    static void build_bulk(GlobalAddress<Graph> g, const TupleGraph& tg, bool directed,
+                           Combine combine = Combine());
+    
+    /// Build adjacencies with a delegate per edge endpoint and a heap array per vertex.
+    static void build_scatter(GlobalAddress<Graph> g, const TupleGraph& tg, bool directed);
+    
+    /// Build the incoming-edge index of a directed graph (collective; done by create()
+    /// if `in_edges` is set). Each vertex's in-edge sources are kept sorted, on the
+    /// vertex's core, so `forall(in_adj(g,v), ...)` can gather from them in order.
+    /// Nothing to do for undirected graphs.
+    static void build_in_edges(GlobalAddress<Graph> g);
     
     static GlobalAddress<Graph> Undirected(const TupleGraph& tg) { return create(tg, false); }
-    static GlobalAddress<Graph> Directed(const TupleGraph& tg) { return create(tg, true); }
+    static GlobalAddress<Graph> Directed(const TupleGraph& tg, bool in_edges = false) {
+      return create(tg, true, true, in_edges);
+    }
+    
+    /// Stage a batch of edges to add (collective, call from one task): each edge of
+    /// `batch` (with ids as in the input TupleGraph; in both directions if undirected)
+    /// is sent to its source's core, and the graph doesn't change until commit().
+    /// Inserted edges get default-constructed edge data; inserting an existing edge
+    /// keeps its data.
+    static void insert_edges(GlobalAddress<Graph> g, const TupleGraph& batch) {
+      stage_updates(g, batch, true);
+    }
+    
+    /// Stage a batch of edges to remove (collective), like insert_edges().
+    static void delete_edges(GlobalAddress<Graph> g, const TupleGraph& batch) {
+      stage_updates(g, batch, false);
+    }
+    
+    static void stage_updates(GlobalAddress<Graph> g, const TupleGraph& batch, bool insert);
+    
+    /// Apply all staged insertions & deletions (collective, call between phases, so
+    /// traversals always see a consistent graph). Where batches disagree about an edge,
+    /// the later one wins. Each vertex's sorted adjacency is merged with its updates in
+    /// place if it fits its slot, or else moved to new storage; a core compacts its
+    /// edges (leaving --graph_update_slack room per vertex) once the moved edges
+    /// outgrow that slack. Vertices that gain edges become valid; the incoming-edge
+    /// index is rebuilt if there was one. Not supported with compressed adjacency or
+    /// vertex-cut graphs.
+    static void commit(GlobalAddress<Graph> g);
+    
+    /// Put `adj` (with edge states `data`) in local vertex `v`'s adjacency (for commit()).
+    void set_local_adj(Vertex& v, const std::vector<VertexID>& adj, const std::vector<E>& data);
+    
+    /// Repack this core's adjacencies into fresh adj_buf & edge_storage, with slack.
+    void compact_local();
+    
+    /// Destroy & free the storage of vertices moved out of adj_buf by commit().
+    void free_overflow() {
+      for (auto& b : overflow) {
+        for (int64_t i = 0; i < b.cap; i++) b.edges[i].~E();
+        locale_free(b.edges);
+        locale_free(b.adj);
+      }
+      overflow.clear();
+      overflow_edges = 0;
+    }
+    
+    /// Write a binary snapshot of the graph's structure and data to directory `path`
+    /// (collective; every core writes its own part in parallel). See impl::GraphFileHeader
+    /// for the format. Not supported for vertex-cut graphs. V and E are written as raw
+    /// bytes, so they must be plain data (no pointers).
+    void save(const std::string& path);
+    
+    /// Rebuild a graph saved by save(), skipping TupleGraph parsing and create().
+    /// On the same number of cores, each core reads its part straight into its own
+    /// slice; otherwise, the parts are read in parallel and shuffled to their new cores.
+    /// The incoming-edge index, if saved, is rebuilt; --graph_compress_adj is applied.
+    static GlobalAddress<Graph> load(const std::string& path);
+    
+    /// Attach adjacencies & data read from a snapshot to this core's vertices (for load()).
+    static void load_local(GlobalAddress<Graph> g, const int64_t * nadj, const uint8_t * valid,
+                           const char * data, VertexID * adj, EdgeState * edges,
+                           int64_t nadj_local);
+    
+    /// Internal id of the vertex numbered `orig` in the input TupleGraph (differs only
+    /// if --graph_partition or --graph_order renumbered vertices; may be a remote read).
+    VertexID vertex_id(VertexID orig) { return relabeled ? delegate::read(new_ids+orig) : orig; }
+    
+    /// Id in the input TupleGraph of the vertex with internal id `i` (-1 for padding).
+    VertexID original_id(VertexID i) { return relabeled ? delegate::read(orig_ids+i) : i; }
+    
+    /// True if in_nadj()/in_local_adj() are available.
+    bool has_in_edges() const { return !directed || in_offset != nullptr; }
+    
+    /// Number of incoming edges of `v` (which must be local).
+    ///
+    /// In an undirected graph, for a split vertex (see --graph_split_degree) this and
+    /// in_local_adj()/for_in_neighbors() cover only the edges held by the master, like
+    /// `v.nadj`; forall(in_adj(g,v), ...) also visits those held by its mirrors.
+    int64_t in_nadj(Vertex& v) {
+      if (!directed) return v.nadj;
+      DCHECK(in_offset) << "no incoming-edge index; see build_in_edges()";
+      auto i = &v - iterate_local(vs, nv).begin();
+      return in_offset[i+1] - in_offset[i];
+    }
+    
+    /// Sources of the incoming edges of `v` (which must be local), sorted.
+    /// (Null for an undirected graph with compressed adjacency; see for_in_neighbors().)
+    VertexID * in_local_adj(Vertex& v) {
+      if (!directed) return v.local_adj;
+      DCHECK(in_offset) << "no incoming-edge index; see build_in_edges()";
+      return in_adj_buf + in_offset[&v - iterate_local(vs, nv).begin()];
+    }
       
+    /// Call `f(k, src)` for incoming edges k in [start, start+n) of local vertex `v`.
+    template< typename F >
+    void for_in_neighbors(Vertex& v, int64_t start, int64_t n, F f) {
+      if (!directed) return for_neighbors(v, start, n, f);
+      auto srcs = in_local_adj(v);
+      for (int64_t k = start; k < start+n; k++) f(k, srcs[k]);
+    }
+    
     VertexID id(Vertex& v) {
+      if (is_mirror(v)) return mirror_ids[&v - mirrors];
       return make_linear(&v) - vs;
     }
     
+    /// Position of local vertex (or mirror) `v` among this core's vertices.
+    int64_t local_index(Vertex& v) {
+      if (is_mirror(v)) return iterate_local(vs, nv).size() + (&v - mirrors);
+      return &v - iterate_local(vs, nv).begin();
+    }
+    
+    bool compressed() const { return cadj != nullptr; }
+    
+    /// Call `f(i, j)` for neighbors i in [start, start+n) of local vertex `v`, in
+    /// order, decoding them if the adjacency is compressed.
+    template< typename F >
+    void for_neighbors(Vertex& v, int64_t start, int64_t n, F f) {
+      if (!cadj) {
+        for (int64_t i = start; i < start+n; i++) f(i, v.local_adj[i]);
+        return;
+      }
+      const int64_t B = impl::cadj_block;
+      int64_t i = start - start % B;
+      const uint8_t * p = cadj + cadj_blocks[cadj_first_block[local_index(v)] + i/B];
+      VertexID j = 0;
+      for (; i < start+n; i++) {
+        uint64_t x;
+        p = impl::get_varint(p, x);
+        j = (i % B == 0) ? x : j + x;
+        if (i >= start) f(i, j);
+      }
+    }
+    
+    /// The i'th neighbor of local vertex `v` (random access; decodes at most one block).
+    VertexID neighbor(Vertex& v, int64_t i) {
+      if (!cadj) return v.local_adj[i];
+      VertexID j = -1;
+      for_neighbors(v, i, 1, [&j](int64_t, VertexID jj){ j = jj; });
+      return j;
+    }
+    
+    /// Re-encode every core's adjacency lists as blocks of varint deltas, freeing
+    /// adj_buf (collective; done by create() if --graph_compress_adj).
+    static void compress_adj(GlobalAddress<Graph> g);
+    
+    /// True if `v` (local) is a mirror of a split vertex rather than a vertex in `vs`.
+    bool is_mirror(Vertex& v) {
+      return v.split && &v >= mirrors && &v < mirrors + nmirrors_local;
+    }
+    
+    /// Record of local split (master) vertex `v`, with its degree and mirrors.
+    impl::SplitMaster& split_master(Vertex& v) {
+      auto i = id(v);
+      auto it = std::lower_bound(splits.begin(), splits.end(), i,
+                    [](const impl::SplitMaster& s, VertexID i){ return s.id < i; });
+      DCHECK(it != splits.end() && it->id == i);
+      return *it;
+    }
+    
+    /// Total number of out-edges of (local, master) vertex `v`, including those
+    /// held by its mirrors if it is split. A mirror counts only its own edges.
+    int64_t degree(Vertex& v) {
+      if (!v.split || is_mirror(v)) return v.nadj;
+      return split_master(v).degree;
+    }
+    
+    /// Copy the data of every split vertex to all of its mirrors (call from one task).
+    void broadcast_to_mirrors() {
+      auto g = self;
+      on_all_cores([g]{
+        CompletionEvent ce(g->mirror_refs.size());
+        auto cea = make_global(&ce);
+        for (auto& s : g->splits) {
+          V d = (g->vs+s.id).pointer()->data;
+          for (int64_t r = s.first_ref; r < s.first_ref + s.nrefs; r++) {
+            auto ref = g->mirror_refs[r];
+            send_heap_message(ref.core, [g,ref,d,cea]{
+              g->mirrors[ref.index].data = d;
+              complete(cea);
+            });
+          }
+        }
+        ce.wait();
+      });
+    }
+    
+    /// Fold the data of every mirror into its master, running
+    /// `combine(Vertex& master, const V& mirror_data)` at the master for each
+    /// mirror, in no particular order (call from one task).
+    template< typename F >
+    void gather_to_masters(F combine) {
+      auto g = self;
+      on_all_cores([g,combine]{
+        CompletionEvent ce(g->nmirrors_local);
+        auto cea = make_global(&ce);
+        for (int64_t k = 0; k < g->nmirrors_local; k++) {
+          auto v = g->vs + g->mirror_ids[k];
+          V d = g->mirrors[k].data;
+          send_heap_message(v.core(), [v,d,combine,cea]{
+            combine(*v.pointer(), d);
+            complete(cea);
+          });
+        }
+        ce.wait();
+      });
+    }
+    
     Edge edge(Vertex& v, size_t i) {
-      auto j = v.local_adj[i];
+      auto j = neighbor(v, i);
       return Edge{ j, vs+j, v.local_edge_state[i] };
     }
     
@@ -397,6 +1126,19 @@ namespace Grappa {
   AdjIterator<G> adj(GlobalAddress<G> g, VertexID i) { return AdjIterator<G>(g, i); }  
   
   namespace impl {
+    /// Loop over the edges stored with local vertex (or mirror) `v` itself -- for a split
+    /// vertex, not those held by its mirrors -- calling `body(i, Edge&)` at v's core.
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall_own_edges(G * g, typename G::Vertex * v, F body) {
+      Grappa::forall_here<S,C,Threshold>(0, v->nadj, [body,v,g](int64_t s, int64_t n){
+        auto vs = g->vs;
+        g->for_neighbors(*v, s, n, [&](int64_t i, VertexID j){
+          typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
+          body(i, e);
+        });
+      });
+    }
+    
     template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
     void forall(AdjIterator<G> a, F body,
                 void (F::*mf)(int64_t,typename G::Edge&) const)
@@ -405,13 +1147,30 @@ namespace Grappa {
       auto origin = mycore();
       
       auto loop = [a,origin,body]{
-        auto vs = a.g->vs;
-        auto v = (vs+a.i).pointer();
-        Grappa::forall_here<S,C,Threshold>(0, v->nadj, [body,v,vs](int64_t i){
-          auto j = v->local_adj[i];
-          typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
-          body(i, e);
-        });
+        auto g = a.g.localize();
+        auto v = (g->vs+a.i).pointer();
+        
+        // the rest of a split vertex's edges are held by its mirrors: visit them there
+        int64_t nrefs = v->split ? g->split_master(*v).nrefs : 0;
+        CompletionEvent mce(S == SyncMode::Blocking ? nrefs : 0);
+        if (nrefs > 0) {
+          auto mce_a = make_global(&mce);
+          auto ga = a.g;
+          auto& sm = g->split_master(*v);
+          for (int64_t r = sm.first_ref; r < sm.first_ref + nrefs; r++) {
+            auto ref = g->mirror_refs[r];
+            if (C) C->enroll();
+            spawnRemote<nullptr>(ref.core, [ga,ref,mce_a,body]{
+              auto g = ga.localize();
+              forall_own_edges<S,C,Threshold>(g, g->mirrors + ref.index, body);
+              if (C) C->send_completion(mce_a.core());
+              if (S == SyncMode::Blocking) complete(mce_a);
+            });
+          }
+        }
+        
+        forall_own_edges<S,C,Threshold>(g, v, body);
+        if (S == SyncMode::Blocking) mce.wait();
         if (C) C->send_completion(origin);
       };
       
@@ -459,16 +1218,121 @@ namespace Grappa {
             int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
 #undef OVERLOAD
   
+  template< typename G >
+  struct InAdjIterator {
+    GlobalAddress<G> g;
+    VertexID i;
+    InAdjIterator(GlobalAddress<G> g, VertexID i): g(g), i(i) {}
+  };
+  
+  /// Iterator over the sources of a vertex's incoming edges. Used with Grappa::forall().
+  /// Requires the graph's incoming-edge index (see Graph::build_in_edges()). The body runs
+  /// on the vertex's core and gets the source vertex id, optionally preceded by its
+  /// index in [0,in_nadj). (In an undirected graph this is the same as adj(), so a
+  /// split vertex's mirror edges are visited too, at the mirror, indexed within it.)
+  ///
+  /// @code
+  /// forall(g, [g](G::Vertex& v){
+  ///   forall<async>(in_adj(g,v), [&v](VertexID src){ ... });
+  ///   forall<async>(in_adj(g,v), [&v](int64_t k, VertexID src){ ... });
+  /// });
+  /// @endcode
+  template< typename G >
+  InAdjIterator<G> in_adj(GlobalAddress<G> g, typename G::Vertex& v) {
+    return InAdjIterator<G>(g, make_linear(&v) - g->vs);
+  }
+  
+  template< typename G >
+  InAdjIterator<G> in_adj(GlobalAddress<G> g, GlobalAddress<typename G::Vertex> v) {
+    return InAdjIterator<G>(g, v - g->vs);
+  }
+  
+  template< typename G >
+  InAdjIterator<G> in_adj(GlobalAddress<G> g, VertexID i) { return InAdjIterator<G>(g, i); }
+  
+  namespace impl {
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall(InAdjIterator<G> a, F body, void (F::*mf)(int64_t,VertexID) const) {
+      if (!a.g->directed) {
+        // same edges as adj(), which also visits the mirrors of split vertices
+        auto f = [body](int64_t i, typename G::Edge& e){ body(i, e.id); };
+        impl::forall<S,C,Threshold>(AdjIterator<G>(a.g, a.i), f, &decltype(f)::operator());
+        return;
+      }
+      if (C) C->enroll();
+      auto origin = mycore();
+      
+      auto loop = [a,origin,body]{
+        auto g = a.g;
+        auto& v = *(g->vs+a.i).pointer();
+        CHECK(g->has_in_edges()) << "no incoming-edge index; see Graph::build_in_edges()";
+        auto gl = g.localize();
+        auto vp = &v;
+        Grappa::forall_here<S,C,Threshold>(0, g->in_nadj(v), [body,gl,vp](int64_t s, int64_t n){
+          gl->for_in_neighbors(*vp, s, n, [&body](int64_t k, VertexID j){ body(k, j); });
+        });
+        if (C) C->send_completion(origin);
+      };
+      
+      auto v = a.g->vs+a.i;
+      
+      if (v.core() == mycore()) {
+        loop();
+      } else {
+        if (S == SyncMode::Async) {
+          spawnRemote<nullptr>(v.core(), [loop]{ loop(); });
+        } else {
+          CompletionEvent ce(1);
+          auto ce_a = make_global(&ce);
+          spawnRemote<nullptr>(v.core(), [loop,ce_a]{
+            loop();
+            complete(ce_a);
+          });
+          ce.wait();
+        }
+      }
+    }
+    template< SyncMode S, GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall(InAdjIterator<G> a, F body, void (F::*mf)(VertexID) const) {
+      auto f = [body](int64_t k, VertexID j){ body(j); };
+      impl::forall<S,C,Threshold>(a, f, &decltype(f)::operator());
+    }
+  }
+  
+#define OVERLOAD(...) \
+  template< __VA_ARGS__, typename G = nullptr_t, typename F = nullptr_t > \
+  void forall(InAdjIterator<G> a, F body) { \
+    impl::forall<S,C,Threshold>(a, body, &F::operator()); \
+  }
+  /// Parallel loop over sources of incoming edges. Use in_adj() to construct iterator
+  OVERLOAD( SyncMode S = SyncMode::Blocking,
+            GlobalCompletionEvent * C = &impl::local_gce,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
+  OVERLOAD( GlobalCompletionEvent * C,
+            SyncMode S = SyncMode::Blocking,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG );
+#undef OVERLOAD
+  
+  template< typename G = nullptr_t, typename F = nullptr_t >
+  void serial_for(InAdjIterator<G> a, F body) {
+    auto g = a.g;
+    CHECK((g->vs+a.i).core() == mycore());
+    auto& v = *(g->vs+a.i).pointer();
+    CHECK(g->directed || !v.split) << "serial_for doesn't visit mirrors' edges; use forall(in_adj(g,v), ...)";
+    g->for_in_neighbors(v, 0, g->in_nadj(v), [&body](int64_t k, VertexID j){ body(j); });
+  }
+  
   template< typename G = nullptr_t, typename F = nullptr_t >
   void serial_for(AdjIterator<G> a, F body) {
-    auto vs = a.g->vs;
+    auto g = a.g.localize();
+    auto vs = g->vs;
     auto v = (vs+a.i).pointer();
     CHECK((vs+a.i).core() == mycore());
-    for (int64_t i = 0; i < v->nadj; i++) {
-      auto j = v->local_adj[i];
+    CHECK(!v->split) << "serial_for doesn't visit mirrors' edges; use forall(adj(g,v), ...)";
+    g->for_neighbors(*v, 0, v->nadj, [&](int64_t i, VertexID j){
       typename G::Edge e = { j, vs+j, v->local_edge_state[i] };
       body(e);
-    }
+    });
   }
   
   
@@ -496,18 +1360,42 @@ namespace Grappa {
       impl::forall<C,Threshold>(g, f, &decltype(f)::operator());
     }
     
+    /// Parallel iteration over the edges held by mirrors of split vertices
+    /// (see --graph_split_degree), executing at the mirror. Blocks until done.
+    template< GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
+    void forall_mirror_edges(GlobalAddress<G> g, F body) {
+      auto origin = mycore();
+      C->enroll(cores());
+      for (Core c = 0; c < cores(); c++) {
+        send_heap_message(c, [g,body,origin]{
+          spawn([g,body,origin]{
+            for (int64_t k = 0; k < g->nmirrors_local; k++) {
+              auto m = g->mirrors + k;
+              forall_own_edges<SyncMode::Async,C,Threshold>(g.localize(), m,
+                  [m,body](int64_t i, typename G::Edge& e){
+                body(*m, e);
+              });
+            }
+            complete(make_global(C,origin));
+          });
+        });
+      }
+      C->wait();
+    }
+    
     /// Parallel iteration over all adjacencies of all vertices,
-    /// executing at the *source* vertex.
+    /// executing at the *source* vertex (or its mirror, for split vertices).
     template< GlobalCompletionEvent * C, int64_t Threshold, typename G, typename F >
     void forall(GlobalAddress<G> g, F loop_body,
                 void (F::*mf)(typename G::Vertex& src, typename G::Edge& adj) const) {
       auto f = [g,loop_body](typename G::Vertex& v){
-        Grappa::forall<SyncMode::Async,C,Threshold>(adj(g,v),
-            [&v,loop_body](typename G::Edge& e){
+        forall_own_edges<SyncMode::Async,C,Threshold>(g.localize(), &v,
+            [&v,loop_body](int64_t i, typename G::Edge& e){
           loop_body(v, e);
         });
       };
       forall<C,Threshold>(g, f, &decltype(f)::operator());
+      if (g->nsplit > 0) forall_mirror_edges<C,Threshold>(g, loop_body);
     }
 
     /// Parallel iteration over all adjacencies of all vertices,
@@ -516,8 +1404,8 @@ namespace Grappa {
     void forall(GlobalAddress<G> g, F loop_body,
                 void (F::*mf)(typename G::Edge& adj, typename G::Vertex& src) const) {
       auto f = [g,loop_body](typename G::Vertex& v){
-        Grappa::forall<SyncMode::Async,C,Threshold>(adj(g,v),
-            [&v,loop_body,g](typename G::Edge& e){
+        forall_own_edges<SyncMode::Async,C,Threshold>(g.localize(), &v,
+            [loop_body,g](int64_t i, typename G::Edge& e){
           auto e_id = e.id;
           auto e_data = e.data;
           Grappa::delegate::call<SyncMode::Async>(e.ga, [=](typename G::Vertex& ve){
@@ -528,6 +1416,12 @@ namespace Grappa {
         });
       };
       forall<C,Threshold>(g, f, &decltype(f)::operator());
+      if (g->nsplit > 0) {
+        // mirrors' edges are already on their destinations' cores
+        forall_mirror_edges<C,Threshold>(g, [loop_body](typename G::Vertex& m, typename G::Edge& e){
+          loop_body(e, *e.ga.pointer());
+        });
+      }
     }
     
     /// @deprecated
@@ -538,10 +1432,16 @@ namespace Grappa {
                 void (F::*mf)(GlobalAddress<typename G::Vertex> src, GlobalAddress<typename G::Vertex> dst) const) {
       Grappa::forall<C,Threshold>(g, [g,loop_body](VertexID i, typename G::Vertex& v){
         auto vi = make_linear(&v);
-        Grappa::forall<SyncMode::Async,C,Threshold>(adj(g,v), [loop_body,vi](typename G::Edge& e){
+        forall_own_edges<SyncMode::Async,C,Threshold>(g.localize(), &v,
+            [loop_body,vi](int64_t i, typename G::Edge& e){
           loop_body(vi, e.ga);
         });
       });
+      if (g->nsplit > 0) {
+        forall_mirror_edges<C,Threshold>(g, [g,loop_body](typename G::Vertex& m, typename G::Edge& e){
+          loop_body(g->vs + g->id(m), e.ga);
+        });
+      }
     }
     
   }
@@ -607,14 +1507,46 @@ namespace Grappa {
   ///                      over vertices)
   template< typename V, typename E >
   GlobalAddress<Graph<V,E>> Graph<V,E>::create(const TupleGraph& tg,
-      bool directed, bool solo_invalid) {
+      bool directed, bool solo_invalid, bool in_edges) {
     VLOG(1) << "Graph: " << (directed ? "directed" : "undirected");
-    double t;
-    auto g = symmetric_global_alloc<Graph>();
+    auto g = alloc(tg, directed);
     
-    // find nv
-        t = walltime();
-    forall(tg.edges, tg.nedge, [g](TupleGraph::Edge& e){
+    if (FLAGS_graph_bulk_create) {
+      build_bulk(g, tg, directed);
+    } else {
+      LOG_IF(WARNING, FLAGS_graph_split_degree > 0)
+        << "--graph_split_degree requires --graph_bulk_create; not splitting vertices";
+      build_scatter(g, tg, directed);
+    }
+    if (in_edges) build_in_edges(g);
+    if (FLAGS_graph_compress_adj) compress_adj(g);
+    
+    finish(g, tg, solo_invalid);
+    return g;
+  }
+  
+  template< typename V, typename E >
+  template< typename P, typename Combine >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::create(const TupleGraph& tg, Combine combine,
+      bool directed, bool solo_invalid) {
+    VLOG(1) << "Graph: " << (directed ? "directed" : "undirected") << ", with edge payloads";
+    CHECK(tg.has_payload()) << "TupleGraph has no edge payloads";
+    CHECK_EQ(tg.payload_size, sizeof(P)) << "TupleGraph payload doesn't match requested type";
+    auto g = alloc(tg, directed);
+    build_bulk<P>(g, tg, directed, combine);
+    if (FLAGS_graph_compress_adj) compress_adj(g);
+    finish(g, tg, solo_invalid);
+    return g;
+  }
+  
+  template< typename V, typename E >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::alloc(const TupleGraph& tg, bool directed) {
+    double t;
+    auto g = symmetric_global_alloc<Graph>();
+    
+    // find nv
+        t = walltime();
+    forall(tg.edges, tg.nedge, [g](TupleGraph::Edge& e){
       if (e.v0 > g->nv) { g->nv = e.v0; }
       if (e.v1 > g->nv) { g->nv = e.v1; }
     });
@@ -623,10 +1555,62 @@ namespace Grappa {
     });
         VLOG(2) << "find_nv_time: " << walltime() - t;
 
-    auto vs = global_alloc<Vertex>(g->nv);
+    int64_t nv = g->nv;
+    bool ordered = (FLAGS_graph_order != "none");
+    bool partitioned = (FLAGS_graph_partition != "cyclic");
+    bool relabeled = ordered || partitioned;
+    
+    auto edges = tg.edges;
+    auto nedge = tg.nedge;
+    auto relabel = [edges,nedge](GlobalAddress<VertexID> new_ids){
+      forall(edges, nedge, [new_ids](TupleGraph::Edge& e){
+        e.v0 = delegate::read(new_ids+e.v0);
+        e.v1 = delegate::read(new_ids+e.v1);
+      });
+    };
+    
+    if (relabeled) {
+      // save the original ids to restore in finish()
+      on_all_cores([g,edges,nedge]{
+        auto local = iterate_local(edges, nedge);
+        g->saved_tuples = locale_alloc<TupleGraph::Edge>(local.size());
+        std::copy(local.begin(), local.end(), g->saved_tuples);
+      });
+    }
+    
+    impl::Placement<Vertex> p;
+    if (ordered) {
+      p = order(tg, directed, nv);
+      relabel(p.new_ids);
+    }
+    if (partitioned) {
+      // place the (possibly reordered) ids, then compose the two renumberings
+      auto q = place(tg, directed, nv);
+      relabel(q.new_ids);
+      if (ordered) {
+        auto inv = p.orig_ids, rank = p.new_ids;
+        forall(q.orig_ids, q.nv, [inv](VertexID& r){ if (r >= 0) r = delegate::read(inv+r); });
+        forall(rank, nv, [q](VertexID& r){ r = delegate::read(q.new_ids+r); });
+        global_free(inv);
+        global_free(q.new_ids);
+        q.new_ids = rank;
+      }
+      p = q;
+    } else {
+      p.vs = global_alloc<Vertex>(nv);
+      p.nv = nv;
+    }
+    
     auto self = g;
-    on_all_cores([g,vs]{
-      new (g.localize()) Graph(g, vs, g->nv);
+    on_all_cores([g,p,nv,directed,relabeled]{
+      auto saved = relabeled ? g->saved_tuples : nullptr;
+      new (g.localize()) Graph(g, p.vs, p.nv);
+      g->saved_tuples = saved;
+      g->directed = directed;
+      g->relabeled = relabeled;
+      g->orig_nv = nv;
+      g->orig_ids = p.orig_ids;
+      g->new_ids = p.new_ids;
       for (Vertex& v : iterate_local(g->vs, g->nv)) {
         new (&v) Vertex();
       }
@@ -643,7 +1627,280 @@ namespace Grappa {
       VLOG(0) << "locale = " << mylocale() << ", scratch = " << g->scratch;
   #endif
     });
-                                                              t = walltime();
+    return g;
+  }
+  
+  template< typename V, typename E >
+  impl::Placement<typename Graph<V,E>::Vertex> Graph<V,E>::place(const TupleGraph& tg,
+      bool directed, int64_t nv) {
+    enum class Mode { Block, Degree, Hash };
+    Mode mode;
+    if (FLAGS_graph_partition == "block") mode = Mode::Block;
+    else if (FLAGS_graph_partition == "degree") mode = Mode::Degree;
+    else if (FLAGS_graph_partition == "hash") mode = Mode::Hash;
+    else LOG(FATAL) << "unknown --graph_partition=" << FLAGS_graph_partition;
+    
+  #ifdef SMALL_GRAPH
+    LOG(FATAL) << "--graph_partition is not supported with SMALL_GRAPH";
+  #endif
+    double t = walltime();
+    
+    // number of edges each vertex will store (before de-dup)
+    auto deg = impl::tuple_degrees(tg, directed, nv);
+    
+    // pick a core for each vertex and send its id there
+    auto shuffle = impl::Shuffle<VertexID>::create();
+    on_all_cores([deg,nv,mode,shuffle]{
+      auto local = iterate_local(deg, nv);
+      if (mode == Mode::Hash) {
+        for (auto& d : local) {
+          VertexID i = make_linear(&d) - deg;
+          shuffle->push(hash_mix64(i) % cores(), i);
+        }
+      } else if (mode == Mode::Degree) {
+        // deal out local vertices heaviest first, each core starting at a different target
+        std::vector<std::pair<int64_t,VertexID>> order;
+        for (auto& d : local) order.emplace_back(-d, make_linear(&d) - deg);
+        std::sort(order.begin(), order.end());
+        for (size_t k = 0; k < order.size(); k++) {
+          shuffle->push((mycore()+k) % cores(), order[k].second);
+        }
+      } else {
+        // histogram edges & vertices over ranges of ids, then cut the id space
+        // into one range per core with about equal edges, capping vertices per
+        // core at twice the mean so padding stays bounded
+        int64_t nchunk = std::min<int64_t>(nv, cores()*256);
+        auto chunk = [nv,nchunk](VertexID i){ return i * nchunk / nv; };
+        std::vector<int64_t> hist(2*nchunk, 0);
+        for (auto& d : local) {
+          auto c = chunk(make_linear(&d) - deg);
+          hist[c] += d;
+          hist[nchunk+c]++;
+        }
+        allreduce_inplace<int64_t,collective_add>(hist.data(), hist.size());
+        
+        int64_t total = 0;
+        for (int64_t c = 0; c < nchunk; c++) total += hist[c];
+        double target = static_cast<double>(total) / cores();
+        int64_t cap = 2 * ((nv + cores() - 1) / cores());
+        
+        std::vector<Core> owner(nchunk);
+        Core core = 0;
+        int64_t cum_edges = 0, core_vs = 0;
+        for (int64_t c = 0; c < nchunk; c++) {
+          if (core < cores()-1 && core_vs > 0
+              && (cum_edges >= target*(core+1) || core_vs + hist[nchunk+c] > cap)) {
+            core++;
+            core_vs = 0;
+          }
+          owner[c] = core;
+          cum_edges += hist[c];
+          core_vs += hist[nchunk+c];
+        }
+        for (auto& d : local) {
+          VertexID i = make_linear(&d) - deg;
+          shuffle->push(owner[chunk(i)], i);
+        }
+      }
+    });
+    shuffle->exchange();
+    global_free(deg);
+    
+    // every core gets the same number of slots; the extras are padding
+    int64_t per_core = reduce<int64_t,impl::Shuffle<VertexID>,collective_max,
+                              &impl::received_count<VertexID>>(shuffle);
+    impl::Placement<Vertex> p;
+    p.nv = per_core * cores();
+    p.vs = global_alloc<Vertex>(p.nv);
+    p.orig_ids = global_alloc<VertexID>(p.nv);
+    p.new_ids = global_alloc<VertexID>(nv);
+    Grappa::memset(p.orig_ids, -1, p.nv);
+    
+    // each core's vertices take its first local slots, in id order
+    on_all_cores([p,shuffle]{
+      auto& recv = shuffle->received;
+      std::sort(recv.begin(), recv.end());
+      Vertex * slots = iterate_local(p.vs, p.nv).begin();
+      CHECK_LE(recv.size(), iterate_local(p.vs, p.nv).size());
+      forall_here(0, recv.size(), [p,slots,&recv](int64_t j){
+        VertexID i = make_linear(slots+j) - p.vs;
+        delegate::write(p.orig_ids+i, recv[j]);
+        delegate::write(p.new_ids+recv[j], i);
+      });
+    });
+    shuffle->destroy();
+    
+    VLOG(1) << "placed " << nv << " vertices in " << p.nv << " slots ("
+            << FLAGS_graph_partition << "), place_time: " << walltime() - t;
+    return p;
+  }
+  
+  template< typename V, typename E >
+  impl::Placement<typename Graph<V,E>::Vertex> Graph<V,E>::order(const TupleGraph& tg,
+      bool directed, int64_t nv) {
+    enum class Mode { Degree, RCM, Hub };
+    Mode mode;
+    if (FLAGS_graph_order == "degree") mode = Mode::Degree;
+    else if (FLAGS_graph_order == "rcm") mode = Mode::RCM;
+    else if (FLAGS_graph_order == "hub") mode = Mode::Hub;
+    else LOG(FATAL) << "unknown --graph_order=" << FLAGS_graph_order;
+    
+  #ifdef SMALL_GRAPH
+    LOG(FATAL) << "--graph_order is not supported with SMALL_GRAPH";
+  #endif
+    double t = walltime();
+    
+    impl::Placement<Vertex> p;
+    p.nv = nv;
+    p.orig_ids = global_alloc<VertexID>(nv);
+    p.new_ids = global_alloc<VertexID>(nv);
+    auto deg = impl::tuple_degrees(tg, directed, nv);
+    auto s = impl::Shuffle<impl::OrderRec>::create();
+    
+    if (mode != Mode::RCM) {
+      double mean = static_cast<double>(directed ? tg.nedge : 2*tg.nedge) / nv;
+      on_all_cores([deg,nv,mode,mean,s]{
+        for (auto& d : iterate_local(deg, nv)) {
+          VertexID i = make_linear(&d) - deg;
+          bool first = (mode == Mode::Degree) || (d > mean);
+          s->received.push_back(impl::OrderRec{ first ? -d : 0, 0, i });
+        }
+      });
+      impl::rank_sorted(s, 0, p.new_ids, p.orig_ids);
+    } else {
+      // Cuthill-McKee: BFS (over edges in both directions) from a least-degree vertex,
+      // numbering each level by the least rank of its vertices' parents, then by degree;
+      // each component in turn, then vertices with no edges. Then reverse it all.
+      auto st = global_alloc<impl::OrderState>(nv);
+      forall(st, nv, [deg](VertexID i, impl::OrderState& o){
+        o = impl::OrderState{ -1, -1, -1, delegate::read(deg+i) };
+      });
+      auto edges = tg.edges;
+      auto nedge = tg.nedge;
+      auto new_ids = p.new_ids;
+      int64_t next = 0, level = 0;
+      while (next < nv) {
+        // start the next component
+        std::pair<int64_t,VertexID> root{ std::numeric_limits<int64_t>::max(), -1 };
+        auto rootp = make_global(&root);
+        on_all_cores([st,nv,rootp]{
+          std::pair<int64_t,VertexID> best{ std::numeric_limits<int64_t>::max(), -1 };
+          for (auto& o : iterate_local(st, nv)) {
+            if (o.level < 0 && o.deg > 0) best = std::min(best, std::make_pair(o.deg, make_linear(&o) - st));
+          }
+          if (best.second >= 0) {
+            delegate::call(rootp, [best](std::pair<int64_t,VertexID>& r){ r = std::min(r, best); });
+          }
+        });
+        if (root.second < 0) {
+          // the rest have no edges: keep them in id order
+          on_all_cores([st,nv,s]{
+            for (auto& o : iterate_local(st, nv)) {
+              if (o.level < 0) s->received.push_back(impl::OrderRec{ 0, 0, make_linear(&o) - st });
+            }
+          });
+          next += impl::rank_sorted(s, next, p.new_ids, p.orig_ids);
+          break;
+        }
+        auto r = root.second;
+        auto rank = next++;
+        delegate::call(st+r, [level,rank](impl::OrderState& o){ o.level = level; o.rank = rank; });
+        delegate::write(p.new_ids+r, rank);
+        delegate::write(p.orig_ids+rank, r);
+        
+        while (true) {
+          forall(edges, nedge, [st,level](TupleGraph::Edge& e){
+            auto visit = [st,level](VertexID u, VertexID v){
+              auto ou = delegate::read(st+u);
+              if (ou.level != level) return;
+              auto pr = ou.rank;
+              delegate::call<SyncMode::Async>(st+v, [level,pr](impl::OrderState& o){
+                if (o.level < 0) { o.level = level+1; o.parent = pr; }
+                else if (o.level == level+1 && pr < o.parent) o.parent = pr;
+              });
+            };
+            visit(e.v0, e.v1);
+            visit(e.v1, e.v0);
+          });
+          level++;
+          on_all_cores([st,nv,s,level]{
+            for (auto& o : iterate_local(st, nv)) {
+              if (o.level == level) s->received.push_back(impl::OrderRec{ o.parent, o.deg, make_linear(&o) - st });
+            }
+          });
+          auto n = impl::rank_sorted(s, next, p.new_ids, p.orig_ids);
+          if (n == 0) break;
+          next += n;
+          forall(st, nv, [new_ids,level](VertexID i, impl::OrderState& o){
+            if (o.level == level) o.rank = delegate::read(new_ids+i);
+          });
+        }
+      }
+      global_free(st);
+      
+      auto orig_ids = p.orig_ids;
+      forall(new_ids, nv, [nv,orig_ids](VertexID i, VertexID& r){
+        r = nv-1 - r;
+        delegate::write(orig_ids+r, i);
+      });
+    }
+    s->destroy();
+    global_free(deg);
+    
+    VLOG(1) << "ordered " << nv << " vertices (" << FLAGS_graph_order
+            << "), order_time: " << walltime() - t;
+    return p;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::finish(GlobalAddress<Graph> g, const TupleGraph& tg, bool solo_invalid) {
+    if (g->relabeled) {
+      auto edges = tg.edges;
+      auto nedge = tg.nedge;
+      on_all_cores([g,edges,nedge]{
+        auto local = iterate_local(edges, nedge);
+        std::copy(g->saved_tuples, g->saved_tuples + local.size(), local.begin());
+        locale_free(g->saved_tuples);
+        g->saved_tuples = nullptr;
+      });
+      if (!solo_invalid) {
+        forall(g->vs, g->nv, [g](VertexID i, Vertex& v){
+          if (delegate::read(g->orig_ids+i) < 0) v.valid = false;
+        });
+      }
+    }
+    
+    if (solo_invalid) {
+      // (note: this isn't necessary if we don't create vertices for those with no edges)
+      // find which are actually active (first, those with outgoing edges)
+      forall(g, [](Vertex& v){ v.valid = (v.nadj > 0 || v.split); });
+      // then those with only incoming edges (reachable from at least one active vertex)
+      forall(g, [](Edge& e, Vertex& ve){ ve.valid = true; });
+    }    
+    VLOG(1) << "-- vertices: " << g->nv;
+    
+    auto max_local = reduce<int64_t,Graph,collective_max,&impl::local_nadj<Graph>>(g);
+    graph_edge_imbalance = (g->nadj > 0) ? max_local * cores() / static_cast<double>(g->nadj) : 1.0;
+    VLOG(1) << "-- edge imbalance (max/mean per core): " << graph_edge_imbalance.value();
+    
+    auto gsz = Vertex::global_heap_size()*g->nv
+                          + sizeof(Graph) * cores();
+    auto lsz = Vertex::locale_heap_size()*g->nv
+                          + (g->compressed() ? g->cadj_bytes : sizeof(VertexID)*g->nadj)
+                          + sizeof(EdgeState)*g->nadj;
+    if (g->directed && g->in_offset) {
+      lsz += sizeof(VertexID)*g->nadj + sizeof(int64_t)*(g->nv+cores());
+    }
+    auto GB = [](size_t v){ return static_cast<double>(v) / (1L<<30); };
+    LOG(INFO) << "\nGraph memory breakdown:"
+              << "\n  locale_heap_size: " << GB(lsz) << " GB"
+              << "\n  global_heap_size: " << GB(gsz) << " GB"
+              << "\n  graph_total_size: " << GB(lsz+gsz) << " GB";
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::build_scatter(GlobalAddress<Graph> g, const TupleGraph& tg, bool directed) {
+    double t = walltime();
     // count the outgoing/undirected edges per vertex
     forall(tg.edges, tg.nedge, [g,directed](TupleGraph::Edge& e){
       CHECK_LT(e.v0, g->nv); CHECK_LT(e.v1, g->nv);
@@ -733,9 +1990,10 @@ namespace Grappa {
       // allocate storage for local vertices' adjacencies
       g->adj_buf = locale_alloc<VertexID>(g->nadj_local);
       g->edge_storage = locale_alloc<EdgeState>(g->nadj_local);
+      g->edge_slots_local = g->nadj_local;
       
       // default-initialize edges
-      // TODO: import edge info from TupleGraph
+      // (edge payloads are imported only by build_bulk)
       for (size_t i=0; i<g->nadj_local; i++) {
         new (g->edge_storage+i) EdgeState();
       }
@@ -755,27 +2013,702 @@ namespace Grappa {
       }
       CHECK_EQ(offset, g->nadj_local);
     });
+  }
+  
+  template< typename V, typename E >
+  template< typename P, typename Combine >
+  void Graph<V,E>::build_bulk(GlobalAddress<Graph> g, const TupleGraph& tg, bool directed,
+                              Combine combine) {
+    using Record = impl::EdgeRecord<P>;
+    double t = walltime();
     
-    if (solo_invalid) {
-      // (note: this isn't necessary if we don't create vertices for those with no edges)
-      // find which are actually active (first, those with outgoing edges)
-      forall(g, [](Vertex& v){ v.valid = (v.nadj > 0); });
-      // then those with only incoming edges (reachable from at least one active vertex)
-      forall(g, [](Edge& e, Vertex& ve){ ve.valid = true; });
-    }    
-    VLOG(1) << "-- vertices: " << g->nv;
+    // vertex-cut: find the vertices with too many edges; every core gets the (short) list
+    auto hubs = impl::Shuffle<VertexID>::create();
+    int64_t split_degree = FLAGS_graph_split_degree;
+    if (split_degree > 0) {
+      auto nv = g->nv;
+      auto deg = global_alloc<int64_t>(nv);
+      Grappa::memset(deg, 0, nv);
+      forall(tg.edges, tg.nedge, [deg,directed](TupleGraph::Edge& e){
+        delegate::increment<SyncMode::Async>(deg+e.v0, 1);
+        if (!directed) delegate::increment<SyncMode::Async>(deg+e.v1, 1);
+      });
+      on_all_cores([deg,nv,hubs,split_degree]{
+        for (auto& d : iterate_local(deg, nv)) {
+          if (d > split_degree) {
+            for (Core c = 0; c < cores(); c++) hubs->push(c, make_linear(&d) - deg);
+          }
+        }
+      });
+      hubs->exchange();
+      on_all_cores([hubs]{ std::sort(hubs->received.begin(), hubs->received.end()); });
+      global_free(deg);
+    }
     
-    auto gsz = Vertex::global_heap_size()*g->nv
-                          + sizeof(Graph) * cores();
-    auto lsz = Vertex::locale_heap_size()*g->nv
-                          + (sizeof(VertexID)+sizeof(EdgeState))*g->nadj;
-    auto GB = [](size_t v){ return static_cast<double>(v) / (1L<<30); };
-    LOG(INFO) << "\nGraph memory breakdown:"
-              << "\n  locale_heap_size: " << GB(lsz) << " GB"
-              << "\n  global_heap_size: " << GB(gsz) << " GB"
-              << "\n  graph_total_size: " << GB(lsz+gsz) << " GB";
+    // send each edge (both directions, if undirected) to the core of its source,
+    // or for a hub, to the core of its destination (where a mirror will hold it)
+    auto shuffle = impl::Shuffle<Record>::create();
+    on_all_cores([g,shuffle,hubs,tg,directed]{
+      auto& hub = hubs->received;
+      auto dest = [g,&hub](const Record& r){
+        if (!hub.empty() && std::binary_search(hub.begin(), hub.end(), r.v0)) {
+          return (g->vs+r.v1).core();
+        }
+        return (g->vs+r.v0).core();
+      };
+      for (auto& e : iterate_local(tg.edges, tg.nedge)) {
+        CHECK_LT(e.v0, g->nv); CHECK_LT(e.v1, g->nv);
+        Record r{ e.v0, e.v1 };
+        r.data = impl::edge_payload<P>(tg, e);
+        shuffle->push(dest(r), r);
+        if (!directed) {
+          std::swap(r.v0, r.v1);
+          shuffle->push(dest(r), r);
+        }
+      }
+    });
+    shuffle->exchange();
+    VLOG(2) << "shuffle_time: " << walltime() - t;
+    
+    t = walltime();
+    on_all_cores([g,shuffle,combine]{
+      const bool with_data = !std::is_same<P,Empty>::value;
+    #ifdef SMALL_GRAPH
+      if (locale_mycore() == 0) locale_free(g->scratch);
+    #endif
+      auto& recv = shuffle->received;
+      auto local_vs = iterate_local(g->vs, g->nv);
+      Vertex * lv = local_vs.begin();
+      size_t nlocal = local_vs.size();
+      
+      // edges of remote sources belong to mirrors, numbered after the local vertices
+      std::vector<VertexID> mids;
+      for (auto& e : recv) if ((g->vs+e.v0).core() != mycore()) mids.push_back(e.v0);
+      std::sort(mids.begin(), mids.end());
+      mids.erase(std::unique(mids.begin(), mids.end()), mids.end());
+      size_t nm = mids.size();
+      auto index = [g,lv,nlocal,&mids](VertexID v) -> int64_t {
+        auto a = g->vs+v;
+        if (a.core() == mycore()) return a.pointer() - lv;
+        return nlocal + (std::lower_bound(mids.begin(), mids.end(), v) - mids.begin());
+      };
+      if (nm > 0) {
+        g->nmirrors_local = nm;
+        g->mirrors = locale_alloc<Vertex>(nm);
+        g->mirror_ids = locale_alloc<VertexID>(nm);
+        for (size_t k = 0; k < nm; k++) {
+          new (g->mirrors+k) Vertex();
+          g->mirrors[k].split = true;
+          g->mirror_ids[k] = mids[k];
+        }
+      }
+      auto vertex = [g,lv,nlocal](size_t i) -> Vertex& {
+        return (i < nlocal) ? lv[i] : g->mirrors[i-nlocal];
+      };
+      
+      // counting sort by source vertex, straight into adj_buf
+      std::vector<int64_t> offset(nlocal+nm+1, 0);
+      for (auto& e : recv) offset[index(e.v0) + 1]++;
+      for (size_t i = 0; i < nlocal+nm; i++) offset[i+1] += offset[i];
+      
+      auto adj = locale_alloc<VertexID>(recv.size());
+      std::vector<P> data(with_data ? recv.size() : 0);
+      {
+        std::vector<int64_t> pos(offset.begin(), offset.end()-1);
+        for (auto& e : recv) {
+          auto k = pos[index(e.v0)]++;
+          adj[k] = e.v1;
+          if (with_data) data[k] = e.data;
+        }
+      }
+      std::vector<Record>().swap(recv);
+      
+      // sort & de-dup each adjacency list, compacting as we go
+      int64_t tail = 0;
+      std::vector<std::pair<VertexID,P>> tmp;
+      for (size_t i = 0; i < nlocal+nm; i++) {
+        auto start = tail;
+        if (!with_data) {
+          std::sort(adj+offset[i], adj+offset[i+1]);
+          for (int64_t k = offset[i]; k < offset[i+1]; k++) {
+            if (tail == start || adj[tail-1] != adj[k]) adj[tail++] = adj[k];
+          }
+        } else {
+          // sort (id, payload) pairs together, then fold duplicates' payloads
+          tmp.clear();
+          for (int64_t k = offset[i]; k < offset[i+1]; k++) tmp.emplace_back(adj[k], data[k]);
+          std::sort(tmp.begin(), tmp.end(), [](const std::pair<VertexID,P>& a,
+                                               const std::pair<VertexID,P>& b){
+            return a.first < b.first;
+          });
+          for (auto& p : tmp) {
+            if (tail == start || adj[tail-1] != p.first) {
+              adj[tail] = p.first;
+              data[tail] = p.second;
+              tail++;
+            } else {
+              combine(data[tail-1], p.second);
+            }
+          }
+        }
+        Vertex& v = vertex(i);
+        v.local_adj = adj + start;
+        v.nadj = tail - start;
+        v.local_sz = v.nadj;
+      }
+      g->nadj_local = tail;
+      g->adj_buf = adj;
+      VLOG(2) << "nadj_local = " << g->nadj_local;
+      
+      g->edge_storage = locale_alloc<EdgeState>(g->nadj_local);
+      g->edge_slots_local = g->nadj_local;
+      for (size_t i=0; i<g->nadj_local; i++) {
+        if (with_data) impl::init_edge_state(g->edge_storage+i, data[i]);
+        else new (g->edge_storage+i) EdgeState();
+      }
+      for (size_t i = 0; i < nlocal+nm; i++) {
+        Vertex& v = vertex(i);
+        v.local_edge_state = g->edge_storage + (v.local_adj - adj);
+      }
+      
+      g->nadj = allreduce<int64_t,collective_add>(g->nadj_local);
+    });
+    shuffle->destroy();
+    hubs->destroy();
+    VLOG(2) << "local_build_time: " << walltime() - t;
+    
+    if (split_degree > 0) {
+      // register mirrors with their masters
+      t = walltime();
+      auto regs = impl::Shuffle<impl::MirrorReg>::create();
+      on_all_cores([g,regs]{
+        for (int64_t k = 0; k < g->nmirrors_local; k++) {
+          auto id = g->mirror_ids[k];
+          regs->push((g->vs+id).core(), impl::MirrorReg{ id, mycore(), k, g->mirrors[k].nadj });
+        }
+      });
+      regs->exchange();
+      on_all_cores([g,regs]{
+        auto& recv = regs->received;
+        std::sort(recv.begin(), recv.end(), [](const impl::MirrorReg& a, const impl::MirrorReg& b){
+          return a.id < b.id || (a.id == b.id && a.core < b.core);
+        });
+        for (size_t k = 0; k < recv.size(); ) {
+          auto id = recv[k].id;
+          Vertex& v = *(g->vs+id).pointer();
+          v.split = true;
+          impl::SplitMaster s{ id, v.nadj, static_cast<int64_t>(g->mirror_refs.size()), 0 };
+          for (; k < recv.size() && recv[k].id == id; k++) {
+            s.degree += recv[k].nadj;
+            s.nrefs++;
+            g->mirror_refs.push_back(impl::MirrorRef{ recv[k].core, recv[k].index });
+          }
+          g->splits.push_back(s);
+        }
+        std::vector<impl::MirrorReg>().swap(recv);
+        g->nsplit = allreduce<int64_t,collective_add>(g->splits.size());
+      });
+      regs->destroy();
+      VLOG(1) << "-- split vertices: " << g->nsplit << ", split_time: " << walltime() - t;
+    }
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::build_in_edges(GlobalAddress<Graph> g) {
+    if (!g->directed || g->in_offset) return;
+    double t = walltime();
+    
+    // send (dst, src) for every out-edge to the core of its destination
+    using Record = impl::EdgeRecord<Empty>;
+    auto shuffle = impl::Shuffle<Record>::create();
+    on_all_cores([g,shuffle]{
+      auto push_all = [g,shuffle](VertexID i, Vertex& v){
+        g->for_neighbors(v, 0, v.nadj, [&](int64_t k, VertexID j){
+          shuffle->push((g->vs+j).core(), Record{ j, i });
+        });
+      };
+      for (Vertex& v : iterate_local(g->vs, g->nv)) push_all(make_linear(&v) - g->vs, v);
+      for (int64_t k = 0; k < g->nmirrors_local; k++) push_all(g->mirror_ids[k], g->mirrors[k]);
+    });
+    shuffle->exchange();
+    
+    // counting sort by destination, then sort each vertex's sources
+    on_all_cores([g,shuffle]{
+      auto& recv = shuffle->received;
+      auto local_vs = iterate_local(g->vs, g->nv);
+      Vertex * lv = local_vs.begin();
+      size_t nlocal = local_vs.size();
+      
+      auto offset = locale_alloc<int64_t>(nlocal+1);
+      std::fill(offset, offset+nlocal+1, 0);
+      for (auto& r : recv) offset[(g->vs+r.v0).pointer() - lv + 1]++;
+      for (size_t i = 0; i < nlocal; i++) offset[i+1] += offset[i];
+      
+      auto in_adj = locale_alloc<VertexID>(recv.size());
+      {
+        std::vector<int64_t> pos(offset, offset+nlocal);
+        for (auto& r : recv) in_adj[pos[(g->vs+r.v0).pointer() - lv]++] = r.v1;
+      }
+      for (size_t i = 0; i < nlocal; i++) std::sort(in_adj+offset[i], in_adj+offset[i+1]);
+      std::vector<Record>().swap(recv);
+      
+      g->in_offset = offset;
+      g->in_adj_buf = in_adj;
+    });
+    shuffle->destroy();
+    VLOG(2) << "in_edges_time: " << walltime() - t;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::stage_updates(GlobalAddress<Graph> g, const TupleGraph& batch, bool insert) {
+    CHECK(!g->compressed()) << "edge updates need uncompressed adjacency (see --graph_compress_adj)";
+    CHECK_EQ(g->nsplit, 0) << "edge updates aren't supported on vertex-cut graphs";
+    auto shuffle = impl::Shuffle<impl::EdgeUpdate>::create();
+    auto seq = g->update_seq;
+    forall(batch.edges, batch.nedge, [g,shuffle,seq,insert](TupleGraph::Edge& e){
+      CHECK(e.v0 >= 0 && e.v0 < g->orig_nv && e.v1 >= 0 && e.v1 < g->orig_nv)
+          << "edge (" << e.v0 << "," << e.v1 << ") is outside the graph's vertices";
+      VertexID u = g->vertex_id(e.v0), v = g->vertex_id(e.v1);
+      shuffle->push((g->vs+u).core(), impl::EdgeUpdate{ u, v, seq, insert });
+      if (!g->directed) shuffle->push((g->vs+v).core(), impl::EdgeUpdate{ v, u, seq, insert });
+    });
+    shuffle->exchange();
+    on_all_cores([g,shuffle]{
+      auto& recv = shuffle->received;
+      g->pending.insert(g->pending.end(), recv.begin(), recv.end());
+      std::vector<impl::EdgeUpdate>().swap(recv);
+      g->update_seq++;
+    });
+    shuffle->destroy();
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::set_local_adj(Vertex& v, const std::vector<VertexID>& adj,
+                                 const std::vector<E>& data) {
+    int64_t n = adj.size();
+    if (n > v.local_sz) {
+      int64_t cap = std::max<int64_t>(4, 2*n);
+      impl::AdjBlock<E> b{ locale_alloc<VertexID>(cap), locale_alloc<E>(cap), cap };
+      for (int64_t i = 0; i < cap; i++) new (b.edges+i) E();
+      overflow.push_back(b);
+      overflow_edges += cap;
+      v.local_adj = b.adj;
+      v.local_edge_state = b.edges;
+      v.local_sz = cap;
+    }
+    std::copy(adj.begin(), adj.end(), v.local_adj);
+    std::copy(data.begin(), data.end(), v.local_edge_state);
+    nadj_local += n - v.nadj;
+    v.nadj = n;
+    if (n > 0) v.valid = true;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::compact_local() {
+    auto local_vs = iterate_local(vs, nv);
+    auto slot = [](int64_t n){ return n + static_cast<int64_t>(n * FLAGS_graph_update_slack); };
+    int64_t total = 0;
+    for (Vertex& v : local_vs) total += slot(v.nadj);
+    
+    auto adj = locale_alloc<VertexID>(total);
+    auto edges = locale_alloc<EdgeState>(total);
+    int64_t offset = 0;
+    for (Vertex& v : local_vs) {
+      int64_t sz = slot(v.nadj);
+      std::copy(v.local_adj, v.local_adj + v.nadj, adj + offset);
+      for (int64_t i = 0; i < sz; i++) {
+        if (i < v.nadj) new (edges+offset+i) EdgeState(v.local_edge_state[i]);
+        else new (edges+offset+i) EdgeState();
+      }
+      v.local_adj = adj + offset;
+      v.local_edge_state = edges + offset;
+      v.local_sz = sz;
+      offset += sz;
+    }
+    
+    for (int64_t i = 0; i < edge_slots_local; i++) edge_storage[i].~E();
+    if (edge_storage) locale_free(edge_storage);
+    if (adj_buf) locale_free(adj_buf);
+    free_overflow();
+    adj_buf = adj;
+    edge_storage = edges;
+    edge_slots_local = total;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::commit(GlobalAddress<Graph> g) {
+    double t = walltime();
+    auto gained = impl::Shuffle<VertexID>::create();
+    on_all_cores([g,gained]{
+      auto& up = g->pending;
+      std::sort(up.begin(), up.end(), [](const impl::EdgeUpdate& a, const impl::EdgeUpdate& b){
+        return std::tie(a.src, a.dst, a.seq) < std::tie(b.src, b.dst, b.seq);
+      });
+      
+      // merge each vertex's sorted neighbors with its (sorted) updates
+      std::vector<VertexID> adj;
+      std::vector<E> data;
+      for (size_t k = 0; k < up.size(); ) {
+        auto src = up[k].src;
+        Vertex& v = *(g->vs+src).pointer();
+        adj.clear();
+        data.clear();
+        int64_t i = 0;
+        for (; k < up.size() && up[k].src == src; k++) {
+          auto dst = up[k].dst;
+          if (k+1 < up.size() && up[k+1].src == src && up[k+1].dst == dst) continue;
+          // (last update of this edge)
+          for (; i < v.nadj && v.local_adj[i] < dst; i++) {
+            adj.push_back(v.local_adj[i]);
+            data.push_back(v.local_edge_state[i]);
+          }
+          bool had = (i < v.nadj && v.local_adj[i] == dst);
+          if (up[k].insert) {
+            adj.push_back(dst);
+            data.push_back(had ? v.local_edge_state[i] : E());
+            if (!had) gained->push((g->vs+dst).core(), dst);
+          }
+          if (had) i++;
+        }
+        for (; i < v.nadj; i++) {
+          adj.push_back(v.local_adj[i]);
+          data.push_back(v.local_edge_state[i]);
+        }
+        g->set_local_adj(v, adj, data);
+      }
+      std::vector<impl::EdgeUpdate>().swap(up);
+      
+      if (g->overflow_edges > FLAGS_graph_update_slack * g->edge_slots_local) g->compact_local();
+    });
+    gained->exchange();
+    on_all_cores([g,gained]{
+      for (auto j : gained->received) (g->vs+j).pointer()->valid = true;
+      g->nadj = allreduce<int64_t,collective_add>(g->nadj_local);
+    });
+    gained->destroy();
+    
+    if (g->in_offset) {
+      on_all_cores([g]{
+        locale_free(g->in_offset);
+        locale_free(g->in_adj_buf);
+        g->in_offset = nullptr;
+        g->in_adj_buf = nullptr;
+      });
+      build_in_edges(g);
+    }
+    VLOG(1) << "committed edge updates, nadj: " << g->nadj << ", commit_time: " << walltime() - t;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::save(const std::string& path) {
+    static_assert(std::is_trivially_copyable<V>::value && std::is_trivially_copyable<E>::value,
+                  "Graph::save() writes vertex and edge data as raw bytes");
+    CHECK_EQ(nsplit, 0) << "Graph::save() doesn't support vertex-cut graphs";
+    double t = walltime();
+    try {
+      fs::create_directories(path);
+    } catch (fs::filesystem_error& e) {
+      LOG(ERROR) << "filesystem error: " << e.what();
+    }
+    
+    auto g = self;
+    impl::GraphFileHeader h = {};
+    h.magic = impl::graph_file_magic;
+    h.version = 1;
+    h.cores = cores();
+    h.nv = nv;
+    h.nadj = nadj;
+    h.orig_nv = orig_nv;
+    h.vertex_data_size = sizeof(V);
+    h.edge_data_size = sizeof(E);
+    h.directed = directed;
+    h.relabeled = relabeled;
+    h.in_edges = has_in_edges();
+    {
+      impl::SnapshotFile fo(path + "/graph.meta", "w");
+      fo.write(&h, sizeof(h));
+    }
+    
+    CHECK_LE(path.size(), impl::graph_path_max) << "Graph snapshot path too long: " << path;
+    File f(path.c_str(), true);
+    on_all_cores([g,f]{
+      auto local_vs = iterate_local(g->vs, g->nv);
+      Vertex * lv = local_vs.begin();
+      int64_t nlocal = local_vs.size();
+      Core p = (mycore() - g->vs.core() + cores()) % cores();
+      
+      impl::SnapshotFile fo(impl::graph_part_path(f.fname, p), "w");
+      int64_t counts[2] = { nlocal, g->nadj_local };
+      fo.write(counts, sizeof(counts));
+      
+      std::vector<int64_t> nadj(nlocal);
+      std::vector<uint8_t> valid(nlocal);
+      for (int64_t k = 0; k < nlocal; k++) {
+        nadj[k] = lv[k].nadj;
+        valid[k] = lv[k].valid;
+      }
+      fo.write(nadj.data(), sizeof(int64_t)*nlocal);
+      fo.write(valid.data(), nlocal);
+      for (int64_t k = 0; k < nlocal; k++) fo.write(&lv[k].data, sizeof(V));
+      
+      if (g->relabeled) {
+        std::vector<VertexID> orig(nlocal);
+        Grappa::forall_here(0, nlocal, [g,lv,&orig](int64_t k){
+          orig[k] = delegate::read(g->orig_ids + (make_linear(lv+k) - g->vs));
+        });
+        fo.write(orig.data(), sizeof(VertexID)*nlocal);
+      }
+      
+      std::vector<VertexID> adj;
+      adj.reserve(g->nadj_local);
+      for (int64_t k = 0; k < nlocal; k++) {
+        g->for_neighbors(lv[k], 0, lv[k].nadj, [&adj](int64_t i, VertexID j){ adj.push_back(j); });
+      }
+      fo.write(adj.data(), sizeof(VertexID)*adj.size());
+      for (int64_t k = 0; k < nlocal; k++) {
+        fo.write(lv[k].local_edge_state, sizeof(E)*lv[k].nadj);
+      }
+    });
+    VLOG(1) << "saved graph to " << path << ", save_time: " << walltime() - t;
+  }
+  
+  template< typename V, typename E >
+  void Graph<V,E>::load_local(GlobalAddress<Graph> g, const int64_t * nadj, const uint8_t * valid,
+                              const char * data, VertexID * adj, EdgeState * edges,
+                              int64_t nadj_local) {
+    auto local_vs = iterate_local(g->vs, g->nv);
+    Vertex * lv = local_vs.begin();
+    int64_t offset = 0;
+    for (size_t k = 0; k < local_vs.size(); k++) {
+      Vertex& v = lv[k];
+      v.local_adj = adj + offset;
+      v.local_edge_state = edges + offset;
+      v.nadj = nadj[k];
+      v.local_sz = v.nadj;
+      v.valid = valid[k];
+      std::memcpy(&v.data, data + k*sizeof(V), sizeof(V));
+      offset += v.nadj;
+    }
+    CHECK_EQ(offset, nadj_local) << "corrupt Graph snapshot";
+    g->adj_buf = adj;
+    g->edge_storage = edges;
+    g->edge_slots_local = nadj_local;
+    g->nadj_local = nadj_local;
+  }
+  
+  template< typename V, typename E >
+  GlobalAddress<Graph<V,E>> Graph<V,E>::load(const std::string& path) {
+    static_assert(std::is_trivially_copyable<V>::value && std::is_trivially_copyable<E>::value,
+                  "Graph::load() reads vertex and edge data as raw bytes");
+    double t = walltime();
+    impl::GraphFileHeader h;
+    {
+      CHECK(fs::exists(path + "/graph.meta")) << "unable to open Graph snapshot: " << path;
+      impl::SnapshotFile fi(path + "/graph.meta", "r");
+      fi.read(&h, sizeof(h));
+    }
+    CHECK_EQ(h.magic, impl::graph_file_magic) << path << " is not a Graph snapshot";
+    CHECK_EQ(h.version, 1);
+    CHECK_EQ(h.vertex_data_size, sizeof(V)) << "snapshot's vertex data doesn't match this Graph";
+    CHECK_EQ(h.edge_data_size, sizeof(E)) << "snapshot's edge data doesn't match this Graph";
+    
+    auto g = symmetric_global_alloc<Graph>();
+    auto vs = global_alloc<Vertex>(h.nv);
+    GlobalAddress<VertexID> orig_ids, new_ids;
+    if (h.relabeled) {
+      orig_ids = global_alloc<VertexID>(h.nv);
+      new_ids = global_alloc<VertexID>(h.orig_nv);
+    }
+    on_all_cores([g,vs,h,orig_ids,new_ids]{
+      new (g.localize()) Graph(g, vs, h.nv);
+      g->directed = h.directed;
+      g->relabeled = h.relabeled;
+      g->orig_nv = h.orig_nv;
+      g->orig_ids = orig_ids;
+      g->new_ids = new_ids;
+      g->nadj = h.nadj;
+      for (Vertex& v : iterate_local(g->vs, g->nv)) {
+        new (&v) Vertex();
+      }
+    });
+    
+    // fill in the id maps from each local vertex's original id
+    auto set_orig = [g](Vertex * lv, const VertexID * orig, int64_t nlocal){
+      Grappa::forall_here(0, nlocal, [g,lv,orig](int64_t k){
+        VertexID i = make_linear(lv+k) - g->vs;
+        delegate::write(g->orig_ids+i, orig[k]);
+        if (orig[k] >= 0) delegate::write(g->new_ids+orig[k], i);
+      });
+    };
+    
+    CHECK_LE(path.size(), impl::graph_path_max) << "Graph snapshot path too long: " << path;
+    File f(path.c_str(), true);
+    if (h.cores == cores()) {
+      // each core reads its own part straight into place
+      on_all_cores([g,f,h,set_orig]{
+        auto local_vs = iterate_local(g->vs, g->nv);
+        int64_t nlocal = local_vs.size();
+        Core p = (mycore() - g->vs.core() + cores()) % cores();
+        
+        auto fname = impl::graph_part_path(f.fname, p);
+        CHECK(fs::exists(fname)) << "missing Graph snapshot part " << p;
+        impl::SnapshotFile fi(fname, "r");
+        int64_t counts[2];
+        fi.read(counts, sizeof(counts));
+        CHECK_EQ(counts[0], nlocal) << "corrupt Graph snapshot";
+        
+        std::vector<int64_t> nadj(nlocal);
+        std::vector<uint8_t> valid(nlocal);
+        std::vector<char> data(nlocal*sizeof(V));
+        fi.read(nadj.data(), sizeof(int64_t)*nlocal);
+        fi.read(valid.data(), nlocal);
+        fi.read(data.data(), data.size());
+        if (h.relabeled) {
+          std::vector<VertexID> orig(nlocal);
+          fi.read(orig.data(), sizeof(VertexID)*nlocal);
+          set_orig(local_vs.begin(), orig.data(), nlocal);
+        }
+        auto adj = locale_alloc<VertexID>(counts[1]);
+        auto edges = locale_alloc<EdgeState>(counts[1]);
+        fi.read(adj, sizeof(VertexID)*counts[1]);
+        fi.read(edges, sizeof(EdgeState)*counts[1]);
+        load_local(g, nadj.data(), valid.data(), data.data(), adj, edges, counts[1]);
+      });
+    } else {
+      // different number of cores: read the parts in parallel and repartition them in bulk
+      using SavedVertex = impl::SavedVertex<V>;
+      using SavedEdge = impl::SavedEdge<E>;
+      auto vshuffle = impl::Shuffle<SavedVertex>::create();
+      auto eshuffle = impl::Shuffle<SavedEdge>::create();
+      on_all_cores([g,f,h,vshuffle,eshuffle]{
+        for (int64_t p = mycore(); p < h.cores; p += cores()) {
+          auto fname = impl::graph_part_path(f.fname, p);
+          CHECK(fs::exists(fname)) << "missing Graph snapshot part " << p;
+          impl::SnapshotFile fi(fname, "r");
+          int64_t counts[2];
+          fi.read(counts, sizeof(counts));
+          int64_t n = counts[0], m = counts[1];
+          
+          std::vector<int64_t> nadj(n);
+          std::vector<uint8_t> valid(n);
+          std::vector<V> data(n);
+          std::vector<VertexID> orig(n, -1), adj(m);
+          std::vector<E> edges(m);
+          fi.read(nadj.data(), sizeof(int64_t)*n);
+          fi.read(valid.data(), n);
+          fi.read(data.data(), sizeof(V)*n);
+          if (h.relabeled) fi.read(orig.data(), sizeof(VertexID)*n);
+          fi.read(adj.data(), sizeof(VertexID)*m);
+          fi.read(edges.data(), sizeof(E)*m);
+          
+          int64_t offset = 0;
+          for (int64_t k = 0; k < n; k++) {
+            VertexID id = p + k*h.cores;
+            Core dest = (g->vs+id).core();
+            vshuffle->push(dest, SavedVertex{ id, orig[k], nadj[k], valid[k] != 0, data[k] });
+            for (int64_t i = offset; i < offset+nadj[k]; i++) {
+              eshuffle->push(dest, SavedEdge{ id, adj[i], edges[i] });
+            }
+            offset += nadj[k];
+          }
+        }
+      });
+      vshuffle->exchange();
+      eshuffle->exchange();
+      
+      on_all_cores([g,h,vshuffle,eshuffle,set_orig]{
+        auto local_vs = iterate_local(g->vs, g->nv);
+        int64_t nlocal = local_vs.size();
+        auto& vrecv = vshuffle->received;
+        auto& erecv = eshuffle->received;
+        CHECK_EQ(vrecv.size(), nlocal) << "corrupt Graph snapshot";
+        std::sort(vrecv.begin(), vrecv.end(), [](const SavedVertex& a, const SavedVertex& b){
+          return a.id < b.id;
+        });
+        std::sort(erecv.begin(), erecv.end(), [](const SavedEdge& a, const SavedEdge& b){
+          return a.src < b.src || (a.src == b.src && a.dst < b.dst);
+        });
+        
+        std::vector<int64_t> nadj(nlocal);
+        std::vector<uint8_t> valid(nlocal);
+        std::vector<char> data(nlocal*sizeof(V));
+        std::vector<VertexID> orig(nlocal);
+        for (int64_t k = 0; k < nlocal; k++) {
+          nadj[k] = vrecv[k].nadj;
+          valid[k] = vrecv[k].valid;
+          std::memcpy(&data[k*sizeof(V)], &vrecv[k].data, sizeof(V));
+          orig[k] = vrecv[k].orig;
+        }
+        if (h.relabeled) set_orig(local_vs.begin(), orig.data(), nlocal);
+        std::vector<SavedVertex>().swap(vrecv);
+        
+        int64_t m = erecv.size();
+        auto adj = locale_alloc<VertexID>(m);
+        auto edges = locale_alloc<EdgeState>(m);
+        for (int64_t i = 0; i < m; i++) {
+          adj[i] = erecv[i].dst;
+          std::memcpy(edges+i, &erecv[i].data, sizeof(E));
+        }
+        std::vector<SavedEdge>().swap(erecv);
+        load_local(g, nadj.data(), valid.data(), data.data(), adj, edges, m);
+      });
+      vshuffle->destroy();
+      eshuffle->destroy();
+    }
+    VLOG(1) << "loaded graph from " << path << " (saved on " << h.cores << " cores), load_time: "
+            << walltime() - t;
+    
+    if (h.in_edges) build_in_edges(g);
+    if (FLAGS_graph_compress_adj) compress_adj(g);
     return g;
   }
   
+  template< typename V, typename E >
+  void Graph<V,E>::compress_adj(GlobalAddress<Graph> g) {
+    if (g->compressed()) return;
+    double t = walltime();
+    on_all_cores([g]{
+      auto local_vs = iterate_local(g->vs, g->nv);
+      size_t nlocal = local_vs.size();
+      size_t n = nlocal + g->nmirrors_local;
+      auto vertex = [g,&local_vs,nlocal](size_t i) -> Vertex& {
+        return (i < nlocal) ? local_vs.begin()[i] : g->mirrors[i-nlocal];
+      };
+      
+      std::vector<uint8_t> bytes;
+      std::vector<int64_t> blocks;
+      auto first = locale_alloc<int64_t>(n+1);
+      for (size_t i = 0; i < n; i++) {
+        Vertex& v = vertex(i);
+        first[i] = blocks.size();
+        for (int64_t k = 0; k < v.nadj; k++) {
+          if (k % impl::cadj_block == 0) {
+            blocks.push_back(bytes.size());
+            impl::put_varint(bytes, v.local_adj[k]);
+          } else {
+            DCHECK_GT(v.local_adj[k], v.local_adj[k-1]) << "adjacency must be sorted & unique";
+            impl::put_varint(bytes, v.local_adj[k] - v.local_adj[k-1]);
+          }
+        }
+      }
+      first[n] = blocks.size();
+      
+      g->cadj = locale_alloc<uint8_t>(bytes.size()+1);
+      std::copy(bytes.begin(), bytes.end(), g->cadj);
+      g->cadj_blocks = locale_alloc<int64_t>(blocks.size()+1);
+      std::copy(blocks.begin(), blocks.end(), g->cadj_blocks);
+      g->cadj_first_block = first;
+      
+      for (size_t i = 0; i < n; i++) vertex(i).local_adj = nullptr;
+      if (g->adj_buf) locale_free(g->adj_buf);
+      g->adj_buf = nullptr;
+      
+      g->cadj_bytes = allreduce<int64_t,collective_add>(
+          bytes.size() + sizeof(int64_t)*(blocks.size() + n + 1));
+    });
+    VLOG(1) << "-- compressed adjacency: " << static_cast<double>(g->cadj_bytes) / std::max<int64_t>(g->nadj,1)
+            << " bytes/edge, compress_time: " << walltime() - t;
+  }
+  
   /// @}
 } // namespace Grappa
@@ -25,6 +25,7 @@
 #include <Grappa.hpp>
 #include <graph/Graph.hpp>
 #include <GlobalVector.hpp>
+#include "../../applications/nativegraph/verifier.hpp"
 
 BOOST_AUTO_TEST_SUITE( Graph_tests );
 
@@ -41,6 +42,15 @@ struct EData {
 
 using MyGraph = Graph<VData,EData>;
 
+struct BFSData {
+  int64_t parent, level;
+  bool seen;
+};
+
+using BFSGraph = Graph<BFSData,Empty>;
+
+int64_t nedge_traversed;
+
 GlobalCompletionEvent c;
 
 int64_t count;
@@ -50,6 +60,33 @@ DEFINE_int32(scale, 10, "Log2 number of vertices.");
 GRAPPA_DEFINE_METRIC(SummarizingMetric<int64_t>, degree, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, edge_weight, 0);
 
+/// Level-synchronous BFS from the first input edge's source, checked with the apps'
+/// verifier (which walks `tg` by its original ids).
+void bfs_and_verify(TupleGraph tg, GlobalAddress<BFSGraph> g) {
+  forall(g, [](BFSGraph::Vertex& v){ v->parent = -1; v->level = -1; v->seen = false; });
+  auto root = g->vertex_id(delegate::read(tg.edges).v0);
+  delegate::call(g->vs+root, [root](BFSGraph::Vertex& v){ v->parent = root; v->level = 0; });
+  
+  for (int64_t level = 0; ; level++) {
+    call_on_all_cores([]{ count = 0; });
+    forall(g, [g,level](VertexID i, BFSGraph::Vertex& v){
+      if (v->level != level) return;
+      forall<async>(adj(g,v), [i,level](BFSGraph::Edge& e){
+        delegate::call<async>(e.ga, [i,level](BFSGraph::Vertex& w){
+          if (w->parent == -1) {
+            w->parent = i;
+            w->level = level+1;
+            count++;
+          }
+        });
+      });
+    });
+    if (reduce<int64_t,collective_add>(&count) == 0) break;
+  }
+  
+  BOOST_CHECK(VerificatorBase<BFSGraph>::verify(tg, g, root) > 0);
+}
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   init( GRAPPA_TEST_ARGS );
   run([]{
@@ -165,6 +202,299 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       count += (total > 0);
     });
     
+    ///////////////////////////////////////////////////////////
+    // bulk and per-edge construction must give the same graph
+    FLAGS_graph_bulk_create = false;
+    auto gs = MyGraph::create(tg);
+    FLAGS_graph_bulk_create = true;
+    BOOST_CHECK_EQUAL(gs->nadj, g->nadj);
+    forall(g, [gs](VertexID i, MyGraph::Vertex& v){
+      std::vector<VertexID> mine(v.local_adj, v.local_adj+v.nadj);
+      auto theirs = delegate::call(gs->vs+i, [](MyGraph::Vertex& w){
+        int64_t sum = 0;
+        for (int64_t k = 0; k < w.nadj; k++) sum += w.local_adj[k] * (k+1);
+        return std::make_pair(w.nadj, sum);
+      });
+      int64_t sum = 0;
+      for (size_t k = 0; k < mine.size(); k++) sum += mine[k] * (k+1);
+      BOOST_CHECK_EQUAL(v.nadj, theirs.first);
+      BOOST_CHECK_EQUAL(sum, theirs.second);
+    });
+    gs->destroy();
+    
+    ////////////////////////////////////////////////
+    // edge data imported from TupleGraph payloads
+    tg.init_payload<double>();
+    forall(tg.edges, tg.nedge, [tg](TupleGraph::Edge& e){
+      tg.payload<double>(e) = std::max(e.v0, e.v1) + 0.5 * (e.v0 < e.v1);
+    });
+    auto gw = MyGraph::create<double>(tg, EdgeCombine::Max());
+    BOOST_CHECK_EQUAL(gw->nadj, g->nadj);
+    forall(gw, [gw](VertexID i, MyGraph::Vertex& v){
+      for (int64_t k = 0; k < v.nadj; k++) {
+        auto e = gw->edge(v, k);
+        // largest of (i,j) and (j,i), whichever were in the input
+        auto w = e->weight - std::max(i, e.id);
+        BOOST_CHECK(w == 0.0 || w == 0.5);
+      }
+    });
+    gw->destroy();
+    
+    /////////////////////////////////////////////////////
+    // incoming-edge index must invert the out-edges
+    auto gd = MyGraph::Directed(tg, true);
+    BOOST_CHECK(gd->has_in_edges());
+    call_on_all_cores([]{ count = 0; });
+    forall(gd, [gd](VertexID i, MyGraph::Vertex& v){
+      forall<async>(in_adj(gd,v), [gd,i](VertexID src){
+        count++;
+        // (i) must appear in src's sorted out-edges
+        bool found = delegate::call(gd->vs+src, [i](MyGraph::Vertex& s){
+          return std::binary_search(s.local_adj, s.local_adj+s.nadj, i);
+        });
+        BOOST_CHECK(found);
+      });
+    });
+    total = reduce<int64_t,collective_add>(&count);
+    BOOST_CHECK_EQUAL(total, gd->nadj);
+    gd->destroy();
+    
+    ////////////////////////////////////////////////////////////////
+    // partitioned placements & locality orderings must be the same graph, renumbered
+    auto tuple_sum = [&tg]{
+      return sum_all_cores([tg]{
+        int64_t sum = 0;
+        for (auto& e : iterate_local(tg.edges, tg.nedge)) sum += e.v0 * 3 + e.v1;
+        return sum;
+      });
+    };
+    auto tsum = tuple_sum();
+    std::vector<std::pair<std::string,std::string>> layouts = {
+      {"block","none"}, {"degree","none"}, {"hash","none"},
+      {"cyclic","degree"}, {"cyclic","rcm"}, {"block","rcm"}, {"cyclic","hub"}
+    };
+    for (auto& layout : layouts) {
+      FLAGS_graph_partition = layout.first;
+      FLAGS_graph_order = layout.second;
+      auto gp = MyGraph::create(tg);
+      auto gb = BFSGraph::create(tg);
+      FLAGS_graph_partition = "cyclic";
+      FLAGS_graph_order = "none";
+      BOOST_CHECK_EQUAL(tuple_sum(), tsum);
+      BOOST_CHECK_EQUAL(gp->nadj, g->nadj);
+      BOOST_CHECK(graph_edge_imbalance.value() >= 1.0);
+      forall(gp, [g,gp](VertexID i, MyGraph::Vertex& v){
+        auto orig = gp->original_id(i);
+        BOOST_CHECK(orig >= 0);
+        BOOST_CHECK_EQUAL(gp->vertex_id(orig), i);
+        int64_t sum = 0;
+        for (int64_t k = 0; k < v.nadj; k++) sum += gp->original_id(v.local_adj[k]);
+        auto theirs = delegate::call(g->vs+orig, [](MyGraph::Vertex& w){
+          int64_t sum = 0;
+          for (int64_t k = 0; k < w.nadj; k++) sum += w.local_adj[k];
+          return std::make_pair(w.nadj, sum);
+        });
+        BOOST_CHECK_EQUAL(v.nadj, theirs.first);
+        BOOST_CHECK_EQUAL(sum, theirs.second);
+      });
+      gp->destroy();
+      
+      // the apps' verifiers must find the renumbered vertices
+      bfs_and_verify(tg, gb);
+      gb->destroy();
+    }
+    
+    ///////////////////////////////////////////////////////////////
+    // vertex-cut: same edges, some of them held by mirrors
+    FLAGS_graph_split_degree = 64;
+    auto gc = MyGraph::create(tg);
+    FLAGS_graph_split_degree = 0;
+    BOOST_CHECK(gc->nsplit > 0);
+    BOOST_CHECK_EQUAL(gc->nadj, g->nadj);
+    
+    auto esum = global_alloc<int64_t>(g->nv);
+    Grappa::memset(esum, 0, g->nv);
+    forall(gc, [gc,esum](MyGraph::Vertex& v, MyGraph::Edge& e){
+      delegate::increment<async>(esum + gc->id(v), e.id);
+    });
+    forall(g, [gc,esum](VertexID i, MyGraph::Vertex& v){
+      int64_t sum = 0;
+      for (int64_t k = 0; k < v.nadj; k++) sum += v.local_adj[k];
+      BOOST_CHECK_EQUAL(delegate::read(esum+i), sum);
+      auto d = delegate::call(gc->vs+i, [gc](MyGraph::Vertex& w){ return gc->degree(w); });
+      BOOST_CHECK_EQUAL(d, v.nadj);
+    });
+    
+    // per-vertex iteration over a split vertex also visits its mirrors' edges
+    Grappa::memset(esum, 0, g->nv);
+    forall(gc, [gc,esum](VertexID i, MyGraph::Vertex& v){
+      forall<async>(adj(gc,v), [esum,i](MyGraph::Edge& e){
+        delegate::increment<async>(esum + i, e.id);
+      });
+    });
+    forall(g, [esum](VertexID i, MyGraph::Vertex& v){
+      int64_t sum = 0;
+      for (int64_t k = 0; k < v.nadj; k++) sum += v.local_adj[k];
+      BOOST_CHECK_EQUAL(delegate::read(esum+i), sum);
+    });
+    // ...and so does iteration over its (undirected) incoming edges
+    Grappa::memset(esum, 0, g->nv);
+    forall(gc, [gc,esum](VertexID i, MyGraph::Vertex& v){
+      forall<async>(in_adj(gc,v), [esum,i](VertexID src){
+        delegate::increment<async>(esum + i, src);
+      });
+    });
+    forall(g, [esum](VertexID i, MyGraph::Vertex& v){
+      int64_t sum = 0;
+      for (int64_t k = 0; k < v.nadj; k++) sum += v.local_adj[k];
+      BOOST_CHECK_EQUAL(delegate::read(esum+i), sum);
+    });
+    global_free(esum);
+    
+    // masters' data reaches mirrors, and mirrors' data folds back
+    forall(gc, [gc](VertexID i, MyGraph::Vertex& v){ v->parent = i; });
+    gc->broadcast_to_mirrors();
+    forall(gc, [gc](MyGraph::Vertex& v, MyGraph::Edge& e){
+      BOOST_CHECK_EQUAL(v->parent, gc->id(v));
+    });
+    forall(gc, [](MyGraph::Vertex& v){ v->parent = 0; });
+    on_all_cores([gc]{
+      for (int64_t k = 0; k < gc->nmirrors_local; k++) gc->mirrors[k]->parent = 1;
+    });
+    gc->gather_to_masters([](MyGraph::Vertex& m, const VData& d){ m->parent += d.parent; });
+    auto nmirrors = sum_all_cores([gc]{ return gc->nmirrors_local; });
+    call_on_all_cores([]{ count = 0; });
+    forall(gc, [](MyGraph::Vertex& v){ count += v->parent; });
+    total = reduce<int64_t,collective_add>(&count);
+    BOOST_CHECK_EQUAL(total, nmirrors);
+    gc->destroy();
+
+    ///////////////////////////////////////////////////////////////
+    // compressed adjacency: same neighbors, sequentially and by index
+    FLAGS_graph_compress_adj = true;
+    auto gz = MyGraph::create(tg);
+    FLAGS_graph_compress_adj = false;
+    BOOST_CHECK(gz->compressed());
+    BOOST_CHECK_EQUAL(gz->nadj, g->nadj);
+
+    auto zsum = global_alloc<int64_t>(g->nv);
+    Grappa::memset(zsum, 0, g->nv);
+    forall(gz, [gz,zsum](MyGraph::Vertex& v, MyGraph::Edge& e){
+      delegate::increment<async>(zsum + gz->id(v), e.id);
+    });
+    forall(g, [gz,zsum](VertexID i, MyGraph::Vertex& v){
+      int64_t sum = 0;
+      for (int64_t k = 0; k < v.nadj; k++) sum += v.local_adj[k];
+      BOOST_CHECK_EQUAL(delegate::read(zsum+i), sum);
+      std::vector<VertexID> mine(v.local_adj, v.local_adj+v.nadj);
+      auto same = delegate::call(gz->vs+i, [gz,mine](MyGraph::Vertex& w){
+        if (w.nadj != mine.size()) return false;
+        for (int64_t k = 0; k < w.nadj; k++) {
+          if (gz->neighbor(w, k) != mine[k]) return false;
+        }
+        return true;
+      });
+      BOOST_CHECK(same);
+    });
+    global_free(zsum);
+    gz->destroy();
+
+    ///////////////////////////////////////////////////////////////
+    // binary snapshot: save & load must give back the same graph
+    auto snapshot = (fs::temp_directory_path() / fs::unique_path("graph-%%%%%%")).string();
+    forall(g, [](VertexID i, MyGraph::Vertex& v){ v->parent = i; });
+    forall(g, [](MyGraph::Vertex& v, MyGraph::Edge& e){ e->weight = e.id; });
+    g->save(snapshot);
+    auto gl = MyGraph::load(snapshot);
+    fs::remove_all(snapshot);
+    BOOST_CHECK_EQUAL(gl->nv, g->nv);
+    BOOST_CHECK_EQUAL(gl->nadj, g->nadj);
+    forall(g, [gl](VertexID i, MyGraph::Vertex& v){
+      int64_t sum = 0;
+      for (int64_t k = 0; k < v.nadj; k++) sum += v.local_adj[k] * (k+1);
+      auto theirs = delegate::call(gl->vs+i, [gl](MyGraph::Vertex& w){
+        int64_t sum = 0;
+        bool ok = true;
+        for (int64_t k = 0; k < w.nadj; k++) {
+          auto e = gl->edge(w, k);
+          sum += e.id * (k+1);
+          ok = ok && (e->weight == e.id) && (w->parent == gl->id(w));
+        }
+        return std::make_tuple(w.nadj, sum, ok && w.valid);
+      });
+      BOOST_CHECK_EQUAL(std::get<0>(theirs), v.nadj);
+      BOOST_CHECK_EQUAL(std::get<1>(theirs), sum);
+      BOOST_CHECK(std::get<2>(theirs) == v.valid);
+    });
+    gl->destroy();
+
+    ///////////////////////////////////////////////////////////////
+    // batched edge updates must match building the result from scratch
+    auto same_edges = [](GlobalAddress<MyGraph> a, GlobalAddress<MyGraph> b){
+      BOOST_CHECK_EQUAL(a->nadj, b->nadj);
+      forall(b, [a](VertexID i, MyGraph::Vertex& v){
+        int64_t sum = 0;
+        for (int64_t k = 0; k < v.nadj; k++) sum += v.local_adj[k] * (k+1);
+        auto theirs = delegate::call(a->vs+i, [](MyGraph::Vertex& w){
+          int64_t sum = 0;
+          for (int64_t k = 0; k < w.nadj; k++) sum += w.local_adj[k] * (k+1);
+          return std::make_pair(w.nadj, sum);
+        });
+        BOOST_CHECK_EQUAL(theirs.first, v.nadj);
+        BOOST_CHECK_EQUAL(theirs.second, sum);
+      });
+    };
+    int64_t nb = 512;
+    TupleGraph batch;
+    batch.edges = global_alloc<TupleGraph::Edge>(nb);
+    batch.nedge = nb;
+    auto gnv = g->nv;
+    forall(batch.edges, nb, [gnv,nb](int64_t i, TupleGraph::Edge& e){
+      e.v0 = hash_mix64(i) % gnv;
+      e.v1 = hash_mix64(i+nb) % gnv;
+    });
+    TupleGraph both;
+    both.edges = global_alloc<TupleGraph::Edge>(tg.nedge + nb);
+    both.nedge = tg.nedge + nb;
+    Grappa::memcpy(both.edges, tg.edges, tg.nedge);
+    Grappa::memcpy(both.edges + tg.nedge, batch.edges, nb);
+
+    auto gu = MyGraph::create(tg);
+    FLAGS_graph_update_slack = 0.0; // (compact on every commit)
+    MyGraph::insert_edges(gu, batch);
+    MyGraph::commit(gu);
+    FLAGS_graph_update_slack = 0.25;
+    auto gb = MyGraph::create(both);
+    same_edges(gu, gb);
+    gb->destroy();
+
+    // later batches win: delete everything, then put the batch's edges back
+    MyGraph::delete_edges(gu, tg);
+    MyGraph::insert_edges(gu, batch);
+    MyGraph::commit(gu);
+    auto gbatch = MyGraph::create(batch);
+    same_edges(gu, gbatch);
+    gbatch->destroy();
+    gu->destroy();
+    global_free(both.edges);
+    global_free(batch.edges);
+
+    ///////////////////////////////////////////////////////////////
+    // chunked tsv parser must read back exactly what was written
+    auto tsv = (fs::temp_directory_path() / fs::unique_path("edges-%%%%%%.tsv")).string();
+    tg.save(tsv, "tsv");
+    auto tt = TupleGraph::Load(tsv, "tsv");
+    fs::remove(tsv);
+    BOOST_CHECK_EQUAL(tt.nedge, tg.nedge);
+    BOOST_CHECK(!tt.has_payload());
+    auto tt_sum = sum_all_cores([tt]{
+      int64_t sum = 0;
+      for (auto& e : iterate_local(tt.edges, tt.nedge)) sum += e.v0 * 3 + e.v1;
+      return sum;
+    });
+    BOOST_CHECK_EQUAL(tt_sum, tsum);
+    tt.destroy();
+
     LOG(INFO) << degree;
     Metrics::merge_and_dump_to_file();
     
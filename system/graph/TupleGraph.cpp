@@ -27,7 +27,12 @@
 #include "ParallelLoop.hpp"
 #include "FileIO.hpp"
 #include "Delegate.hpp"
+#include "Collective.hpp"
+#include "LocaleSharedMemory.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -119,12 +124,143 @@ void local_load_bintsv4( const char * filename,
 
 /// helper method for parallel load of a single file
 static std::vector< Grappa::TupleGraph::Edge > read_edges;
+/// payload bits for each entry of read_edges (text loaders)
+static std::vector< uint64_t > read_payloads;
+/// set if this core read a weight column in a tsv file
+static int64_t read_has_weight = 0;
+
+/// helper for the text loaders: build a TupleGraph from the edges (and
+/// payloads) each core read into its read buffers. Each core copies what fits
+/// straight into its local slice; the rest is shipped in bulk to cores whose
+/// slices have room left, matching surpluses to room in core order (every core
+/// computes the same plan). Expects local_offset to hold each core's read count.
+TupleGraph TupleGraph::place_read_edges( bool with_payload ) {
+  auto nedge = Grappa::reduce<int64_t,collective_add>(&local_offset);
+  
+  TupleGraph tg( nedge );
+  if( with_payload ) tg.init_payload<uint64_t>();
+  auto edges = tg.edges;
+  auto payloads = tg.payloads;
+
+  on_all_cores( [=] {
+      Edge * local_ptr = edges.localize();
+      Edge * local_end = (edges+nedge).localize();
+      int64_t local_count = local_end - local_ptr;
+      int64_t read_count = read_edges.size();
+
+      DVLOG(7) << "local_count " << local_count
+               << " read_count " << read_count;
+      
+      // copy everything in our read buffer that fits locally
+      int64_t local_max = MIN( local_count, read_count );
+      std::memcpy( local_ptr, &read_edges[0], local_max * sizeof(Edge) );
+      if( with_payload ) {
+        std::memcpy( payloads->local, &read_payloads[0], local_max * sizeof(uint64_t) );
+      }
+      
+      // everyone learns each core's surplus and remaining room
+      std::vector<int64_t> extra( 2 * Grappa::cores(), 0 );
+      extra[ Grappa::mycore() ] = read_count - local_max;
+      extra[ Grappa::cores() + Grappa::mycore() ] = local_count - local_max;
+      allreduce_inplace<int64_t,collective_add>( extra.data(), extra.size() );
+      local_offset = local_max; // (where incoming edges start)
+      Grappa::barrier();
+      
+      // send our surplus to the next cores with room, in message-sized chunks
+      const int64_t per_msg = MAX_MESSAGE_SIZE / sizeof(Edge);
+      CompletionEvent ce;
+      auto pce = &ce;
+      Core origin = Grappa::mycore();
+      Core dest = 0;
+      int64_t dest_used = 0;
+      for( Core src = 0; src < Grappa::cores(); src++ ) {
+        int64_t sent = 0;
+        while( sent < extra[src] ) {
+          while( dest_used == extra[ Grappa::cores() + dest ] ) {
+            dest++;
+            dest_used = 0;
+            CHECK_LT( dest, Grappa::cores() ) << "No more space to place edge on cluster?";
+          }
+          int64_t n = MIN( extra[src] - sent, extra[ Grappa::cores() + dest ] - dest_used );
+          if( src == Grappa::mycore() ) {
+            for( int64_t k = 0; k < n; k += per_msg ) {
+              int64_t m = MIN( per_msg, n - k );
+              int64_t from = local_max + sent + k;
+              int64_t at = dest_used + k;
+              ce.enroll( with_payload ? 2 : 1 );
+              // payloads must be in locale shared memory, so stage each chunk there
+              // and free it when the destination acks
+              auto ebuf = locale_alloc<Edge>( m );
+              std::memcpy( ebuf, &read_edges[from], m * sizeof(Edge) );
+              send_heap_message( dest, [edges,at,origin,pce,ebuf]( void * buf, size_t sz ) {
+                  std::memcpy( edges.localize() + local_offset + at, buf, sz );
+                  send_heap_message( origin, [pce,ebuf] {
+                      locale_free( ebuf );
+                      pce->complete();
+                    } );
+                }, ebuf, m * sizeof(Edge) );
+              if( with_payload ) {
+                auto pbuf = locale_alloc<uint64_t>( m );
+                std::memcpy( pbuf, &read_payloads[from], m * sizeof(uint64_t) );
+                send_heap_message( dest, [payloads,at,origin,pce,pbuf]( void * buf, size_t sz ) {
+                    auto local = reinterpret_cast<uint64_t*>( payloads->local );
+                    std::memcpy( local + local_offset + at, buf, sz );
+                    send_heap_message( origin, [pce,pbuf] {
+                        locale_free( pbuf );
+                        pce->complete();
+                      } );
+                  }, pbuf, m * sizeof(uint64_t) );
+              }
+            }
+          }
+          sent += n;
+          dest_used += n;
+        }
+      }
+      ce.wait();
+      
+      // wait for everybody else to fill in our remaining spaces
+      Grappa::barrier();
+      
+      // discard temporary read buffer
+      std::vector< Edge >().swap( read_edges );
+      std::vector< uint64_t >().swap( read_payloads );
+      read_has_weight = 0;
+    } );
+
+  // done!
+  return tg;
+}
+
+/// parse an optionally-signed decimal integer at p into *out; returns the
+/// character after it, or nullptr if there isn't one
+static inline const char * parse_int64( const char * p, int64_t * out ) {
+  bool negative = (*p == '-');
+  if( negative || *p == '+' ) p++;
+  if( *p < '0' || *p > '9' ) return nullptr;
+  int64_t v = 0;
+  while( *p >= '0' && *p <= '9' ) v = v * 10 + (*p++ - '0');
+  *out = negative ? -v : v;
+  return p;
+}
+
+static inline const char * skip_blanks( const char * p ) {
+  while( *p == ' ' || *p == '\t' ) p++;
+  return p;
+}
+
+/// helper method for parallel load of a single file
+///
+/// Each core parses the lines that start in its share of the file's bytes:
+/// it reads that range in bulk (plus the byte before it, to see whether it
+/// starts a line, and whatever it takes to finish its last line), then finds
+/// line ends with memchr and parses the ids by hand.
 TupleGraph TupleGraph::load_tsv( std::string path ) {
   // make sure file exists
   CHECK( fs::exists( path ) ) << "File not found.";
   CHECK( fs::is_regular_file( path ) ) << "File is not a regular file.";
 
-  size_t file_size = fs::file_size( path );
+  int64_t file_size = fs::file_size( path );
 
   size_t path_length = path.size() + 1; // include space for terminator
 
@@ -134,150 +270,79 @@ TupleGraph TupleGraph::load_tsv( std::string path ) {
   char filename[ max_path_length ];
   strncpy( &filename[0], path.c_str(), max_path_length );
 
-  Core mycore = Grappa::mycore();
-  auto bytes_each_core = file_size / Grappa::cores();
-
-  // read into temporary buffer
+  double t = walltime();
+  
+  // parse into temporary buffer
   on_all_cores( [=] {
-      // use standard C++/POSIX IO
-
-      // make one core take any data remaining after truncation
-      auto my_bytes_each_core = bytes_each_core;
-      if( Grappa::mycore() == 0 ) {
-        my_bytes_each_core += file_size - (bytes_each_core * Grappa::cores());
-      }
+      int64_t start_offset = file_size * Grappa::mycore() / Grappa::cores();
+      int64_t end_offset = file_size * (Grappa::mycore()+1) / Grappa::cores();
+      local_offset = 0;
+      if( start_offset == end_offset ) return;
       
-      // compute initial offset into ASCII file
-      // TODO: fix this with scan
-      local_offset = 0; // do on all cores
-      Grappa::barrier();
-      int64_t start_offset = Grappa::delegate::fetch_and_add( make_global( &local_offset, 0 ),
-                                                              my_bytes_each_core );
-      Grappa::barrier();
-      int64_t end_offset = start_offset + my_bytes_each_core;
-
-      DVLOG(7) << "Reading about " << my_bytes_each_core
-               << " bytes starting at " << start_offset
-               << " of " << file_size;
+      auto fd = impl::file_open( filename, "r" );
+      int64_t buf_offset = (start_offset > 0) ? start_offset - 1 : 0;
+      std::vector<char> buf( end_offset - buf_offset );
+      impl::fread_blocking( &buf[0], buf.size(), buf_offset, fd );
       
-      // start reading at start offset
-      std::ifstream infile( filename, std::ios_base::in );
-      infile.seekg( start_offset );
-
+      // finish the last line
+      const int64_t step = 1 << 16;
+      int64_t read_end = end_offset;
+      while( buf.back() != '\n' && read_end < file_size ) {
+        auto n = MIN( step, file_size - read_end );
+        auto old_size = buf.size();
+        buf.resize( old_size + n );
+        impl::fread_blocking( &buf[old_size], n, read_end, fd );
+        read_end += n;
+        auto nl = static_cast<char*>( memchr( &buf[old_size], '\n', n ) );
+        if( nl ) buf.resize( nl - &buf[0] + 1 );
+      }
+      impl::file_close( fd );
+      if( buf.back() != '\n' ) buf.push_back( '\n' );
+      buf.push_back( '\0' ); // (so strtod stops)
+      
+      const char * p = &buf[0];
+      const char * end = &buf[0] + buf.size() - 1;
       if( start_offset > 0 ) {
-        // move past next newline so we start parsing from a record boundary
-        std::string s;
-        std::getline( infile, s );
-        DVLOG(6) << "Skipped '" << s << "'";
+        // start at the first line that starts in our range
+        p = static_cast<const char*>( memchr( p, '\n', end - p ) ) + 1;
       }
+      const char * last = &buf[0] + (end_offset - buf_offset); // lines starting here are the next core's
       
-      start_offset = infile.tellg();
-      DVLOG(6) << "Start reading at " << start_offset;
-
-      // read up to one entry past the end_offset
-      while( infile.good() && start_offset < end_offset ) {
-        int64_t v0 = -1;
-        int64_t v1 = -1;
-        if( infile.peek() == '#' ) { // if a comment
-          std::string str;
-          std::getline( infile, str );
-        } else {
-          infile >> v0;
-          if( !infile.good() ) break;
-          infile >> v1;
-          Edge e = { v0, v1 };
-          DVLOG(6) << "Read " << v0 << " -> " << v1;
-          read_edges.push_back( e );
-          start_offset = infile.tellg();
+      read_edges.reserve( std::count( p, end, '\n' ) );
+      read_payloads.reserve( read_edges.capacity() );
+      
+      for( const char * nl; p < last; p = nl + 1 ) {
+        nl = static_cast<const char*>( memchr( p, '\n', end - p ) );
+        const char * q = skip_blanks( p );
+        if( q == nl || *q == '\r' || *q == '#' ) continue; // blank or comment
+        
+        Edge e;
+        q = parse_int64( q, &e.v0 );
+        if( q ) q = parse_int64( skip_blanks( q ), &e.v1 );
+        CHECK( q ) << "Malformed edge at byte " << buf_offset + (p - &buf[0]) << " of " << filename;
+        read_edges.push_back( e );
+        
+        // optional third column is an edge weight
+        q = skip_blanks( q );
+        double w = 0.0;
+        if( q != nl && *q != '\r' && *q != '#' ) {
+          w = strtod( q, nullptr );
+          read_has_weight = 1;
         }
+        read_payloads.push_back( *reinterpret_cast<uint64_t*>(&w) );
       }
-
-      DVLOG(6) << "Done reading at " << start_offset << " end_offset " << end_offset;
       
       // collect sizes
       local_offset = read_edges.size();
       DVLOG(7) << "Read " << local_offset << " edges";
     } );
-
-  auto nedge = Grappa::reduce<int64_t,collective_add>(&local_offset);
   
-  TupleGraph tg( nedge );
-  auto edges = tg.edges;
-  //auto leftovers = GlobalVector<int64_t>::create(N);
+  VLOG(1) << "tsv_parse_time: " << walltime() - t
+          << ", parse_rate_mbps: " << (file_size / double(1L<<20)) / (walltime() - t);
 
-  on_all_cores( [=] {
-      Edge * local_ptr = edges.localize();
-      Edge * local_end = (edges+nedge).localize();
-      auto local_count = local_end - local_ptr;
-      auto read_count = read_edges.size();
-
-      DVLOG(7) << "local_count " << local_count
-               << " read_count " << read_count;
-      
-      // copy everything in our read buffer that fits locally
-      auto local_max = MIN( local_count, read_count );
-      std::memcpy( local_ptr, &read_edges[0], local_max * sizeof(Edge) );
-      local_offset = local_max;
-      Grappa::barrier();
-
-      // get rid of remaining edges
-      auto mycore = Grappa::mycore();
-      auto likely_consumer = (mycore + 1) % Grappa::cores();
-      while( local_max < read_count ) {
-        Edge e = read_edges[local_max];
-        DVLOG(7) << "Looking for somewhere to place edge " << local_max;
-        
-        int retval = delegate::call( likely_consumer, [=] ()->int {
-            Edge * local_ptr = edges.localize();
-            Edge * local_end = (edges+nedge).localize();
-            auto local_count = local_end - local_ptr;
-
-            DVLOG(7) << "Trying to place edge " << local_max
-                      << " on core " << Grappa::mycore()
-                      << " with local_offset " << local_offset
-                      << " and local_count " << local_count;
-            
-            // do we have space to insert here?
-            if( local_offset < local_count ) {
-              // yes, so do so
-              local_ptr[local_offset] = e;
-              local_offset++;
-
-              if( local_offset < local_count ) {
-                DVLOG(7) << "Succeeded with space available";
-                return 0; // succeeded with more space available
-              } else {
-                DVLOG(7) << "Succeeded with no more space available";
-                return 1; // succeeded with no more space available
-              }
-            } else {
-              // no, so return nack.
-              DVLOG(7) << "Failed with no more space available";
-              return -1; // did not succeed
-            }
-          } );
-
-        // insert succeeded, so move to next edge
-        if( retval >= 0 ) {
-          local_max++;
-        }
-
-        // no more space available on target, so move to next core
-        if( local_max < read_count && retval != 0 ) {
-          likely_consumer = (likely_consumer + 1) % Grappa::cores();
-          CHECK_NE( likely_consumer, Grappa::mycore() ) << "No more space to place edge on cluster?";
-        }
-      }
-      
-      // wait for everybody else to fill in our remaining spaces
-      Grappa::barrier();
-      
-      // discard temporary read buffer
-      read_edges.clear();
-    } );
-
-  // done!
-  return tg;
+  // distribute what we read; if any line had a weight, all edges get one
+  bool weighted = Grappa::reduce<int64_t,collective_max>(&read_has_weight) > 0;
+  return place_read_edges( weighted );
 }
 
 /// Matrix Market format loader
@@ -433,18 +498,24 @@ TupleGraph TupleGraph::load_mm( std::string path ) {
           infile >> v0;
           if( !infile.good() ) break;
           infile >> v1;
-          if( header_info.field_double ) {
+          if( header_info.field_default_value ) {
+            // "pattern" matrices have no value column
+          } else if( header_info.field_double ) {
             double d;
             infile >> d;
             data = *((uint64_t*)&d); // hack. reuse bits for data.
           } else {
-            int64_t d;
-            infile >> d;
+            // integer fields are kept as doubles too, so payloads from
+            // text files are always doubles
+            int64_t i;
+            infile >> i;
+            double d = i;
             data = *((uint64_t*)&d);
           }
           Edge e = { v0, v1 };
           DVLOG(6) << "Read " << v0 << " -> " << v1 << " with data " << (void*) data;
           read_edges.push_back( e );
+          read_payloads.push_back( data );
           start_offset = infile.tellg();
         }
       }
@@ -456,84 +527,9 @@ TupleGraph TupleGraph::load_mm( std::string path ) {
       DVLOG(7) << "Read " << local_offset << " edges";
     } );
 
-  auto nedge = Grappa::reduce<int64_t,collective_add>(&local_offset);
-  LOG(INFO) << "Loading " << nedge << " edges";
-  TupleGraph tg( nedge );
-  auto edges = tg.edges;
-  //auto leftovers = GlobalVector<int64_t>::create(N);
-
-  on_all_cores( [=] {
-      Edge * local_ptr = edges.localize();
-      Edge * local_end = (edges+nedge).localize();
-      auto local_count = local_end - local_ptr;
-      auto read_count = read_edges.size();
-
-      DVLOG(7) << "local_count " << local_count
-               << " read_count " << read_count;
-      
-      // copy everything in our read buffer that fits locally
-      auto local_max = MIN( local_count, read_count );
-      std::memcpy( local_ptr, &read_edges[0], local_max * sizeof(Edge) );
-      local_offset = local_max;
-      Grappa::barrier();
-
-      // get rid of remaining edges
-      auto mycore = Grappa::mycore();
-      auto likely_consumer = (mycore + 1) % Grappa::cores();
-      while( local_max < read_count ) {
-        Edge e = read_edges[local_max];
-        DVLOG(7) << "Looking for somewhere to place edge " << local_max;
-        
-        int retval = delegate::call( likely_consumer, [=] ()->int {
-            Edge * local_ptr = edges.localize();
-            Edge * local_end = (edges+nedge).localize();
-            auto local_count = local_end - local_ptr;
-
-            DVLOG(7) << "Trying to place edge " << local_max
-                      << " on core " << Grappa::mycore()
-                      << " with local_offset " << local_offset
-                      << " and local_count " << local_count;
-            
-            // do we have space to insert here?
-            if( local_offset < local_count ) {
-              // yes, so do so
-              local_ptr[local_offset] = e;
-              local_offset++;
-
-              if( local_offset < local_count ) {
-                DVLOG(7) << "Succeeded with space available";
-                return 0; // succeeded with more space available
-              } else {
-                DVLOG(7) << "Succeeded with no more space available";
-                return 1; // succeeded with no more space available
-              }
-            } else {
-              // no, so return nack.
-              DVLOG(7) << "Failed with no more space available";
-              return -1; // did not succeed
-            }
-          } );
-
-        // insert succeeded, so move to next edge
-        if( retval >= 0 ) {
-          local_max++;
-        }
-
-        // no more space available on target, so move to next core
-        if( local_max < read_count && retval != 0 ) {
-          likely_consumer = (likely_consumer + 1) % Grappa::cores();
-          CHECK_NE( likely_consumer, Grappa::mycore() ) << "No more space to place edge on cluster?";
-        }
-      }
-      
-      // wait for everybody else to fill in our remaining spaces
-      Grappa::barrier();
-      
-      // discard temporary read buffer
-      read_edges.clear();
-    } );
-
-  // done!
+  // distribute what we read, keeping the matrix values as edge payloads
+  auto tg = place_read_edges( !header_info.field_default_value );
+  LOG(INFO) << "Loaded " << tg.nedge << " edges";
   return tg;
 }
 
@@ -676,6 +672,34 @@ void local_save_tsv( const char * filename,
 
 
 
+/// allocate zeroed per-core payload storage parallel to each core's slice of edges
+void TupleGraph::init_payload_bytes( size_t size ) {
+  CHECK( !has_payload() ) << "TupleGraph already has a payload";
+  CHECK_GT( size, 0 );
+  payloads = symmetric_global_alloc<impl::TupleGraphPayload>();
+  payload_size = size;
+  auto edges = this->edges;
+  auto nedge = this->nedge;
+  auto payloads = this->payloads;
+  on_all_cores( [=] {
+      auto local_count = (edges+nedge).localize() - edges.localize();
+      payloads->size = size;
+      payloads->local = locale_alloc<char>( local_count * size + 1 );
+      std::memset( payloads->local, 0, local_count * size );
+    } );
+}
+
+void TupleGraph::destroy() {
+  if( has_payload() ) {
+    auto payloads = this->payloads;
+    on_all_cores( [=] { locale_free( payloads->local ); } );
+    global_free( payloads );
+    this->payloads = GlobalAddress<impl::TupleGraphPayload>();
+    payload_size = 0;
+  }
+  global_free( edges );
+}
+
 /// TupleGraph constructor that loads from a file, dispatching on file format
 TupleGraph TupleGraph::Load( std::string path, std::string format ) {
   if( format == "bintsv4" ) {
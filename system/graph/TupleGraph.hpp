@@ -28,6 +28,14 @@
 
 namespace Grappa {
 
+  namespace impl {
+    /// Per-core storage for TupleGraph edge payloads.
+    struct TupleGraphPayload {
+      char * local;   ///< payload of each of this core's edges, in the same order
+      size_t size;    ///< bytes per edge
+    } GRAPPA_BLOCK_ALIGNED;
+  }
+  
   class TupleGraph {
   public:    
     struct Edge {
@@ -43,10 +51,34 @@ namespace Grappa {
     
     static TupleGraph load_tsv( std::string path );
     static TupleGraph load_mm( std::string path );
+    static TupleGraph place_read_edges( bool with_payload );
+    
+    void init_payload_bytes( size_t size );
     
   public:
     GlobalAddress<Edge> edges;
     int64_t nedge; /* Number of edges in graph, in both cases */
+    
+    /// Optional per-edge payload (weights, timestamps, labels...). Each core stores
+    /// the payloads of its slice of `edges` locally, in the same order, so an edge's
+    /// payload is local wherever the edge is.
+    GlobalAddress<impl::TupleGraphPayload> payloads;
+    size_t payload_size;
+    
+    bool has_payload() const { return payload_size > 0; }
+    
+    /// Allocate a (zeroed) payload of type P for every edge (collective).
+    /// Loaders attach a `double` payload when the input has edge values: the optional
+    /// third column of "tsv" files, or the value of "mm" real/integer matrices.
+    template< typename P >
+    void init_payload() { init_payload_bytes(sizeof(P)); }
+    
+    /// Payload of edge `e`, which must be local (e.g. inside `forall(tg.edges, ...)`).
+    template< typename P >
+    P& payload(Edge& e) const {
+      DCHECK_EQ(sizeof(P), payload_size);
+      return reinterpret_cast<P*>(payloads->local)[&e - edges.localize()];
+    }
   
     /// Use Graph500 Kronecker generator (@see graph/KroneckerGenerator.cpp)
     static TupleGraph Kronecker(int scale, int64_t desired_nedge, 
@@ -55,16 +87,20 @@ namespace Grappa {
     // create new TupleGraph with edges loaded from file
     static TupleGraph Load( std::string path, std::string format );
 
-     void destroy() { global_free(edges); }
+     void destroy();
 
     // default contstructor
     TupleGraph()
       : initialized( false )
       , edges( )
       , nedge(0)
+      , payloads( )
+      , payload_size(0)
     { }
 
-    TupleGraph(const TupleGraph& tg): initialized(false), edges(tg.edges), nedge(tg.nedge) { }
+    TupleGraph(const TupleGraph& tg)
+      : initialized(false), edges(tg.edges), nedge(tg.nedge)
+      , payloads(tg.payloads), payload_size(tg.payload_size) { }
 
     TupleGraph& operator=(const TupleGraph& tg) {
       if( initialized ) {
@@ -72,13 +108,15 @@ namespace Grappa {
       }
       edges = tg.edges;
       nedge = tg.nedge;
+      payloads = tg.payloads;
+      payload_size = tg.payload_size;
       return *this;
     }
 
     void save( std::string path, std::string format );
 
   protected:
-    TupleGraph(int64_t nedge): initialized(true), edges(global_alloc<Edge>(nedge)), nedge(nedge) {}
+    TupleGraph(int64_t nedge): initialized(true), edges(global_alloc<Edge>(nedge)), nedge(nedge), payloads(), payload_size(0) {}
     
   };
 